@@ -6,7 +6,7 @@ SOURCE_SUBDIR="src/mpi"
 # <<< CHANGE: Define the absolute path for the output directory >>>
 OUTPUT_BASE_DIR="$HOME/SHARED" # Use $HOME for reliable home directory path
 
-FLAGS="-Wall -Wextra -g"                 # Compiler flags (e.g., -Wall, -O2, -g for debugging)
+FLAGS="-Wall -Wextra -g -O2 -fopenmp -lm" # Compiler flags (-fopenmp enables the threaded kernels)
 HOSTFILE_PATH="~/hostfile"               # Path to the MPI hostfile (not used in compilation, but kept from original)
 export PMIX_MCA_pcompress_base_silence_warning=1
 
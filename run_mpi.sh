@@ -7,8 +7,8 @@ SOURCE_SUBDIR="src/mpi"
 # We'll put the executable alongside the source code.
 OUTPUT_SUBDIR="build"
 
-FLAGS="-Wall -Wextra -g"                 # Compiler flags (e.g., -Wall, -O2, -g for debugging)
-NODES=("nodo1", "nodo2", "nodo3")                  # List of worker nodes to copy the executable to (assumes node1 is local)
+FLAGS="-Wall -Wextra -g -O2 -fopenmp -lm" # Compiler flags (-fopenmp enables the threaded kernels)
+NODES=("nodo1" "nodo2" "nodo3")                    # List of worker nodes to copy the executable to (assumes node1 is local)
 HOSTFILE_PATH="~/hostfile"               # Path to the MPI hostfile (tilde expansion is handled)
 export PMIX_MCA_pcompress_base_silence_warning=1
 # --- Argument Handling ---
@@ -19,6 +19,8 @@ if [ "$#" -lt 2 ]; then
   echo "  Assumes source file is located at: ./${SOURCE_SUBDIR}/<source_filename>.c"
   echo "  Compiled executable will be placed at: ./${OUTPUT_SUBDIR}/<source_filename>"
   echo "  Requires hostfile at: ${HOSTFILE_PATH}"
+  echo "  Run '$0 stage 1' once to install the staging tool (src/mpi/stage.c) on all nodes; afterwards"
+  echo "  executables are distributed with it in one pipelined broadcast instead of one scp per node."
   exit 1
 fi
 
@@ -86,31 +88,58 @@ echo "Compilation successful."
 echo "--------------------"
 
 # --- Distribution (Copy to other nodes) ---
-COPY_FAILED=0
 REMOTE_OUTPUT_DIR_REL_HOME="./${OUTPUT_SUBDIR}" # Needs to match OUTPUT_EXECUTABLE_REL_HOME structure
-
-for NODE in "${NODES[@]}"; do
-  # Ensure remote directory exists first (robustness)
-  # Use double quotes around the command for ssh
-  ssh "${NODE}" "mkdir -p ${REMOTE_OUTPUT_DIR_REL_HOME}"
-  if [ $? -ne 0 ]; then
+STAGE_TOOL_ABS="${SCRIPT_DIR}/${OUTPUT_SUBDIR}/stage"
+STAGE_TOOL_REL_HOME="${REMOTE_OUTPUT_DIR_REL_HOME}/stage"
+
+# One node after the other over ssh; needed to install the staging tool itself
+copy_with_scp() {
+  local COPY_FAILED=0
+  for NODE in "${NODES[@]}"; do
+    # Ensure remote directory exists first (robustness)
+    # Use double quotes around the command for ssh
+    ssh "${NODE}" "mkdir -p ${REMOTE_OUTPUT_DIR_REL_HOME}"
+    if [ $? -ne 0 ]; then
+        COPY_FAILED=1
+        # Continue to check other nodes, but flag failure
+        continue # Skip scp for this node if mkdir failed
+    fi
+
+    # Use the absolute path for the source, relative path (from home) for destination
+    scp "${OUTPUT_EXECUTABLE_ABS}" "${NODE}:${REMOTE_OUTPUT_DIR_REL_HOME}/"
+    if [ $? -ne 0 ]; then
+      echo "  Error: Failed to copy executable to ${NODE}!"
       COPY_FAILED=1
-      # Continue to check other nodes, but flag failure
-      continue # Skip scp for this node if mkdir failed
-  fi
-
-  # Use the absolute path for the source, relative path (from home) for destination
-  scp "${OUTPUT_EXECUTABLE_ABS}" "${NODE}:${REMOTE_OUTPUT_DIR_REL_HOME}/"
-  if [ $? -ne 0 ]; then
-    echo "  Error: Failed to copy executable to ${NODE}!"
-    COPY_FAILED=1
+    fi
+  done
+  return ${COPY_FAILED}
+}
+
+# One process per hostfile node: rank 0 (the first node, assumed local) reads the executable and
+# broadcasts it in chunks to every node, which writes and checksums its copy
+copy_with_stage_tool() {
+  mpirun --hostfile "${HOSTFILE_PATH_RESOLVED}" --map-by ppr:1:node "${STAGE_TOOL_REL_HOME}" \
+    "${OUTPUT_EXECUTABLE_ABS}" "${OUTPUT_EXECUTABLE_REL_HOME}"
+}
+
+echo "--- Distribution ---"
+if [ "${FILENAME_NO_EXT}" != "stage" ] && [ -x "${STAGE_TOOL_ABS}" ]; then
+  if ! copy_with_stage_tool; then
+    echo "Staging tool failed (not installed on every node?), falling back to scp."
+    copy_with_scp
   fi
-done
-
-if [ ${COPY_FAILED} -eq 1 ]; then
+else
+  copy_with_scp
+fi
+if [ $? -ne 0 ]; then
     echo "Error: Distribution failed on one or more nodes. Aborting execution."
     exit 1
 fi
+if [ "${FILENAME_NO_EXT}" = "stage" ]; then
+  echo "Staging tool installed on all nodes; later runs distribute executables with it."
+  echo "--------------------"
+  exit 0
+fi
 echo "--------------------"
 
 # --- Execution ---
@@ -0,0 +1,191 @@
+#!/bin/bash
+
+# Strong / weak scaling runner. Launches one executable from BIN_DIR the way execute.sh does,
+# over a list of process counts and problem sizes, collects the per-phase timing report of every
+# run (src/mpi/timing.h, as CSV) and prints one consolidated table.
+#
+# The program's arguments follow the executable name; the placeholder {N} in them is replaced by
+# the problem size of each run.
+#   strong: every size of -n runs on every process count of -p.
+#   weak:   the sizes of -n belong to the first process count P0 of -p; on P processes the size
+#           grows so that the work per process stays the same: N * (P / P0)^(1 / DIM), where DIM
+#           is the power of N the work grows with (1 for pi and trapezoid, 2 for vector-matrix).
+# Every point runs REPS times and the repetition with the shortest total counts.
+
+# --- Configuration ---
+HOSTFILE_PATH="$HOME/hostfile" # Path to the MPI hostfile
+BIN_DIR="$HOME/SHARED"         # Directory containing the MPI executables (shared by all nodes)
+DEFAULT_PROCS="1 2 4"          # Process counts if -p is not given
+DEFAULT_REPS=3                 # Repetitions per point if -r is not given
+
+# Silence PMIX warning if needed (keep this if it solves a problem for you)
+export PMIX_MCA_pcompress_base_silence_warning=1
+
+usage() {
+  echo "Usage: $0 [-m strong|weak|both] [-p \"P1 P2 ...\"] -n \"N1 N2 ...\" [-d DIM] [-r REPS] [-o DIR] <executable_name> [args...]"
+  echo "  -m  Scaling mode (default: both)"
+  echo "  -p  Process counts (default: ${DEFAULT_PROCS}); the first one is the baseline"
+  echo "  -n  Problem sizes, substituted for {N} in the program arguments"
+  echo "  -d  Power of N the work grows with, for weak scaling (default: 1)"
+  echo "  -r  Repetitions per point, the fastest counts (default: ${DEFAULT_REPS})"
+  echo "  -o  Output directory (default: ${BIN_DIR}/scaling_<executable>_<date>; must be visible to rank 0)"
+  echo "  Example 1: $0 -m strong -p \"1 2 4 8\" -n \"100000000 400000000\" pi {N}"
+  echo "  Example 2: $0 -m weak -d 2 -p \"1 4 16\" -n 4000 vector-matrix -i gen {N}"
+  exit 1
+}
+
+# --- Argument Handling ---
+MODE="both"
+PROCS="${DEFAULT_PROCS}"
+SIZES=""
+DIM=1
+REPS=${DEFAULT_REPS}
+OUT_DIR=""
+while getopts "m:p:n:d:r:o:" opt; do
+  case "$opt" in
+    m) MODE="$OPTARG" ;;
+    p) PROCS="$OPTARG" ;;
+    n) SIZES="$OPTARG" ;;
+    d) DIM="$OPTARG" ;;
+    r) REPS="$OPTARG" ;;
+    o) OUT_DIR="$OPTARG" ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ "$#" -lt 1 ] || [ -z "${SIZES}" ]; then
+  usage
+fi
+case "${MODE}" in
+  strong) MODES="strong" ;;
+  weak) MODES="weak" ;;
+  both) MODES="strong weak" ;;
+  *) echo "Error: Unknown mode '${MODE}' (use strong, weak or both)."; exit 1 ;;
+esac
+for value in ${PROCS} ${SIZES} ${DIM} ${REPS}; do
+  if ! [[ "$value" =~ ^[1-9][0-9]*$ ]]; then
+    echo "Error: Process counts, sizes, DIM and REPS must be positive integers, got '${value}'."
+    exit 1
+  fi
+done
+
+EXECUTABLE_NAME="$1"
+shift
+PROGRAM_ARGS=("$@")
+FULL_EXECUTABLE_PATH="${BIN_DIR}/${EXECUTABLE_NAME}"
+if [ ! -x "${FULL_EXECUTABLE_PATH}" ]; then
+  echo "Error: Executable not found or not executable at '${FULL_EXECUTABLE_PATH}'"
+  exit 1
+fi
+if [ ! -r "${HOSTFILE_PATH}" ]; then
+  echo "Error: Hostfile not found or not readable at '${HOSTFILE_PATH}'"
+  exit 1
+fi
+OUT_DIR="${OUT_DIR:-${BIN_DIR}/scaling_${EXECUTABLE_NAME}_$(date +%Y%m%d_%H%M%S)}"
+mkdir -p "${OUT_DIR}/raw" || exit 1
+
+# --- Helpers ---
+P0="${PROCS%% *}"
+
+# Size of a run on P processes: N itself for strong scaling, grown by (P / P0)^(1 / DIM) for weak
+size_for() {
+  local mode="$1" n="$2" p="$3"
+  if [ "$mode" = "strong" ]; then
+    echo "$n"
+  else
+    awk -v n="$n" -v p="$p" -v p0="$P0" -v d="$DIM" 'BEGIN { printf "%d\n", n * (p / p0) ^ (1 / d) + 0.5 }'
+  fi
+}
+
+# Best repetition in one raw timing file: threads,total_s,total_imbalance, then the slowest
+# rank's time of every region in REGIONS (0 where the run had no such region)
+best_run() {
+  awk -F, -v regions="${REGIONS}" '
+    $1 == "program" { next }
+    {
+      t[$5] = $9
+      if ($5 == "total") {
+        if (line == "" || $9 + 0 < best) {
+          best = $9 + 0
+          line = $3 "," $9 "," $10
+          n = split(regions, r, " ")
+          for (i = 1; i <= n; i++) {
+            line = line "," ((r[i] in t) ? t[r[i]] : 0)
+          }
+        }
+        delete t
+      }
+    }
+    END { print line }' "$1"
+}
+
+# --- Runs ---
+echo "--- Scaling runs of ${FULL_EXECUTABLE_PATH} ---"
+echo "  Modes: ${MODES}  Processes: ${PROCS}  Sizes: ${SIZES}  Repetitions: ${REPS}"
+echo "  Output: ${OUT_DIR}"
+for mode in ${MODES}; do
+  for n in ${SIZES}; do
+    for p in ${PROCS}; do
+      size=$(size_for "$mode" "$n" "$p")
+      args=("${PROGRAM_ARGS[@]//\{N\}/${size}}")
+      raw="${OUT_DIR}/raw/${mode}_n${n}_p${p}.csv"
+      rm -f "${raw}"
+      echo "  ${mode}: ${p} processes, size ${size}"
+      for ((rep = 0; rep < REPS; rep++)); do
+        TIMING_FORMAT=csv TIMING_OUTPUT="${raw}" \
+          mpirun -np "$p" --hostfile "${HOSTFILE_PATH}" -x TIMING_FORMAT -x TIMING_OUTPUT \
+          "${FULL_EXECUTABLE_PATH}" "${args[@]}" >> "${OUT_DIR}/log.txt" 2>&1
+        if [ $? -ne 0 ]; then
+          echo "Error: Run failed, see ${OUT_DIR}/log.txt"
+          exit 1
+        fi
+      done
+    done
+  done
+done
+
+# --- Consolidated table ---
+# Region columns in the order of the first run's report ("total" has its own column)
+first_raw=$(ls "${OUT_DIR}"/raw/*.csv | head -n 1)
+REGIONS=$(awk -F, '$1 != "program" && $5 != "total" && !seen[$5]++ { printf "%s ", $5 }' "${first_raw}")
+SUMMARY="${OUT_DIR}/summary.csv"
+{
+  printf "mode,procs,threads,size,total_s,speedup,efficiency,imbalance"
+  for region in ${REGIONS}; do
+    printf ",%s_s" "$region"
+  done
+  printf "\n"
+  for mode in ${MODES}; do
+    for n in ${SIZES}; do
+      base=""
+      for p in ${PROCS}; do
+        run=$(best_run "${OUT_DIR}/raw/${mode}_n${n}_p${p}.csv")
+        total=$(echo "$run" | cut -d, -f2)
+        base="${base:-$total}"
+        # Strong: speedup T(P0) / T(P), efficiency speedup * P0 / P.
+        # Weak: efficiency T(P0) / T(P), (scaled) speedup efficiency * P / P0.
+        awk -F, -v mode="$mode" -v p="$p" -v p0="$P0" -v size="$(size_for "$mode" "$n" "$p")" -v base="$base" '
+          {
+            ratio = $2 > 0 ? base / $2 : 0
+            speedup = (mode == "strong") ? ratio : ratio * p / p0
+            efficiency = (mode == "strong") ? ratio * p0 / p : ratio
+            printf "%s,%d,%d,%s,%.6f,%.3f,%.3f,%.3f", mode, p, $1, size, $2, speedup, efficiency, $3
+            for (i = 4; i <= NF; i++) {
+              printf ",%.6f", $i
+            }
+            printf "\n"
+          }' <<< "$run"
+      done
+    done
+  done
+} > "${SUMMARY}"
+
+echo "--------------------"
+if command -v column > /dev/null; then
+  column -s, -t < "${SUMMARY}"
+else
+  cat "${SUMMARY}"
+fi
+echo "--------------------"
+echo "Table written to ${SUMMARY} (raw per-run timings in ${OUT_DIR}/raw)"
+exit 0
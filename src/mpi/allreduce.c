@@ -0,0 +1,266 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h> // For qsort, strtoll
+#include <string.h> // For strcmp
+#include <unistd.h> // For getopt
+#include "collectives.h"
+
+// Allreduce benchmark: MPI_Allreduce against the algorithms in collectives.h over a sweep of
+// vector sizes (doubles, MPI_SUM). Every repetition starts after a barrier and is timed on its
+// own; the slowest rank's time counts. Results are CSV on stdout with min / median / p99
+// latency, algorithm and bus bandwidth, and the median speedup over MPI_Allreduce.
+
+#define ALIGNMENT 64                 // Cache-line alignment for the vectors
+#define DEFAULT_MIN_BYTES 8          // Smallest vector of the sweep (one double)
+#define DEFAULT_MAX_BYTES (64 << 20) // Largest vector of the sweep (64 MiB)
+#define DEFAULT_REPS 200             // Timed repetitions per size (small vectors)
+#define DEFAULT_WARMUP 5             // Untimed repetitions per size
+#define LARGE_MESSAGE (256 << 10)    // Above this size the repetitions shrink with the size
+#define MIN_REPS 10                  // Fewest timed repetitions of any size
+
+typedef int (*allreduce_fn)(const void *, void *, int, MPI_Datatype, MPI_Op, MPI_Comm);
+
+// Algorithms in the order they are run for every size; the first one is the baseline
+const struct
+{
+    const char *name;
+    allreduce_fn fn;
+} algorithms[] = {
+    {"mpi", MPI_Allreduce},
+    {"ring", coll_allreduce_ring},
+    {"rdouble", coll_allreduce_recursive_doubling},
+    {"auto", coll_allreduce},
+};
+const int num_algorithms = sizeof(algorithms) / sizeof(algorithms[0]);
+
+// Parse a byte count with an optional K, M or G suffix (powers of 1024); -1 if invalid
+long long parse_bytes(const char *text)
+{
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    if (*end == 'K' || *end == 'k')
+    {
+        value <<= 10;
+        end++;
+    }
+    else if (*end == 'M' || *end == 'm')
+    {
+        value <<= 20;
+        end++;
+    }
+    else if (*end == 'G' || *end == 'g')
+    {
+        value <<= 30;
+        end++;
+    }
+    return (*end == '\0' && end != text) ? value : -1;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Rank r contributes (r + 1) * (i % 7 + 1) at index i: small integers, so the sum is exact in
+// any order and every algorithm must match the expected value bit for bit
+double input_entry(int rank, int i)
+{
+    return (double)(rank + 1) * (i % 7 + 1);
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-a ALGORITHM] [-s MIN] [-S MAX] [-r REPS] [-w WARMUP]\n", prog);
+    fprintf(stderr, "  -a ALGORITHM  Only run this one besides mpi:");
+    for (int k = 1; k < num_algorithms; k++)
+    {
+        fprintf(stderr, " %s", algorithms[k].name);
+    }
+    fprintf(stderr, " (default: all)\n");
+    fprintf(stderr, "  -s MIN        Smallest vector in bytes, K/M/G suffixes allowed (default: %d)\n", DEFAULT_MIN_BYTES);
+    fprintf(stderr, "  -S MAX        Largest vector in bytes (default: %dM); sizes double from MIN\n", DEFAULT_MAX_BYTES >> 20);
+    fprintf(stderr, "  -r REPS       Timed repetitions per size, scaled down above %dK (default: %d)\n",
+            LARGE_MESSAGE >> 10, DEFAULT_REPS);
+    fprintf(stderr, "  -w WARMUP     Untimed repetitions per size (default: %d)\n", DEFAULT_WARMUP);
+}
+
+int main(int argc, char *argv[])
+{
+    int my_rank, num_procs;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    // --- Argument Handling (Rank 0 parses and broadcasts the settings) ---
+    long long min_bytes = DEFAULT_MIN_BYTES, max_bytes = DEFAULT_MAX_BYTES;
+    int reps = DEFAULT_REPS, warmup = DEFAULT_WARMUP, only = -1;
+    int args_ok = 1;
+    if (my_rank == 0)
+    {
+        int opt;
+        while (args_ok && (opt = getopt(argc, argv, "a:s:S:r:w:")) != -1)
+        {
+            if (opt == 'a')
+            {
+                only = -1;
+                for (int k = 1; k < num_algorithms; k++)
+                {
+                    only = strcmp(optarg, algorithms[k].name) == 0 ? k : only;
+                }
+                if (only < 0)
+                {
+                    print_usage(argv[0]);
+                    args_ok = 0;
+                }
+            }
+            else if (opt == 's' && parse_bytes(optarg) >= (long long)sizeof(double))
+            {
+                min_bytes = parse_bytes(optarg);
+            }
+            else if (opt == 'S' && parse_bytes(optarg) >= (long long)sizeof(double))
+            {
+                max_bytes = parse_bytes(optarg);
+            }
+            else if (opt == 'r' && atoi(optarg) > 0)
+            {
+                reps = atoi(optarg);
+            }
+            else if (opt == 'w' && atoi(optarg) >= 0)
+            {
+                warmup = atoi(optarg);
+            }
+            else
+            {
+                print_usage(argv[0]);
+                args_ok = 0;
+            }
+        }
+        if (args_ok && (optind < argc || min_bytes > max_bytes || max_bytes / (long long)sizeof(double) > 0x7fffffff))
+        {
+            fprintf(stderr, "Error: Need 8 <= MIN <= MAX, a count that fits in an int and no extra arguments.\n");
+            args_ok = 0;
+        }
+    }
+    long long settings[6] = {args_ok, min_bytes, max_bytes, reps, warmup, only};
+    MPI_Bcast(settings, 6, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (!settings[0])
+    {
+        MPI_Finalize();
+        return 1;
+    }
+    min_bytes = settings[1];
+    max_bytes = settings[2];
+    reps = (int)settings[3];
+    warmup = (int)settings[4];
+    only = (int)settings[5];
+
+    int max_count = (int)(max_bytes / sizeof(double));
+    double *input = NULL, *result = NULL;
+    double *times = malloc(reps * sizeof(double));
+    int alloc_failed = posix_memalign((void **)&input, ALIGNMENT, max_count * sizeof(double)) != 0 ||
+                       posix_memalign((void **)&result, ALIGNMENT, max_count * sizeof(double)) != 0 ||
+                       times == NULL;
+    int any_failed;
+    MPI_Allreduce(&alloc_failed, &any_failed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (any_failed)
+    {
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Error: Cannot allocate %lld-byte vectors.\n", max_bytes);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    for (int i = 0; i < max_count; i++)
+    {
+        input[i] = input_entry(my_rank, i);
+        result[i] = 0.0;
+    }
+
+    if (my_rank == 0)
+    {
+        printf("# Allreduce benchmark: %d processes, MPI_DOUBLE, MPI_SUM, ring above %d bytes in auto, %d-byte segments\n",
+               num_procs, COLL_RING_THRESHOLD, COLL_SEGMENT_BYTES);
+        printf("# Latency in microseconds, bandwidth in MB/s from the median (bus = algorithm * 2 (P-1) / P)\n");
+        printf("algorithm,procs,bytes,reps,min_us,median_us,p99_us,alg_bw_MBps,bus_bw_MBps,speedup_vs_mpi\n");
+    }
+
+    int bad_results = 0; // Sizes where an algorithm did not produce the exact sum
+    double rank_sum = 0.5 * num_procs * (num_procs + 1.0); // Sum of (rank + 1) over all ranks
+    for (long long bytes = min_bytes; bytes <= max_bytes; bytes *= 2)
+    {
+        int count = (int)(bytes / sizeof(double));
+        int size_reps = reps;
+        if (bytes > LARGE_MESSAGE)
+        {
+            long long scaled = (long long)reps * LARGE_MESSAGE / bytes;
+            size_reps = scaled < MIN_REPS ? (reps < MIN_REPS ? reps : MIN_REPS) : (int)scaled;
+        }
+        int size_warmup = warmup < size_reps ? warmup : size_reps;
+        double baseline_median = 0.0;
+
+        for (int k = 0; k < num_algorithms; k++)
+        {
+            if (only > 0 && k != 0 && k != only)
+            {
+                continue;
+            }
+            for (int i = -size_warmup; i < size_reps; i++)
+            {
+                MPI_Barrier(MPI_COMM_WORLD);
+                double t0 = MPI_Wtime();
+                algorithms[k].fn(input, result, count, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+                if (i >= 0)
+                {
+                    times[i] = MPI_Wtime() - t0;
+                }
+            }
+
+            // Check the last result, then clear it so the next algorithm starts from scratch
+            for (int i = 0; i < count; i++)
+            {
+                if (result[i] != rank_sum * (i % 7 + 1))
+                {
+                    bad_results++;
+                    break;
+                }
+            }
+            memset(result, 0, count * sizeof(double));
+
+            // The collective is only done when the slowest rank is done
+            MPI_Reduce(my_rank == 0 ? MPI_IN_PLACE : times, times, size_reps, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            if (my_rank == 0)
+            {
+                qsort(times, size_reps, sizeof(double), compare_doubles);
+                double min = times[0];
+                double median = (size_reps % 2) ? times[size_reps / 2]
+                                                : 0.5 * (times[size_reps / 2 - 1] + times[size_reps / 2]);
+                double p99 = times[(99 * size_reps + 99) / 100 - 1]; // ceil(0.99 * reps) - 1
+                double alg_bw = bytes / median / 1e6;
+                if (k == 0)
+                {
+                    baseline_median = median;
+                }
+                printf("%s,%d,%lld,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", algorithms[k].name, num_procs, bytes,
+                       size_reps, min * 1e6, median * 1e6, p99 * 1e6, alg_bw,
+                       alg_bw * 2.0 * (num_procs - 1) / num_procs, baseline_median / median);
+                fflush(stdout);
+            }
+        }
+    }
+
+    int total_bad = 0;
+    MPI_Reduce(&bad_results, &total_bad, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (my_rank == 0 && total_bad > 0)
+    {
+        fprintf(stderr, "Warning: %d results differed from the exact sum.\n", total_bad);
+    }
+
+    free(input);
+    free(result);
+    free(times);
+    MPI_Finalize();
+    return total_bad > 0 && my_rank == 0;
+}
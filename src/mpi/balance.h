@@ -0,0 +1,220 @@
+#ifndef BALANCE_H
+#define BALANCE_H
+
+// Calibrated static load balancing for clusters whose nodes differ in speed or load. Instead of
+// giving every rank n / size items, each rank gets a share proportional to the throughput it
+// measured on a short run of the program's own kernel.
+//
+//   balance_weights   probe (or look up) this rank's throughput and allgather the relative
+//                     shares of all ranks (collective over comm)
+//   balance_split     cut n items into contiguous ranges in proportion to the weights
+//
+// The probe is a callback that does `units` items of the real kernel; it is run with doubling
+// unit counts until one run takes BALANCE_PROBE_SECONDS. All ranks of a node probe at the same
+// time, so the measurement includes the contention of sharing the node, and the node's mean is
+// used for each of its ranks.
+//
+// Measured throughputs are cached per host in the file named by BALANCE_CACHE (default
+// $HOME/.balance_cache), one "host key units_per_second" line per measurement, latest line wins.
+// The key names the kernel and whatever changes its speed (problem parameters, processes per
+// node and threads per process are added here), so later runs with the same setup skip the
+// probe. BALANCE_CACHE=none always probes; deleting the file or its lines re-calibrates.
+// Like TIMING_*, the variable must be exported to remote nodes (mpirun -x BALANCE_CACHE).
+//
+// Header-only so that every program in this directory can include it and still build from a
+// single source file (see compile.sh).
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h> // For omp_get_max_threads
+#endif
+
+#define BALANCE_PROBE_SECONDS 0.05 // Shortest probe run that counts as a measurement
+#define BALANCE_KEY_LEN 128        // Longest cache key, including the added node setup
+#define BALANCE_HOST_LEN 256       // Longest host name in the cache
+#define BALANCE_LINE_LEN 512       // Longest cache line read back
+
+// Run `units` items of the kernel being balanced
+typedef void (*balance_probe_fn)(long long units, void *ctx);
+
+// Items per second of one probe, starting at `units` items and doubling until a run is long enough
+static inline double balance_measure(balance_probe_fn probe, void *ctx, long long units)
+{
+    if (units < 1)
+    {
+        units = 1;
+    }
+    probe(units, ctx); // Warm-up: pages, caches and threads
+    for (;;)
+    {
+        double t0 = MPI_Wtime();
+        probe(units, ctx);
+        double seconds = MPI_Wtime() - t0;
+        if (seconds >= BALANCE_PROBE_SECONDS)
+        {
+            return units / seconds;
+        }
+        units *= 2;
+    }
+}
+
+// Path of the cache file; NULL when caching is off
+static inline const char *balance_cache_path(char *buf, size_t len)
+{
+    const char *path = getenv("BALANCE_CACHE");
+    if (path != NULL && strcmp(path, "none") == 0)
+    {
+        return NULL;
+    }
+    if (path != NULL && path[0] != '\0')
+    {
+        return path;
+    }
+    const char *home = getenv("HOME");
+    if (home == NULL)
+    {
+        return NULL;
+    }
+    snprintf(buf, len, "%s/.balance_cache", home);
+    return buf;
+}
+
+// Latest cached throughput of (host, key), or 0 if there is none
+static inline double balance_cache_lookup(const char *path, const char *host, const char *key)
+{
+    FILE *fp = path != NULL ? fopen(path, "r") : NULL;
+    double found = 0.0;
+    if (fp == NULL)
+    {
+        return found;
+    }
+    char line[BALANCE_LINE_LEN], line_host[BALANCE_HOST_LEN], line_key[BALANCE_KEY_LEN];
+    double value;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if (sscanf(line, "%255s %127s %lf", line_host, line_key, &value) == 3 && value > 0.0 &&
+            strcmp(line_host, host) == 0 && strcmp(line_key, key) == 0)
+        {
+            found = value;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+// Relative throughput of every rank of comm, summing to 1, into weights[size]. key names the
+// kernel and its parameters (no spaces); units is the item count of the first probe run.
+// Returns the number of nodes that had to probe (0 when every node was cached). Collective.
+static inline int balance_weights(const char *key, balance_probe_fn probe, void *ctx, long long units,
+                                  double *weights, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    // The same kernel runs at a different speed per rank with more ranks or threads on the node
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    char full_key[BALANCE_KEY_LEN];
+    snprintf(full_key, sizeof(full_key), "%s:ppn=%d:threads=%d", key, node_size, threads);
+    char host[MPI_MAX_PROCESSOR_NAME];
+    int host_len;
+    MPI_Get_processor_name(host, &host_len);
+    char path_buf[1024];
+    const char *path = balance_cache_path(path_buf, sizeof(path_buf));
+
+    // --- The node leader looks the node up; on a miss every rank of the node probes ---
+    double throughput = 0.0;
+    if (node_rank == 0)
+    {
+        throughput = balance_cache_lookup(path, host, full_key);
+    }
+    MPI_Bcast(&throughput, 1, MPI_DOUBLE, 0, node_comm);
+    int probed = throughput <= 0.0;
+    if (probed)
+    {
+        MPI_Barrier(node_comm); // Probe together, as the ranks will run together
+        double mine = balance_measure(probe, ctx, units);
+        MPI_Allreduce(&mine, &throughput, 1, MPI_DOUBLE, MPI_SUM, node_comm);
+        throughput /= node_size;
+        FILE *fp = (node_rank == 0 && path != NULL) ? fopen(path, "a") : NULL;
+        if (fp != NULL)
+        {
+            fprintf(fp, "%s %s %.6e\n", host, full_key, throughput); // One short write, whole line
+            fclose(fp);
+        }
+    }
+
+    // --- Shares of all ranks ---
+    MPI_Allgather(&throughput, 1, MPI_DOUBLE, weights, 1, MPI_DOUBLE, comm);
+    double total = 0.0;
+    for (int r = 0; r < size; r++)
+    {
+        total += weights[r];
+    }
+    for (int r = 0; r < size; r++)
+    {
+        weights[r] /= total;
+    }
+    int nodes_probed = probed && node_rank == 0;
+    MPI_Allreduce(MPI_IN_PLACE, &nodes_probed, 1, MPI_INT, MPI_SUM, comm);
+    MPI_Comm_free(&node_comm);
+    return nodes_probed;
+}
+
+// Contiguous ranges of n items in proportion to weights: part p gets [starts[p], starts[p + 1]).
+// starts has parts + 1 entries. Cumulative rounding keeps every count within one item of its
+// exact share and the ranges exactly cover [0, n).
+static inline void balance_split(long long n, const double *weights, int parts, long long *starts)
+{
+    double cumulative = 0.0;
+    starts[0] = 0;
+    for (int p = 0; p < parts; p++)
+    {
+        cumulative += weights[p];
+        long long end = (long long)((double)n * cumulative + 0.5);
+        end = end > n ? n : end;
+        starts[p + 1] = end < starts[p] ? starts[p] : end;
+    }
+    starts[parts] = n;
+}
+
+// One line on the communicator's rank 0: where the weights came from and the spread of shares
+static inline void balance_print(const double *weights, int nodes_probed, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    if (rank != 0)
+    {
+        return;
+    }
+    double min = weights[0], max = weights[0];
+    for (int r = 1; r < size; r++)
+    {
+        min = weights[r] < min ? weights[r] : min;
+        max = weights[r] > max ? weights[r] : max;
+    }
+    printf("Balanced split: shares %.1f%% to %.1f%% of the work (even: %.1f%%), ", 100.0 * min, 100.0 * max,
+           100.0 / size);
+    if (nodes_probed > 0)
+    {
+        printf("probed on %d node%s\n", nodes_probed, nodes_probed == 1 ? "" : "s");
+    }
+    else
+    {
+        printf("from the per-host cache\n");
+    }
+}
+
+#endif // BALANCE_H
@@ -0,0 +1,267 @@
+#ifndef COLLECTIVES_H
+#define COLLECTIVES_H
+
+// Allreduce algorithms written on top of point-to-point calls, as a drop-in alternative to
+// MPI_Allreduce when the library's own choice is poor for the network at hand.
+//
+//   coll_allreduce                    same arguments as MPI_Allreduce, picks an algorithm by size
+//   coll_allreduce_ring               bandwidth-optimal: reduce-scatter + allgather around the ring,
+//                                     in segments so the hops of one chunk overlap
+//   coll_allreduce_recursive_doubling latency-optimal: log2(P) full-vector exchanges
+//
+// Only predefined (contiguous) datatypes and commutative operations take the custom paths;
+// anything else is passed on to MPI_Allreduce. MPI_IN_PLACE is accepted as sendbuf.
+// Messages use tag COLL_TAG on the caller's communicator, so that tag should not be in flight
+// in user code during a call.
+//
+// Header-only so that every program in this directory can include it and still build from a
+// single source file (see compile.sh).
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef COLL_RING_THRESHOLD
+#define COLL_RING_THRESHOLD (64 << 10) // Vectors of at least this many bytes use the ring
+#endif
+#ifndef COLL_SEGMENT_BYTES
+#define COLL_SEGMENT_BYTES (128 << 10) // Pipelining unit of the ring
+#endif
+#define COLL_TAG 32000 // Below the smallest MPI_TAG_UB the standard allows (32767)
+
+// Start and length of piece `index` when `count` elements are split into `parts` balanced pieces
+static inline void coll_piece(int count, int parts, int index, int *offset, int *length)
+{
+    int base = count / parts, remainder = count % parts;
+    *length = base + (index < remainder ? 1 : 0);
+    *offset = index * base + (index < remainder ? index : remainder);
+}
+
+// Start and length of segment j of ring chunk c (offsets in elements from the vector start)
+static inline void coll_segment(int count, int size, int num_segs, int c, int j, int *offset, int *length)
+{
+    int chunk_offset, chunk_length, seg_offset;
+    coll_piece(count, size, c, &chunk_offset, &chunk_length);
+    coll_piece(chunk_length, num_segs, j, &seg_offset, length);
+    *offset = chunk_offset + seg_offset;
+}
+
+// Ring allreduce. The vector is cut into one chunk per rank. In the reduce-scatter phase each
+// chunk travels once around the ring, picking up every rank's contribution; in the allgather
+// phase the finished chunks travel around once more. Every rank sends and receives
+// 2 (P-1)/P of the vector in total, independent of P.
+// Chunks are cut into segments of about COLL_SEGMENT_BYTES: a segment is forwarded to the next
+// rank as soon as it has been reduced, so the next hop starts before the whole chunk arrived.
+static inline int coll_allreduce_ring(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type,
+                                      MPI_Op op, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Aint lb, extent;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Type_get_extent(type, &lb, &extent);
+    char *buf = (char *)recvbuf;
+    if (sendbuf != MPI_IN_PLACE)
+    {
+        memcpy(buf, sendbuf, (size_t)count * extent);
+    }
+    if (size == 1 || count == 0)
+    {
+        return MPI_SUCCESS;
+    }
+
+    int next_rank = (rank + 1) % size;
+    int prev_rank = (rank - 1 + size) % size;
+    int max_chunk = (count + size - 1) / size;
+    int seg_elems = COLL_SEGMENT_BYTES / (int)extent > 0 ? COLL_SEGMENT_BYTES / (int)extent : 1;
+    int num_segs = (max_chunk + seg_elems - 1) / seg_elems;
+    if (num_segs < 1)
+    {
+        num_segs = 1;
+    }
+    int max_seg = (max_chunk + num_segs - 1) / num_segs;
+
+    char *tmp = malloc(2 * (size_t)(max_seg > 0 ? max_seg : 1) * extent); // Double-buffered incoming segments
+    MPI_Request *send_reqs = malloc(num_segs * sizeof(MPI_Request));
+    MPI_Request *recv_reqs = malloc(num_segs * sizeof(MPI_Request));
+    if (tmp == NULL || send_reqs == NULL || recv_reqs == NULL)
+    {
+        free(tmp);
+        free(send_reqs);
+        free(recv_reqs);
+        return MPI_Allreduce(MPI_IN_PLACE, recvbuf, count, type, op, comm);
+    }
+    int offset, length;
+
+    // --- Reduce-scatter: at step s receive chunk rank-s-1, add the local part, pass it on ---
+    for (int j = 0; j < num_segs; j++)
+    {
+        coll_segment(count, size, num_segs, rank, j, &offset, &length);
+        MPI_Isend(buf + offset * extent, length, type, next_rank, COLL_TAG, comm, &send_reqs[j]);
+    }
+    for (int s = 0; s < size - 1; s++)
+    {
+        int c = (rank - s - 1 + size) % size;
+        coll_segment(count, size, num_segs, c, 0, &offset, &length);
+        MPI_Irecv(tmp, length, type, prev_rank, COLL_TAG, comm, &recv_reqs[0]);
+        for (int j = 0; j < num_segs; j++)
+        {
+            if (j + 1 < num_segs)
+            {
+                // The next segment lands in the other half of tmp while this one is reduced
+                int next_offset, next_length;
+                coll_segment(count, size, num_segs, c, j + 1, &next_offset, &next_length);
+                MPI_Irecv(tmp + ((j + 1) % 2) * max_seg * extent, next_length, type, prev_rank, COLL_TAG, comm,
+                          &recv_reqs[(j + 1) % 2]);
+            }
+            coll_segment(count, size, num_segs, c, j, &offset, &length);
+            MPI_Wait(&recv_reqs[j % 2], MPI_STATUS_IGNORE);
+            MPI_Reduce_local(tmp + (j % 2) * max_seg * extent, buf + offset * extent, length, type, op);
+            if (s < size - 2)
+            {
+                MPI_Wait(&send_reqs[j], MPI_STATUS_IGNORE); // Segment j of the previous step has left
+                MPI_Isend(buf + offset * extent, length, type, next_rank, COLL_TAG, comm, &send_reqs[j]);
+            }
+        }
+    }
+    MPI_Waitall(num_segs, send_reqs, MPI_STATUSES_IGNORE);
+
+    // --- Allgather: this rank now owns the finished chunk rank+1; circulate all chunks ---
+    for (int j = 0; j < num_segs; j++)
+    {
+        coll_segment(count, size, num_segs, (rank + 1) % size, j, &offset, &length);
+        MPI_Isend(buf + offset * extent, length, type, next_rank, COLL_TAG, comm, &send_reqs[j]);
+    }
+    for (int s = 0; s < size - 1; s++)
+    {
+        int c = (rank - s + size) % size;
+        for (int j = 0; j < num_segs; j++)
+        {
+            coll_segment(count, size, num_segs, c, j, &offset, &length);
+            MPI_Irecv(buf + offset * extent, length, type, prev_rank, COLL_TAG, comm, &recv_reqs[j]);
+        }
+        for (int j = 0; j < num_segs; j++)
+        {
+            MPI_Wait(&recv_reqs[j], MPI_STATUS_IGNORE);
+            if (s < size - 2)
+            {
+                coll_segment(count, size, num_segs, c, j, &offset, &length);
+                MPI_Wait(&send_reqs[j], MPI_STATUS_IGNORE);
+                MPI_Isend(buf + offset * extent, length, type, next_rank, COLL_TAG, comm, &send_reqs[j]);
+            }
+        }
+    }
+    MPI_Waitall(num_segs, send_reqs, MPI_STATUSES_IGNORE);
+
+    free(tmp);
+    free(send_reqs);
+    free(recv_reqs);
+    return MPI_SUCCESS;
+}
+
+// Recursive doubling allreduce: log2(P) rounds, each exchanging the whole vector with the rank
+// whose number differs in one bit. Few messages, so best for short vectors.
+// When P is not a power of two the first 2*rem ranks pair up first (even sends to odd), so a
+// power of two of ranks take part in the exchange, and the odd ranks hand the result back.
+static inline int coll_allreduce_recursive_doubling(const void *sendbuf, void *recvbuf, int count,
+                                                    MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Aint lb, extent;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Type_get_extent(type, &lb, &extent);
+    if (sendbuf != MPI_IN_PLACE)
+    {
+        memcpy(recvbuf, sendbuf, (size_t)count * extent);
+    }
+    if (size == 1 || count == 0)
+    {
+        return MPI_SUCCESS;
+    }
+
+    char *tmp = malloc((size_t)count * extent);
+    if (tmp == NULL)
+    {
+        return MPI_Allreduce(MPI_IN_PLACE, recvbuf, count, type, op, comm);
+    }
+    int pof2 = 1;
+    while (pof2 * 2 <= size)
+    {
+        pof2 *= 2;
+    }
+    int rem = size - pof2;
+
+    // Fold the extra ranks into their odd neighbours
+    int new_rank;
+    if (rank < 2 * rem)
+    {
+        if (rank % 2 == 0)
+        {
+            MPI_Send(recvbuf, count, type, rank + 1, COLL_TAG, comm);
+            new_rank = -1; // Sits out the exchange
+        }
+        else
+        {
+            MPI_Recv(tmp, count, type, rank - 1, COLL_TAG, comm, MPI_STATUS_IGNORE);
+            MPI_Reduce_local(tmp, recvbuf, count, type, op);
+            new_rank = rank / 2;
+        }
+    }
+    else
+    {
+        new_rank = rank - rem;
+    }
+
+    if (new_rank >= 0)
+    {
+        for (int mask = 1; mask < pof2; mask <<= 1)
+        {
+            int new_partner = new_rank ^ mask;
+            int partner = (new_partner < rem) ? 2 * new_partner + 1 : new_partner + rem;
+            MPI_Sendrecv(recvbuf, count, type, partner, COLL_TAG, tmp, count, type, partner, COLL_TAG, comm,
+                         MPI_STATUS_IGNORE);
+            // Both partners combine the same two operands, so every rank ends with identical bits
+            MPI_Reduce_local(tmp, recvbuf, count, type, op);
+        }
+    }
+
+    if (rank < 2 * rem)
+    {
+        if (rank % 2 == 0)
+        {
+            MPI_Recv(recvbuf, count, type, rank + 1, COLL_TAG, comm, MPI_STATUS_IGNORE);
+        }
+        else
+        {
+            MPI_Send(recvbuf, count, type, rank - 1, COLL_TAG, comm);
+        }
+    }
+    free(tmp);
+    return MPI_SUCCESS;
+}
+
+// Allreduce with the same arguments as MPI_Allreduce: recursive doubling below
+// COLL_RING_THRESHOLD bytes (or when there are fewer elements than ranks), the segmented ring
+// above it, MPI_Allreduce itself for derived datatypes and non-commutative operations.
+static inline int coll_allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                                 MPI_Comm comm)
+{
+    int size, type_size, commutative;
+    MPI_Aint lb, extent;
+    MPI_Comm_size(comm, &size);
+    MPI_Type_size(type, &type_size);
+    MPI_Type_get_extent(type, &lb, &extent);
+    MPI_Op_commutative(op, &commutative);
+    if (type_size != extent || lb != 0 || !commutative)
+    {
+        return MPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    }
+    if ((long long)count * extent < COLL_RING_THRESHOLD || count < size)
+    {
+        return coll_allreduce_recursive_doubling(sendbuf, recvbuf, count, type, op, comm);
+    }
+    return coll_allreduce_ring(sendbuf, recvbuf, count, type, op, comm);
+}
+
+#endif // COLLECTIVES_H
@@ -0,0 +1,805 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // For strcmp, memcpy, memset
+#include <unistd.h> // For getopt
+#include <math.h>   // For fabs
+#ifdef _OPENMP
+#include <omp.h> // For omp_get_max_threads
+#endif
+
+// Distributed dense matrix-matrix product C = A * B on a pr x pc process grid, the compute-bound
+// counterpart of vector-matrix.c. A, B and C are split into the same 2D blocks (row block r and
+// column block c on grid rank (r, c)); every rank generates its own blocks in place.
+//   SUMMA:  for every panel of the inner dimension, the grid column that owns the A panel
+//           broadcasts it along the grid rows and the grid row that owns the B panel broadcasts it
+//           along the grid columns; every rank adds panel A * panel B to its C block. The
+//           broadcast of panel s+1 is posted (MPI_Ibcast) before panel s is multiplied.
+//   Cannon: square grids only. After an initial skew, A blocks shift left along the grid rows and
+//           B blocks shift up along the grid columns, one step per block; the next shift is
+//           posted before the current blocks are multiplied.
+// The local kernel is a packed, cache- and register-blocked GEMM threaded with OpenMP.
+// Every grid shape of the process count can be swept in one run (-g all); the report gives
+// GFLOP/s and the parallel efficiency against the local kernel speed of all processes together.
+
+#define DEFAULT_N 1024    // Matrix dimension if none is given on the command line
+#define DEFAULT_PANEL 256 // Inner-dimension width of one SUMMA panel
+#define DEFAULT_REPS 3    // Timed products per configuration, the fastest counts
+#define PROBE_N 768       // Size of the square local product that measures the kernel speed
+#define ALIGNMENT 64      // Cache-line alignment for every heap buffer
+
+// Local kernel blocking: an MR x NR tile of C stays in registers while a KC-long strip of packed
+// A and B streams through it; MC x KC of packed A fits in L2, KC x NC of packed B in L3.
+// The tile is sized for the vector ISA the file is compiled for, so that its accumulators take
+// half of the vector registers. compile.sh builds with plain -O2, which on x86-64 means SSE2;
+// adding -march=native to its FLAGS selects the AVX2 or AVX-512 tile (about 2.5x / 3.5x faster).
+#if defined(__AVX512F__)
+#define MR 8  // Rows of the register tile
+#define NR 16 // Columns of the register tile: 8 x 16 doubles = 16 of the 32 zmm registers
+#elif defined(__AVX__)
+#define MR 4
+#define NR 8 // 4 x 8 doubles = 8 of the 16 ymm registers
+#else
+#define MR 4
+#define NR 4 // 4 x 4 doubles = 8 of the 16 xmm registers (SSE2)
+#endif
+#define MC 128  // Rows of A packed per thread block
+#define KC 256  // Depth of the packed panels
+#define NC 2048 // Columns of B packed at once
+
+enum algorithm
+{
+    ALG_SUMMA = 1,
+    ALG_CANNON = 2,
+    ALG_BOTH = 3
+};
+
+const char *algorithm_names[] = {NULL, "summa", "cannon"};
+
+// One process grid with the communicators along its rows and columns
+struct grid
+{
+    MPI_Comm comm, row_comm, col_comm; // Cartesian grid; ranks of my grid row; ranks of my grid column
+    int pr, pc;                        // Grid shape
+    int my_row, my_col;                // My coordinates (= my rank in col_comm / row_comm)
+    int *row_counts, *row_displs;      // Row blocks of the matrices over the pr grid rows
+    int *col_counts, *col_displs;      // Column blocks over the pc grid columns
+};
+
+// One SUMMA panel: inner-dimension columns [k, k + kb), owned by grid column a_owner (A) and
+// grid row b_owner (B)
+struct summa_step
+{
+    int k, kb, a_owner, b_owner;
+};
+
+// Times of one product on this rank
+struct run_times
+{
+    double total, compute, wait;
+};
+
+// Allocate a contiguous, cache-line aligned array of doubles (NULL on failure)
+double *alloc_doubles(size_t count)
+{
+    void *ptr = NULL;
+    if (count == 0)
+    {
+        count = 1; // Keep a valid pointer even for empty blocks
+    }
+    if (posix_memalign(&ptr, ALIGNMENT, count * sizeof(double)) != 0)
+    {
+        return NULL;
+    }
+    return (double *)ptr;
+}
+
+// Split n items as evenly as possible over parts: the first (n % parts) parts get one extra item
+void compute_block_distribution(int n, int parts, int *counts, int *displs)
+{
+    int per_part = n / parts;
+    int remainder = n % parts;
+    int offset = 0;
+    for (int p = 0; p < parts; p++)
+    {
+        counts[p] = per_part + (p < remainder ? 1 : 0);
+        displs[p] = offset;
+        offset += counts[p];
+    }
+}
+
+// Part that holds item index under a distribution
+int block_owner(int parts, const int *counts, const int *displs, int index)
+{
+    for (int p = 0; p < parts; p++)
+    {
+        if (index < displs[p] + counts[p])
+        {
+            return p;
+        }
+    }
+    return parts - 1;
+}
+
+// Deterministic small-integer test data: every product and partial sum is an exact double, so
+// the check below can demand an exact match.
+double a_entry(int i, int j)
+{
+    return (double)((i + 2 * j) % 7 - 3);
+}
+
+double b_entry(int i, int j)
+{
+    return (double)((3 * i + j) % 5 - 2);
+}
+
+double v_entry(int j)
+{
+    return (double)(1 + j % 3);
+}
+
+// --- Local kernel ---
+
+// Copy rows [0, m) x depth [0, kc) of A into MR-row strips: strip s holds kc columns of MR values,
+// rows past m padded with zeros so the micro-kernel never needs a short path for them.
+void pack_a(int m, int kc, const double *A, int lda, double *packed)
+{
+    for (int i0 = 0; i0 < m; i0 += MR)
+    {
+        for (int p = 0; p < kc; p++)
+        {
+            for (int i = 0; i < MR; i++)
+            {
+                *packed++ = (i0 + i < m) ? A[(size_t)(i0 + i) * lda + p] : 0.0;
+            }
+        }
+    }
+}
+
+// Copy depth [0, kc) x columns [0, n) of B into NR-column strips, zero-padded like pack_a
+void pack_b(int kc, int n, const double *B, int ldb, double *packed)
+{
+#pragma omp parallel for schedule(static)
+    for (int j0 = 0; j0 < n; j0 += NR)
+    {
+        double *strip = packed + (size_t)(j0 / NR) * kc * NR;
+        for (int p = 0; p < kc; p++)
+        {
+            const double *b = &B[(size_t)p * ldb + j0];
+            for (int j = 0; j < NR; j++)
+            {
+                strip[p * NR + j] = (j0 + j < n) ? b[j] : 0.0;
+            }
+        }
+    }
+}
+
+// C[mr x nr] += packed A strip * packed B strip. Both tile loops are unrolled completely, so
+// every accumulator has a fixed index: the compiler keeps them in registers for the whole kc loop
+// and vectorizes along j. (Left as loops, acc stays on the stack and the kernel is no faster than
+// a plain i-k-j loop.)
+static inline void micro_kernel(int kc, const double *a, const double *b, double *C, int ldc, int mr, int nr)
+{
+    double acc[MR][NR] = {{0.0}};
+    for (int p = 0; p < kc; p++)
+    {
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; i++)
+        {
+#pragma GCC unroll 16
+            for (int j = 0; j < NR; j++)
+            {
+                acc[i][j] += a[p * MR + i] * b[p * NR + j];
+            }
+        }
+    }
+    for (int i = 0; i < mr; i++)
+    {
+        for (int j = 0; j < nr; j++)
+        {
+            C[(size_t)i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+// Packing buffers of local_gemm: one KC x NC panel of B shared by the threads and one MC x KC
+// block of A per thread. Allocated once per product, not per panel or step.
+struct pack_buffers
+{
+    double *b;
+    double *a; // Thread t packs into a + t * PACK_A_DOUBLES
+};
+
+#define PACK_A_DOUBLES ((size_t)(MC + MR) * KC)
+
+// Allocate the packing buffers for the OpenMP threads of this process; aborts if that fails
+void alloc_pack_buffers(struct pack_buffers *pack)
+{
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    pack->b = alloc_doubles((size_t)KC * (NC + NR));
+    pack->a = alloc_doubles(PACK_A_DOUBLES * threads);
+    if (pack->b == NULL || pack->a == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the packing buffers for %d threads.\n", threads);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+void free_pack_buffers(struct pack_buffers *pack)
+{
+    free(pack->b);
+    free(pack->a);
+}
+
+// C[m x n] += A[m x k] * B[k x n], row-major with leading dimensions lda, ldb, ldc.
+// B is packed once per KC x NC block and shared by the threads; each thread packs its own MC x KC
+// blocks of A (dynamic schedule) and runs the micro-kernel over them.
+void local_gemm(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+                const struct pack_buffers *pack)
+{
+    if (m == 0 || n == 0 || k == 0)
+    {
+        return;
+    }
+    double *packed_b = pack->b;
+    for (int jc = 0; jc < n; jc += NC)
+    {
+        int nc = (n - jc < NC) ? n - jc : NC;
+        for (int pc = 0; pc < k; pc += KC)
+        {
+            int kc = (k - pc < KC) ? k - pc : KC;
+            pack_b(kc, nc, &B[(size_t)pc * ldb + jc], ldb, packed_b);
+
+#pragma omp parallel
+            {
+                int thread = 0;
+#ifdef _OPENMP
+                thread = omp_get_thread_num();
+#endif
+                double *packed_a = pack->a + thread * PACK_A_DOUBLES;
+#pragma omp for schedule(dynamic)
+                for (int ic = 0; ic < m; ic += MC)
+                {
+                    int mc = (m - ic < MC) ? m - ic : MC;
+                    pack_a(mc, kc, &A[(size_t)ic * lda + pc], lda, packed_a);
+                    for (int jr = 0; jr < nc; jr += NR)
+                    {
+                        const double *b = packed_b + (size_t)(jr / NR) * kc * NR;
+                        int nr = (nc - jr < NR) ? nc - jr : NR;
+                        for (int ir = 0; ir < mc; ir += MR)
+                        {
+                            int mr = (mc - ir < MR) ? mc - ir : MR;
+                            micro_kernel(kc, packed_a + (size_t)(ir / MR) * kc * MR, b,
+                                         &C[(size_t)(ic + ir) * ldc + jc + jr], ldc, mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// GFLOP/s of local_gemm on a square product of size n, run on all ranks at once (so ranks that
+// share a node also share its cores, as they do in the distributed product)
+double local_kernel_gflops(int n)
+{
+    double *A = alloc_doubles((size_t)n * n), *B = alloc_doubles((size_t)n * n), *C = alloc_doubles((size_t)n * n);
+    if (A == NULL || B == NULL || C == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the %d x %d kernel probe.\n", n, n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (size_t i = 0; i < (size_t)n * n; i++)
+    {
+        A[i] = 1.0;
+        B[i] = 1.0;
+        C[i] = 0.0;
+    }
+    struct pack_buffers pack;
+    alloc_pack_buffers(&pack);
+    local_gemm(n, n, n, A, n, B, n, C, n, &pack); // Warm-up
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    local_gemm(n, n, n, A, n, B, n, C, n, &pack);
+    double seconds = MPI_Wtime() - t0;
+    free_pack_buffers(&pack);
+    free(A);
+    free(B);
+    free(C);
+    return 2.0 * n * (double)n * n / seconds / 1e9;
+}
+
+// --- Grid setup ---
+
+void grid_create(int n, int pr, int pc, struct grid *g)
+{
+    int dims[2] = {pr, pc}, periods[2] = {1, 1}, coords[2];
+    int rank;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &g->comm);
+    MPI_Comm_rank(g->comm, &rank);
+    MPI_Cart_coords(g->comm, rank, 2, coords);
+    int keep_cols[2] = {0, 1}, keep_rows[2] = {1, 0};
+    MPI_Cart_sub(g->comm, keep_cols, &g->row_comm); // Same grid row, ordered by column
+    MPI_Cart_sub(g->comm, keep_rows, &g->col_comm); // Same grid column, ordered by row
+    g->pr = pr;
+    g->pc = pc;
+    g->my_row = coords[0];
+    g->my_col = coords[1];
+    g->row_counts = malloc(pr * sizeof(int));
+    g->row_displs = malloc(pr * sizeof(int));
+    g->col_counts = malloc(pc * sizeof(int));
+    g->col_displs = malloc(pc * sizeof(int));
+    compute_block_distribution(n, pr, g->row_counts, g->row_displs);
+    compute_block_distribution(n, pc, g->col_counts, g->col_displs);
+}
+
+void grid_free(struct grid *g)
+{
+    MPI_Comm_free(&g->row_comm);
+    MPI_Comm_free(&g->col_comm);
+    MPI_Comm_free(&g->comm);
+    free(g->row_counts);
+    free(g->row_displs);
+    free(g->col_counts);
+    free(g->col_displs);
+}
+
+// Fill this rank's blocks of A and B (rows x cols, row-major) from the global indices
+void generate_blocks(const struct grid *g, double *A, double *B)
+{
+    int rows = g->row_counts[g->my_row], cols = g->col_counts[g->my_col];
+    int r0 = g->row_displs[g->my_row], c0 = g->col_displs[g->my_col];
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            A[(size_t)i * cols + j] = a_entry(r0 + i, c0 + j);
+            B[(size_t)i * cols + j] = b_entry(r0 + i, c0 + j);
+        }
+    }
+}
+
+// --- SUMMA ---
+
+// Post the broadcasts of the panel [k, k + kb): the A columns from grid column a_owner along my
+// grid row, the B rows from grid row b_owner along my grid column
+void summa_post(const struct grid *g, const struct summa_step *step, const double *A, const double *B,
+                double *panel_a, double *panel_b, MPI_Request *requests)
+{
+    int rows = g->row_counts[g->my_row], cols = g->col_counts[g->my_col];
+    int kb = step->kb;
+    if (g->my_col == step->a_owner)
+    {
+        int offset = step->k - g->col_displs[step->a_owner];
+        for (int i = 0; i < rows; i++)
+        {
+            memcpy(&panel_a[(size_t)i * kb], &A[(size_t)i * cols + offset], kb * sizeof(double));
+        }
+    }
+    if (g->my_row == step->b_owner)
+    {
+        memcpy(panel_b, &B[(size_t)(step->k - g->row_displs[step->b_owner]) * cols], (size_t)kb * cols * sizeof(double));
+    }
+    MPI_Ibcast(panel_a, rows * kb, MPI_DOUBLE, step->a_owner, g->row_comm, &requests[0]);
+    MPI_Ibcast(panel_b, kb * cols, MPI_DOUBLE, step->b_owner, g->col_comm, &requests[1]);
+}
+
+// C += A * B with SUMMA. Panels never cross a block boundary of A's columns or B's rows, so each
+// has exactly one owner; two panel buffers let panel s+1 travel while panel s is multiplied.
+void summa(int n, int panel, const struct grid *g, const double *A, const double *B, double *C,
+           struct run_times *times)
+{
+    int rows = g->row_counts[g->my_row], cols = g->col_counts[g->my_col];
+    double *panel_a[2], *panel_b[2];
+    for (int s = 0; s < 2; s++)
+    {
+        panel_a[s] = alloc_doubles((size_t)rows * panel);
+        panel_b[s] = alloc_doubles((size_t)panel * cols);
+        if (panel_a[s] == NULL || panel_b[s] == NULL)
+        {
+            fprintf(stderr, "Error: Cannot allocate SUMMA panels of width %d.\n", panel);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    struct pack_buffers pack;
+    alloc_pack_buffers(&pack);
+
+    // Panels: the panel width, cut short at block edges of either distribution (at most one
+    // extra cut per block edge)
+    struct summa_step *steps = malloc((n / panel + g->pr + g->pc + 1) * sizeof(struct summa_step));
+    int num_steps = 0;
+    for (int k = 0; k < n; num_steps++)
+    {
+        int a_owner = block_owner(g->pc, g->col_counts, g->col_displs, k);
+        int b_owner = block_owner(g->pr, g->row_counts, g->row_displs, k);
+        int a_end = g->col_displs[a_owner] + g->col_counts[a_owner];
+        int b_end = g->row_displs[b_owner] + g->row_counts[b_owner];
+        int end = k + panel;
+        end = end < a_end ? end : a_end;
+        end = end < b_end ? end : b_end;
+        steps[num_steps].k = k;
+        steps[num_steps].kb = end - k;
+        steps[num_steps].a_owner = a_owner;
+        steps[num_steps].b_owner = b_owner;
+        k = end;
+    }
+
+    MPI_Request requests[2][2];
+    double start = MPI_Wtime();
+    for (int s = 0; s < num_steps; s++)
+    {
+        int cur = s % 2, nxt = 1 - cur;
+        if (s == 0)
+        {
+            summa_post(g, &steps[0], A, B, panel_a[0], panel_b[0], requests[0]);
+        }
+        if (s + 1 < num_steps)
+        {
+            summa_post(g, &steps[s + 1], A, B, panel_a[nxt], panel_b[nxt], requests[nxt]);
+        }
+        double t0 = MPI_Wtime();
+        MPI_Waitall(2, requests[cur], MPI_STATUSES_IGNORE);
+        double t1 = MPI_Wtime();
+        local_gemm(rows, cols, steps[s].kb, panel_a[cur], steps[s].kb, panel_b[cur], cols, C, cols, &pack);
+        times->wait += t1 - t0;
+        times->compute += MPI_Wtime() - t1;
+    }
+    times->total = MPI_Wtime() - start;
+
+    free(steps);
+    free_pack_buffers(&pack);
+    for (int s = 0; s < 2; s++)
+    {
+        free(panel_a[s]);
+        free(panel_b[s]);
+    }
+}
+
+// --- Cannon ---
+
+// C += A * B with Cannon's algorithm on a q x q grid. Rank (i, j) starts with A(i, j) and B(i, j);
+// the skew gives it A(i, i + j) and B(i + j, j), and step s multiplies A(i, kk) * B(kk, j) with
+// kk = i + j + s (mod q) while the blocks of step s+1 are already on their way.
+void cannon(const struct grid *g, const double *A, const double *B, double *C, struct run_times *times)
+{
+    int q = g->pr, i = g->my_row, j = g->my_col;
+    int rows = g->row_counts[i], cols = g->col_counts[j];
+    int max_block = g->row_counts[0]; // Largest block dimension (the first block gets the remainder)
+    double *a_buf[2], *b_buf[2];
+    for (int s = 0; s < 2; s++)
+    {
+        a_buf[s] = alloc_doubles((size_t)rows * max_block);
+        b_buf[s] = alloc_doubles((size_t)max_block * cols);
+        if (a_buf[s] == NULL || b_buf[s] == NULL)
+        {
+            fprintf(stderr, "Error: Cannot allocate Cannon block buffers.\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    struct pack_buffers pack;
+    alloc_pack_buffers(&pack);
+
+    double start = MPI_Wtime();
+    double t0 = MPI_Wtime();
+    // Skew: A(i, j) goes i places left along the grid row, B(i, j) j places up the grid column
+    int kk = (i + j) % q;
+    MPI_Sendrecv(A, rows * cols, MPI_DOUBLE, (j - i + q) % q, 0, a_buf[0], rows * g->col_counts[kk], MPI_DOUBLE,
+                 kk, 0, g->row_comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(B, rows * cols, MPI_DOUBLE, (i - j + q) % q, 1, b_buf[0], g->row_counts[kk] * cols, MPI_DOUBLE,
+                 kk, 1, g->col_comm, MPI_STATUS_IGNORE);
+    times->wait += MPI_Wtime() - t0;
+
+    for (int s = 0; s < q; s++)
+    {
+        int cur = s % 2, nxt = 1 - cur;
+        int depth = g->col_counts[kk];
+        int next_kk = (kk + 1) % q;
+        MPI_Request requests[4];
+        int num_requests = 0;
+        if (s + 1 < q)
+        {
+            // Shift by one: receive A(i, kk + 1) from the right and B(kk + 1, j) from below
+            MPI_Irecv(a_buf[nxt], rows * g->col_counts[next_kk], MPI_DOUBLE, (j + 1) % q, 2, g->row_comm,
+                      &requests[num_requests++]);
+            MPI_Irecv(b_buf[nxt], g->row_counts[next_kk] * cols, MPI_DOUBLE, (i + 1) % q, 3, g->col_comm,
+                      &requests[num_requests++]);
+            MPI_Isend(a_buf[cur], rows * depth, MPI_DOUBLE, (j - 1 + q) % q, 2, g->row_comm,
+                      &requests[num_requests++]);
+            MPI_Isend(b_buf[cur], depth * cols, MPI_DOUBLE, (i - 1 + q) % q, 3, g->col_comm,
+                      &requests[num_requests++]);
+        }
+        double t1 = MPI_Wtime();
+        local_gemm(rows, cols, depth, a_buf[cur], depth, b_buf[cur], cols, C, cols, &pack);
+        double t2 = MPI_Wtime();
+        MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+        times->compute += t2 - t1;
+        times->wait += MPI_Wtime() - t2;
+        kk = next_kk;
+    }
+    times->total = MPI_Wtime() - start;
+
+    free_pack_buffers(&pack);
+    for (int s = 0; s < 2; s++)
+    {
+        free(a_buf[s]);
+        free(b_buf[s]);
+    }
+}
+
+// --- Verification ---
+
+// Largest |C v - A (B v)| over all rows, for v_j = 1 + j % 3. With the integer test data both
+// sides are exact, so anything but 0 is a wrong product. Collective over the grid.
+double verify(int n, const struct grid *g, const double *A, const double *B, const double *C)
+{
+    int rows = g->row_counts[g->my_row], cols = g->col_counts[g->my_col];
+    int c0 = g->col_displs[g->my_col];
+    double *part = calloc(rows, sizeof(double));     // Partial sums of my block rows
+    double *row_sums = calloc(rows, sizeof(double)); // Full sums over my grid row
+    double *w = calloc(n, sizeof(double));           // B v, all of it
+    double *cv = calloc(rows, sizeof(double));
+
+    // w = B v: the rows of my block, summed over the grid row, then gathered down the grid column
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            part[i] += B[(size_t)i * cols + j] * v_entry(c0 + j);
+        }
+    }
+    MPI_Allreduce(part, row_sums, rows, MPI_DOUBLE, MPI_SUM, g->row_comm);
+    MPI_Allgatherv(row_sums, rows, MPI_DOUBLE, w, g->row_counts, g->row_displs, MPI_DOUBLE, g->col_comm);
+
+    // A w and C v for my rows, summed over the grid row
+    for (int i = 0; i < rows; i++)
+    {
+        part[i] = 0.0;
+        cv[i] = 0.0;
+        for (int j = 0; j < cols; j++)
+        {
+            part[i] += A[(size_t)i * cols + j] * w[c0 + j];
+            cv[i] += C[(size_t)i * cols + j] * v_entry(c0 + j);
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, part, rows, MPI_DOUBLE, MPI_SUM, g->row_comm);
+    MPI_Allreduce(MPI_IN_PLACE, cv, rows, MPI_DOUBLE, MPI_SUM, g->row_comm);
+    double worst = 0.0;
+    for (int i = 0; i < rows; i++)
+    {
+        double err = fabs(cv[i] - part[i]);
+        worst = err > worst ? err : worst;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &worst, 1, MPI_DOUBLE, MPI_MAX, g->comm);
+    free(part);
+    free(row_sums);
+    free(w);
+    free(cv);
+    return worst;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-a summa|cannon|both] [-g RxC|all] [-p PANEL] [-r REPS] [N]\n", prog);
+    fprintf(stderr, "  -a ALG    Algorithm (default: both; cannon runs on square grids only)\n");
+    fprintf(stderr, "  -g RxC    Process grid, R * C = number of processes (default: MPI_Dims_create);\n");
+    fprintf(stderr, "            'all' sweeps every grid shape\n");
+    fprintf(stderr, "  -p PANEL  Width of the SUMMA panels (default: %d)\n", DEFAULT_PANEL);
+    fprintf(stderr, "  -r REPS   Timed products per configuration, the fastest counts (default: %d)\n", DEFAULT_REPS);
+    fprintf(stderr, "  N         Matrix dimension (default: %d)\n", DEFAULT_N);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size;
+    // Only the main thread makes MPI calls; OpenMP threads are used inside the local kernel
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+
+    // --- Argument Handling (Rank 0 parses and broadcasts the settings) ---
+    int n = DEFAULT_N, algorithms = ALG_BOTH, panel = DEFAULT_PANEL, reps = DEFAULT_REPS;
+    int grid_rows = 0, sweep = 0; // grid_rows 0: MPI_Dims_create
+    if (rank == 0)
+    {
+        int opt, grid_cols = 0;
+        while (n > 0 && (opt = getopt(argc, argv, "a:g:p:r:")) != -1)
+        {
+            if (opt == 'a' && strcmp(optarg, "summa") == 0)
+            {
+                algorithms = ALG_SUMMA;
+            }
+            else if (opt == 'a' && strcmp(optarg, "cannon") == 0)
+            {
+                algorithms = ALG_CANNON;
+            }
+            else if (opt == 'a' && strcmp(optarg, "both") == 0)
+            {
+                algorithms = ALG_BOTH;
+            }
+            else if (opt == 'g' && strcmp(optarg, "all") == 0)
+            {
+                sweep = 1;
+            }
+            else if (opt == 'g' && sscanf(optarg, "%dx%d", &grid_rows, &grid_cols) == 2 && grid_rows > 0 &&
+                     grid_rows * grid_cols == size)
+            {
+                sweep = 0;
+            }
+            else if (opt == 'p' && atoi(optarg) > 0)
+            {
+                panel = atoi(optarg);
+            }
+            else if (opt == 'r' && atoi(optarg) > 0)
+            {
+                reps = atoi(optarg);
+            }
+            else
+            {
+                print_usage(argv[0]);
+                if (opt == 'g')
+                {
+                    fprintf(stderr, "Error: The grid must be RxC with R * C = %d processes.\n", size);
+                }
+                n = -1; // Signal error
+            }
+        }
+        if (n > 0 && optind < argc)
+        {
+            n = atoi(argv[optind]);
+            if (n <= 0)
+            {
+                print_usage(argv[0]);
+                fprintf(stderr, "Error: Matrix dimension N must be a positive integer.\n");
+                n = -1; // Signal error
+            }
+        }
+    }
+    int settings[6] = {n, algorithms, panel, reps, grid_rows, sweep};
+    MPI_Bcast(settings, 6, MPI_INT, 0, MPI_COMM_WORLD);
+    n = settings[0];
+    algorithms = settings[1];
+    panel = settings[2];
+    reps = settings[3];
+    grid_rows = settings[4];
+    sweep = settings[5];
+    if (n <= 0)
+    {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // --- Grid shapes to run ---
+    int *shapes = malloc(size * sizeof(int)); // Grid row counts
+    int num_shapes = 0;
+    if (sweep)
+    {
+        for (int pr = 1; pr <= size; pr++)
+        {
+            if (size % pr == 0)
+            {
+                shapes[num_shapes++] = pr;
+            }
+        }
+    }
+    else if (grid_rows > 0)
+    {
+        shapes[num_shapes++] = grid_rows;
+    }
+    else
+    {
+        int dims[2] = {0, 0};
+        MPI_Dims_create(size, 2, dims);
+        shapes[num_shapes++] = dims[0];
+    }
+
+    // --- Local kernel speed: the reference for the parallel efficiency ---
+    int probe_n = n < PROBE_N ? n : PROBE_N;
+    double my_gflops = local_kernel_gflops(probe_n), sum_gflops;
+    MPI_Allreduce(&my_gflops, &sum_gflops, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        printf("Distributed GEMM: N=%d, %d processes x %d threads, SUMMA panel %d, best of %d\n", n, size,
+               num_threads, panel, reps);
+        printf("Local kernel: %.2f GFLOP/s on rank 0, %.2f GFLOP/s over all processes (%d x %d products)\n",
+               my_gflops, sum_gflops, probe_n, probe_n);
+        printf("Efficiency = GFLOP/s / local kernel GFLOP/s of all processes; comm = time waiting for blocks\n\n");
+        printf("%-8s %9s %12s %10s %12s %10s %8s %10s\n", "Alg", "Grid", "Time (s)", "GFLOP/s", "GFLOP/s/proc",
+               "Efficiency", "Comm", "Max error");
+    }
+
+    double flops = 2.0 * n * (double)n * n;
+    int failed = 0;
+    for (int s = 0; s < num_shapes; s++)
+    {
+        struct grid g;
+        grid_create(n, shapes[s], size / shapes[s], &g);
+        int rows = g.row_counts[g.my_row], cols = g.col_counts[g.my_col];
+        double *A = alloc_doubles((size_t)rows * cols);
+        double *B = alloc_doubles((size_t)rows * cols);
+        double *C = alloc_doubles((size_t)rows * cols);
+        int alloc_ok = A != NULL && B != NULL && C != NULL, all_ok;
+        MPI_Allreduce(&alloc_ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+        if (!all_ok)
+        {
+            if (rank == 0)
+            {
+                fprintf(stderr, "Error: Failed to allocate blocks for N=%d on one or more processes.\n", n);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        generate_blocks(&g, A, B);
+
+        for (int alg = ALG_SUMMA; alg <= ALG_CANNON; alg++)
+        {
+            if (!(algorithms & alg))
+            {
+                continue;
+            }
+            char shape[32];
+            snprintf(shape, sizeof(shape), "%dx%d", g.pr, g.pc);
+            if (alg == ALG_CANNON && g.pr != g.pc)
+            {
+                if (rank == 0 && !sweep)
+                {
+                    printf("%-8s %9s   (needs a square grid)\n", algorithm_names[alg], shape);
+                }
+                continue;
+            }
+
+            // Best of reps; the slowest rank sets the time of a product
+            double best[3] = {0.0, 0.0, 0.0}; // total, compute, wait of the slowest rank
+            double error = 0.0;
+            for (int r = 0; r < reps; r++)
+            {
+                memset(C, 0, (size_t)rows * cols * sizeof(double));
+                struct run_times times = {0.0, 0.0, 0.0};
+                MPI_Barrier(MPI_COMM_WORLD);
+                if (alg == ALG_SUMMA)
+                {
+                    summa(n, panel, &g, A, B, C, &times);
+                }
+                else
+                {
+                    cannon(&g, A, B, C, &times);
+                }
+                double mine[3] = {times.total, times.compute, times.wait}, slowest[3];
+                MPI_Allreduce(mine, slowest, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+                if (r == 0 || slowest[0] < best[0])
+                {
+                    memcpy(best, slowest, sizeof(best));
+                }
+            }
+            error = verify(n, &g, A, B, C);
+            failed |= error != 0.0;
+            if (rank == 0)
+            {
+                double gflops = flops / best[0] / 1e9;
+                printf("%-8s %9s %12.6f %10.2f %12.2f %9.1f%% %7.1f%% %10.3e\n", algorithm_names[alg], shape, best[0],
+                       gflops, gflops / size, 100.0 * gflops / sum_gflops, 100.0 * best[2] / best[0], error);
+                fflush(stdout);
+            }
+        }
+        free(A);
+        free(B);
+        free(C);
+        grid_free(&g);
+    }
+
+    if (rank == 0 && failed)
+    {
+        fprintf(stderr, "Error: A product did not match the reference check.\n");
+    }
+    free(shapes);
+    MPI_Finalize();
+    return failed ? 1 : 0;
+}
@@ -2,8 +2,69 @@
 #include <stdio.h>
 #include <unistd.h> // For gethostname
 #include <string.h>
+#include "topology.h" // For the rank-to-host map and the hierarchical collectives
 
-#define MAX_MESSAGE_SIZE 100
+#define MAX_MESSAGE_SIZE 128 // Room for the greeting with a hostname of up to 63 characters
+#define CHECK_COUNT 5        // Elements per collective in the topology self-check
+
+// Compare topo_reduce and topo_bcast with MPI_Reduce and MPI_Bcast for every root: a sum from
+// separate buffers, a maximum with MPI_IN_PLACE at the root (a leader root reduces straight into
+// its buffer, any other root receives the result from its leader) and a broadcast. The values are
+// integers, so any difference is a wrong result. On one machine, run with TOPO_FAKE_NODES (see
+// topology.h) so that the steps among the node leaders are checked as well. Returns the number of
+// mismatching results across all ranks. Collective over comm.
+static int check_topology_collectives(const struct topology *topo, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int mismatches = 0;
+    for (int root = 0; root < size; root++)
+    {
+        int values[CHECK_COUNT], expected[CHECK_COUNT], got[CHECK_COUNT];
+        for (int k = 0; k < CHECK_COUNT; k++)
+        {
+            values[k] = (rank + 1) * (k + 3) + root;
+        }
+        MPI_Reduce(values, expected, CHECK_COUNT, MPI_INT, MPI_SUM, root, comm);
+        topo_reduce(values, got, CHECK_COUNT, MPI_INT, MPI_SUM, root, topo, comm);
+        if (rank == root && memcmp(expected, got, sizeof(got)) != 0)
+        {
+            mismatches++;
+        }
+
+        double mine[CHECK_COUNT], expected_max[CHECK_COUNT], got_max[CHECK_COUNT];
+        for (int k = 0; k < CHECK_COUNT; k++)
+        {
+            mine[k] = (double)((rank * 7 + k * 3 + root) % (size + 2));
+            got_max[k] = mine[k];
+        }
+        MPI_Reduce(mine, expected_max, CHECK_COUNT, MPI_DOUBLE, MPI_MAX, root, comm);
+        topo_reduce(rank == root ? MPI_IN_PLACE : got_max, got_max, CHECK_COUNT, MPI_DOUBLE, MPI_MAX, root, topo,
+                    comm);
+        if (rank == root && memcmp(expected_max, got_max, sizeof(got_max)) != 0)
+        {
+            mismatches++;
+        }
+
+        // Broadcast: every rank must end up with the root's data
+        for (int k = 0; k < CHECK_COUNT; k++)
+        {
+            expected[k] = root * 1000 + k;
+            got[k] = rank == root ? expected[k] : -1;
+        }
+        topo_bcast(got, CHECK_COUNT, MPI_INT, root, topo, comm);
+        if (memcmp(expected, got, sizeof(got)) != 0)
+        {
+            mismatches++;
+        }
+    }
+
+    int total;
+    MPI_Allreduce(&mismatches, &total, 1, MPI_INT, MPI_SUM, comm);
+    return total;
+}
 
 int main(int argc, char **argv)
 {
@@ -19,8 +80,13 @@ int main(int argc, char **argv)
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
     // Get the hostname of the node where this process is running
-    // char hostname[256]; // Hostname isn't used in the final print, can be removed if not needed
-    // gethostname(hostname, sizeof(hostname));
+    char hostname[64];
+    gethostname(hostname, sizeof(hostname));
+    hostname[sizeof(hostname) - 1] = '\0';
+
+    // Find out which ranks share a node
+    struct topology topo;
+    topo_init(MPI_COMM_WORLD, &topo);
 
     char greeting[MAX_MESSAGE_SIZE];
     MPI_Status status; // Status object is useful, especially with MPI_ANY_SOURCE
@@ -28,13 +94,13 @@ int main(int argc, char **argv)
     if (my_rank != 0)
     {
         // Non-zero ranks send their greeting to rank 0
-        sprintf(greeting, "Greetings from process %d of %d!", my_rank, world_size);
+        snprintf(greeting, MAX_MESSAGE_SIZE, "Greetings from process %d of %d on %s!", my_rank, world_size, hostname);
         MPI_Send(greeting, strlen(greeting) + 1, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
     }
     else // Rank 0's logic
     {
         // Print rank 0's own greeting directly
-        printf("Process 0 (myself) says: Greetings from process %d of %d!\n", my_rank, world_size);
+        printf("Process 0 (myself) says: Greetings from process %d of %d on %s!\n", my_rank, world_size, hostname);
 
         // Receive greetings from all *other* processes (ranks 1 to world_size - 1)
         // We expect world_size - 1 messages in total.
@@ -53,8 +119,27 @@ int main(int argc, char **argv)
         }
     }
 
+    // Print which ranks ended up on which node (one leader per node)
+    topo_print_map(&topo, MPI_COMM_WORLD);
+
+    // The hierarchical collectives other programs use must agree with the plain ones
+    int mismatches = check_topology_collectives(&topo, MPI_COMM_WORLD);
+    if (my_rank == 0)
+    {
+        if (mismatches == 0)
+        {
+            printf("Hierarchical reduce/bcast: match MPI_Reduce/MPI_Bcast for all %d roots on %d nodes.\n",
+                   world_size, topo.num_nodes);
+        }
+        else
+        {
+            fprintf(stderr, "Error: Hierarchical reduce/bcast differ from MPI in %d results.\n", mismatches);
+        }
+    }
+    topo_free(&topo);
+
     // Finalize the MPI environment. No MPI calls should be made after this.
     MPI_Finalize();
 
-    return 0;
+    return mismatches == 0 ? 0 : 1;
 }
\ No newline at end of file
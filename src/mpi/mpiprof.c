@@ -0,0 +1,927 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // For memset
+
+// PMPI profiling library: profiles any program of this directory without touching its source.
+// Every MPI call below is intercepted, timed and forwarded to its PMPI_ twin; at MPI_Finalize the
+// ranks merge what they recorded and rank 0 writes
+//   <prefix>.txt         per-function calls, bytes and time blocked in the call (min / mean / max
+//                        over ranks), per-rank MPI share of the run, and the communication matrix
+//                        when there are at most MATRIX_PRINT_LIMIT ranks
+//   <prefix>_matrix.csv  bytes sent from every rank (row) to every rank (column)
+// The prefix is MPIPROF_OUTPUT (default "mpiprof", in rank 0's working directory).
+//
+// Build:  mpicc -O2 -fPIC -shared src/mpi/mpiprof.c -o libmpiprof.so
+// Use:    mpirun -x LD_PRELOAD=$HOME/SHARED/libmpiprof.so -x MPIPROF_OUTPUT=vm -np 4 ./vector-matrix 4000
+//    or:  link it in, before the MPI library: mpicc prog.c -L. -lmpiprof
+//
+// Bytes are counted at the application level, on the side that hands the data over:
+// point-to-point sends (also persistent ones, per MPI_Start) go to the matrix exactly; rooted and
+// personalized collectives count the data the root scatters to / gathers from each rank (or each
+// pair exchanges), not the messages the library's algorithm actually forwards. Reductions other
+// than MPI_Reduce and barriers have no pairwise meaning and stay out of the matrix. Nonblocking
+// receives count the posted size. Time is wall time inside the call, so for nonblocking calls it
+// shows up in the MPI_Wait* that completes them. Only one thread per process may call MPI
+// (MPI_THREAD_FUNNELED, as the programs here do).
+
+#define MAX_COMMS 32          // Communicators whose rank-to-world map is cached
+#define MAX_PERSISTENT 1024   // Persistent requests tracked at once
+#define MATRIX_PRINT_LIMIT 16 // Print the matrix in the text report up to this many ranks
+
+// Profiled functions; names[] must follow the same order
+enum function
+{
+    F_SEND, F_RECV, F_SENDRECV, F_ISEND, F_IRECV, F_SEND_INIT, F_RECV_INIT, F_START, F_STARTALL,
+    F_WAIT, F_WAITALL, F_WAITANY, F_TESTALL, F_BARRIER, F_BCAST, F_REDUCE, F_ALLREDUCE, F_SCATTER,
+    F_SCATTERV, F_GATHER, F_GATHERV, F_ALLGATHER, F_ALLGATHERV, F_ALLTOALL, F_ALLTOALLV, F_REDUCE_SCATTER,
+    F_EXSCAN, F_IBCAST, F_IREDUCE, F_IALLREDUCE, F_IGATHERV, F_WTIME,
+    NUM_FUNCTIONS
+};
+
+static const char *names[NUM_FUNCTIONS] = {
+    "MPI_Send", "MPI_Recv", "MPI_Sendrecv", "MPI_Isend", "MPI_Irecv", "MPI_Send_init", "MPI_Recv_init",
+    "MPI_Start", "MPI_Startall", "MPI_Wait", "MPI_Waitall", "MPI_Waitany", "MPI_Testall", "MPI_Barrier",
+    "MPI_Bcast", "MPI_Reduce", "MPI_Allreduce", "MPI_Scatter", "MPI_Scatterv", "MPI_Gather", "MPI_Gatherv",
+    "MPI_Allgather", "MPI_Allgatherv", "MPI_Alltoall", "MPI_Alltoallv", "MPI_Reduce_scatter", "MPI_Exscan",
+    "MPI_Ibcast", "MPI_Ireduce", "MPI_Iallreduce", "MPI_Igatherv", "MPI_Wtime",
+};
+
+// World ranks of the members of one communicator
+struct comm_map
+{
+    MPI_Comm comm;
+    int size;
+    int *world;
+};
+
+// Destination and size of a persistent request, counted at every MPI_Start
+struct persistent
+{
+    MPI_Request request;
+    int peer;      // World rank, or -1 (MPI_PROC_NULL, MPI_ANY_SOURCE)
+    int is_send;
+    long long bytes;
+};
+
+static struct
+{
+    int active; // Between MPI_Init and MPI_Finalize
+    int rank, size;
+    double start_time;
+    long long calls[NUM_FUNCTIONS];
+    long long sent[NUM_FUNCTIONS], received[NUM_FUNCTIONS];
+    double time[NUM_FUNCTIONS];
+    long long *matrix_row; // Bytes sent to every world rank
+    struct comm_map comms[MAX_COMMS];
+    int next_comm; // Round-robin eviction
+    struct persistent persistent[MAX_PERSISTENT];
+    int num_persistent;
+} prof;
+
+// --- Bookkeeping ---
+
+static void record(int f, double seconds, long long sent, long long received)
+{
+    prof.calls[f]++;
+    prof.time[f] += seconds;
+    prof.sent[f] += sent;
+    prof.received[f] += received;
+}
+
+static long long type_bytes(int count, MPI_Datatype type)
+{
+    int size = 0;
+    PMPI_Type_size(type, &size);
+    return (long long)count * size;
+}
+
+static int comm_size(MPI_Comm comm)
+{
+    int size;
+    PMPI_Comm_size(comm, &size);
+    return size;
+}
+
+static int comm_rank(MPI_Comm comm)
+{
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    return rank;
+}
+
+// World rank of rank `rank` of comm, or -1 for MPI_PROC_NULL / MPI_ANY_SOURCE
+static int world_rank(MPI_Comm comm, int rank)
+{
+    if (rank < 0)
+    {
+        return -1;
+    }
+    if (comm == MPI_COMM_WORLD)
+    {
+        return rank;
+    }
+    for (int c = 0; c < MAX_COMMS; c++)
+    {
+        if (prof.comms[c].world != NULL && prof.comms[c].comm == comm)
+        {
+            return rank < prof.comms[c].size ? prof.comms[c].world[rank] : -1;
+        }
+    }
+
+    // Not cached yet: translate all ranks of comm at once
+    struct comm_map *map = &prof.comms[prof.next_comm];
+    prof.next_comm = (prof.next_comm + 1) % MAX_COMMS;
+    free(map->world);
+    MPI_Group group, world_group;
+    map->comm = comm;
+    map->size = comm_size(comm);
+    map->world = malloc(map->size * sizeof(int));
+    int *ranks = malloc(map->size * sizeof(int));
+    for (int r = 0; r < map->size; r++)
+    {
+        ranks[r] = r;
+    }
+    PMPI_Comm_group(comm, &group);
+    PMPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    PMPI_Group_translate_ranks(group, map->size, ranks, world_group, map->world);
+    PMPI_Group_free(&group);
+    PMPI_Group_free(&world_group);
+    free(ranks);
+    return rank < map->size ? map->world[rank] : -1;
+}
+
+// Charge bytes sent to rank `dest` of comm to the matrix
+static void send_to(MPI_Comm comm, int dest, long long bytes)
+{
+    int peer = world_rank(comm, dest);
+    if (peer >= 0 && prof.matrix_row != NULL)
+    {
+        prof.matrix_row[peer] += bytes;
+    }
+}
+
+static void track_persistent(MPI_Request request, MPI_Comm comm, int peer, int is_send, long long bytes)
+{
+    if (prof.num_persistent < MAX_PERSISTENT)
+    {
+        struct persistent *p = &prof.persistent[prof.num_persistent++];
+        p->request = request;
+        p->peer = world_rank(comm, peer);
+        p->is_send = is_send;
+        p->bytes = bytes;
+    }
+}
+
+static struct persistent *find_persistent(MPI_Request request)
+{
+    for (int i = 0; i < prof.num_persistent; i++)
+    {
+        if (prof.persistent[i].request == request)
+        {
+            return &prof.persistent[i];
+        }
+    }
+    return NULL;
+}
+
+static void start_persistent(MPI_Request request, long long *sent, long long *received)
+{
+    struct persistent *p = find_persistent(request);
+    if (p == NULL)
+    {
+        return;
+    }
+    if (p->is_send)
+    {
+        *sent += p->bytes;
+        if (p->peer >= 0)
+        {
+            prof.matrix_row[p->peer] += p->bytes;
+        }
+    }
+    else
+    {
+        *received += p->bytes;
+    }
+}
+
+// --- Init / Finalize ---
+
+static void prof_init(void)
+{
+    memset(&prof, 0, sizeof(prof));
+    PMPI_Comm_rank(MPI_COMM_WORLD, &prof.rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &prof.size);
+    prof.matrix_row = calloc(prof.size, sizeof(long long));
+    prof.active = 1;
+    prof.start_time = PMPI_Wtime();
+}
+
+int MPI_Init(int *argc, char ***argv)
+{
+    int rc = PMPI_Init(argc, argv);
+    prof_init();
+    return rc;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
+{
+    int rc = PMPI_Init_thread(argc, argv, required, provided);
+    prof_init();
+    return rc;
+}
+
+// Human-readable byte count
+static const char *format_bytes(double bytes, char *text, size_t len)
+{
+    const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int u = 0;
+    while (bytes >= 1024.0 && u < 4)
+    {
+        bytes /= 1024.0;
+        u++;
+    }
+    snprintf(text, len, u == 0 ? "%.0f %s" : "%.2f %s", bytes, units[u]);
+    return text;
+}
+
+static void write_report(FILE *out, const long long *calls, const long long *sent, const long long *received,
+                         const double *time_sum, const double *time_min, const double *time_max,
+                         const int *max_rank, const double *per_rank, const long long *matrix)
+{
+    int p = prof.size;
+    double wall = 0.0, mpi_total = 0.0;
+    for (int r = 0; r < p; r++)
+    {
+        wall = per_rank[4 * r] > wall ? per_rank[4 * r] : wall;
+        mpi_total += per_rank[4 * r + 1];
+    }
+    char b1[32], b2[32];
+    fprintf(out, "MPI profile: %d processes, %.6f s from MPI_Init to MPI_Finalize (slowest rank)\n", p, wall);
+    fprintf(out, "Time is wall time blocked inside the call; bytes are application payload (see mpiprof.c)\n\n");
+
+    // --- Per function, most expensive first ---
+    int order[NUM_FUNCTIONS];
+    for (int f = 0; f < NUM_FUNCTIONS; f++)
+    {
+        order[f] = f;
+    }
+    for (int i = 1; i < NUM_FUNCTIONS; i++)
+    {
+        for (int j = i; j > 0 && time_sum[order[j]] > time_sum[order[j - 1]]; j--)
+        {
+            int tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+    }
+    fprintf(out, "%-20s %12s %14s %14s %12s %12s %12s %8s %8s\n", "Function", "Calls", "Sent", "Received",
+            "Min (s)", "Mean (s)", "Max (s)", "Max rank", "% MPI");
+    for (int i = 0; i < NUM_FUNCTIONS; i++)
+    {
+        int f = order[i];
+        if (calls[f] == 0)
+        {
+            continue;
+        }
+        fprintf(out, "%-20s %12lld %14s %14s %12.6f %12.6f %12.6f %8d %7.1f%%\n", names[f], calls[f],
+                format_bytes((double)sent[f], b1, sizeof(b1)), format_bytes((double)received[f], b2, sizeof(b2)),
+                time_min[f], time_sum[f] / p, time_max[f], max_rank[f],
+                mpi_total > 0.0 ? 100.0 * time_sum[f] / mpi_total : 0.0);
+    }
+
+    // --- Per rank ---
+    fprintf(out, "\n%6s %12s %12s %8s %14s %14s\n", "Rank", "Wall (s)", "MPI (s)", "% MPI", "Sent", "Received");
+    for (int r = 0; r < p; r++)
+    {
+        const double *v = &per_rank[4 * r];
+        fprintf(out, "%6d %12.6f %12.6f %7.1f%% %14s %14s\n", r, v[0], v[1], v[0] > 0.0 ? 100.0 * v[1] / v[0] : 0.0,
+                format_bytes(v[2], b1, sizeof(b1)), format_bytes(v[3], b2, sizeof(b2)));
+    }
+
+    // --- Matrix ---
+    if (p <= MATRIX_PRINT_LIMIT)
+    {
+        fprintf(out, "\nCommunication matrix, KiB sent (row = sender, column = receiver):\n%6s", "");
+        for (int c = 0; c < p; c++)
+        {
+            fprintf(out, " %10d", c);
+        }
+        fprintf(out, "\n");
+        for (int r = 0; r < p; r++)
+        {
+            fprintf(out, "%6d", r);
+            for (int c = 0; c < p; c++)
+            {
+                fprintf(out, " %10.1f", matrix[(size_t)r * p + c] / 1024.0);
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
+
+int MPI_Finalize(void)
+{
+    if (!prof.active)
+    {
+        return PMPI_Finalize();
+    }
+    prof.active = 0;
+    int p = prof.size;
+    double wall = PMPI_Wtime() - prof.start_time;
+
+    // --- Merge on rank 0 ---
+    long long calls[NUM_FUNCTIONS], sent[NUM_FUNCTIONS], received[NUM_FUNCTIONS];
+    double time_sum[NUM_FUNCTIONS], time_min[NUM_FUNCTIONS];
+    struct
+    {
+        double value;
+        int rank;
+    } mine[NUM_FUNCTIONS], time_max[NUM_FUNCTIONS];
+    double my_rank_stats[4] = {wall, 0.0, 0.0, 0.0}; // Wall, MPI time, bytes sent, bytes received
+    for (int f = 0; f < NUM_FUNCTIONS; f++)
+    {
+        mine[f].value = prof.time[f];
+        mine[f].rank = prof.rank;
+        my_rank_stats[1] += prof.time[f];
+        my_rank_stats[2] += (double)prof.sent[f];
+        my_rank_stats[3] += (double)prof.received[f];
+    }
+    PMPI_Reduce(prof.calls, calls, NUM_FUNCTIONS, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(prof.sent, sent, NUM_FUNCTIONS, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(prof.received, received, NUM_FUNCTIONS, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(prof.time, time_sum, NUM_FUNCTIONS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(prof.time, time_min, NUM_FUNCTIONS, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(mine, time_max, NUM_FUNCTIONS, MPI_DOUBLE_INT, MPI_MAXLOC, 0, MPI_COMM_WORLD);
+
+    double *per_rank = NULL;
+    long long *matrix = NULL;
+    if (prof.rank == 0)
+    {
+        per_rank = malloc(4 * p * sizeof(double));
+        matrix = malloc((size_t)p * p * sizeof(long long));
+    }
+    PMPI_Gather(my_rank_stats, 4, MPI_DOUBLE, per_rank, 4, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    PMPI_Gather(prof.matrix_row, p, MPI_LONG_LONG, matrix, p, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    if (prof.rank == 0)
+    {
+        double max_time[NUM_FUNCTIONS];
+        int max_rank[NUM_FUNCTIONS];
+        for (int f = 0; f < NUM_FUNCTIONS; f++)
+        {
+            max_time[f] = time_max[f].value;
+            max_rank[f] = time_max[f].rank;
+        }
+        const char *prefix = getenv("MPIPROF_OUTPUT");
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.txt", prefix != NULL && prefix[0] != '\0' ? prefix : "mpiprof");
+        FILE *out = fopen(path, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "mpiprof: Cannot write '%s', report goes to stderr.\n", path);
+            out = stderr;
+        }
+        write_report(out, calls, sent, received, time_sum, time_min, max_time, max_rank, per_rank, matrix);
+        if (out != stderr)
+        {
+            fclose(out);
+            fprintf(stderr, "mpiprof: report written to %s\n", path);
+        }
+
+        snprintf(path, sizeof(path), "%s_matrix.csv", prefix != NULL && prefix[0] != '\0' ? prefix : "mpiprof");
+        FILE *csv = fopen(path, "w");
+        if (csv != NULL)
+        {
+            fprintf(csv, "sender");
+            for (int c = 0; c < p; c++)
+            {
+                fprintf(csv, ",%d", c);
+            }
+            fprintf(csv, "\n");
+            for (int r = 0; r < p; r++)
+            {
+                fprintf(csv, "%d", r);
+                for (int c = 0; c < p; c++)
+                {
+                    fprintf(csv, ",%lld", matrix[(size_t)r * p + c]);
+                }
+                fprintf(csv, "\n");
+            }
+            fclose(csv);
+        }
+        free(per_rank);
+        free(matrix);
+    }
+
+    free(prof.matrix_row);
+    for (int c = 0; c < MAX_COMMS; c++)
+    {
+        free(prof.comms[c].world);
+    }
+    return PMPI_Finalize();
+}
+
+// Freed communicators may hand their handle to a new one: forget the cached map
+int MPI_Comm_free(MPI_Comm *comm)
+{
+    for (int c = 0; c < MAX_COMMS; c++)
+    {
+        if (prof.comms[c].world != NULL && prof.comms[c].comm == *comm)
+        {
+            free(prof.comms[c].world);
+            prof.comms[c].world = NULL;
+        }
+    }
+    return PMPI_Comm_free(comm);
+}
+
+// --- Point-to-point ---
+
+int MPI_Send(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Send(buf, count, type, dest, tag, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    long long bytes = type_bytes(count, type);
+    send_to(comm, dest, bytes);
+    record(F_SEND, elapsed, bytes, 0);
+    return rc;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+    MPI_Status local;
+    MPI_Status *st = (status == MPI_STATUS_IGNORE) ? &local : status;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Recv(buf, count, type, source, tag, comm, st);
+    double elapsed = PMPI_Wtime() - t0;
+    int received = 0;
+    PMPI_Get_count(st, type, &received);
+    record(F_RECV, elapsed, 0, type_bytes(received == MPI_UNDEFINED ? count : received, type));
+    return rc;
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag, void *recvbuf,
+                 int recvcount, MPI_Datatype recvtype, int source, int recvtag, MPI_Comm comm, MPI_Status *status)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype, source,
+                           recvtag, comm, status);
+    double elapsed = PMPI_Wtime() - t0;
+    long long bytes = type_bytes(sendcount, sendtype);
+    send_to(comm, dest, bytes);
+    record(F_SENDRECV, elapsed, bytes, type_bytes(recvcount, recvtype));
+    return rc;
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request *request)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Isend(buf, count, type, dest, tag, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    long long bytes = type_bytes(count, type);
+    send_to(comm, dest, bytes);
+    record(F_ISEND, elapsed, bytes, 0);
+    return rc;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Request *request)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Irecv(buf, count, type, source, tag, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_IRECV, elapsed, 0, type_bytes(count, type));
+    return rc;
+}
+
+int MPI_Send_init(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm,
+                  MPI_Request *request)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Send_init(buf, count, type, dest, tag, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    track_persistent(*request, comm, dest, 1, type_bytes(count, type));
+    record(F_SEND_INIT, elapsed, 0, 0);
+    return rc;
+}
+
+int MPI_Recv_init(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm,
+                  MPI_Request *request)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Recv_init(buf, count, type, source, tag, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    track_persistent(*request, comm, source, 0, type_bytes(count, type));
+    record(F_RECV_INIT, elapsed, 0, 0);
+    return rc;
+}
+
+int MPI_Start(MPI_Request *request)
+{
+    long long sent = 0, received = 0;
+    start_persistent(*request, &sent, &received);
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Start(request);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_START, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Startall(int count, MPI_Request requests[])
+{
+    long long sent = 0, received = 0;
+    for (int i = 0; i < count; i++)
+    {
+        start_persistent(requests[i], &sent, &received);
+    }
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Startall(count, requests);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_STARTALL, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Request_free(MPI_Request *request)
+{
+    struct persistent *p = find_persistent(*request);
+    if (p != NULL)
+    {
+        *p = prof.persistent[--prof.num_persistent];
+    }
+    return PMPI_Request_free(request);
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Wait(request, status);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_WAIT, elapsed, 0, 0);
+    return rc;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[])
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Waitall(count, requests, statuses);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_WAITALL, elapsed, 0, 0);
+    return rc;
+}
+
+int MPI_Waitany(int count, MPI_Request requests[], int *index, MPI_Status *status)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Waitany(count, requests, index, status);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_WAITANY, elapsed, 0, 0);
+    return rc;
+}
+
+int MPI_Testall(int count, MPI_Request requests[], int *flag, MPI_Status statuses[])
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Testall(count, requests, flag, statuses);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_TESTALL, elapsed, 0, 0);
+    return rc;
+}
+
+// --- Collectives ---
+
+int MPI_Barrier(MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Barrier(comm);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_BARRIER, elapsed, 0, 0);
+    return rc;
+}
+
+// Root hands the buffer to every other rank
+static void bcast_bytes(int count, MPI_Datatype type, int root, MPI_Comm comm, long long *sent, long long *received)
+{
+    long long bytes = type_bytes(count, type);
+    int size = comm_size(comm);
+    *sent = *received = 0;
+    if (comm_rank(comm) == root)
+    {
+        for (int r = 0; r < size; r++)
+        {
+            if (r != root)
+            {
+                send_to(comm, r, bytes);
+            }
+        }
+        *sent = bytes * (size - 1);
+    }
+    else
+    {
+        *received = bytes;
+    }
+}
+
+// Every rank but root hands its contribution to root
+static void reduce_bytes(int count, MPI_Datatype type, int root, MPI_Comm comm, long long *sent, long long *received)
+{
+    long long bytes = type_bytes(count, type);
+    *sent = *received = 0;
+    if (comm_rank(comm) == root)
+    {
+        *received = bytes * (comm_size(comm) - 1);
+    }
+    else
+    {
+        send_to(comm, root, bytes);
+        *sent = bytes;
+    }
+}
+
+// Root hands counts[r] elements to every other rank r (counts == NULL: count to everyone)
+static void scatter_bytes(const int *counts, int count, MPI_Datatype sendtype, int recvcount, MPI_Datatype recvtype,
+                          int root, MPI_Comm comm, long long *sent, long long *received)
+{
+    *sent = *received = 0;
+    if (comm_rank(comm) == root)
+    {
+        int size = comm_size(comm);
+        for (int r = 0; r < size; r++)
+        {
+            if (r != root)
+            {
+                long long bytes = type_bytes(counts != NULL ? counts[r] : count, sendtype);
+                send_to(comm, r, bytes);
+                *sent += bytes;
+            }
+        }
+    }
+    else
+    {
+        *received = type_bytes(recvcount, recvtype);
+    }
+}
+
+// Every rank but root hands its sendcount elements to root, which takes counts[r] from rank r
+static void gather_bytes(int sendcount, MPI_Datatype sendtype, const int *counts, int count, MPI_Datatype recvtype,
+                         int root, MPI_Comm comm, long long *sent, long long *received)
+{
+    *sent = *received = 0;
+    if (comm_rank(comm) == root)
+    {
+        int size = comm_size(comm);
+        for (int r = 0; r < size; r++)
+        {
+            *received += (r != root) ? type_bytes(counts != NULL ? counts[r] : count, recvtype) : 0;
+        }
+    }
+    else
+    {
+        *sent = type_bytes(sendcount, sendtype);
+        send_to(comm, root, *sent);
+    }
+}
+
+int MPI_Bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Bcast(buf, count, type, root, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    bcast_bytes(count, type, root, comm, &sent, &received);
+    record(F_BCAST, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    reduce_bytes(count, type, root, comm, &sent, &received);
+    record(F_REDUCE, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_ALLREDUCE, elapsed, type_bytes(count, type), type_bytes(count, type));
+    return rc;
+}
+
+int MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    scatter_bytes(NULL, sendcount, sendtype, recvcount, recvtype, root, comm, &sent, &received);
+    record(F_SCATTER, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Scatterv(const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    scatter_bytes(sendcounts, 0, sendtype, recvcount, recvtype, root, comm, &sent, &received);
+    record(F_SCATTERV, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    gather_bytes(sendcount, sendtype, NULL, recvcount, recvtype, root, comm, &sent, &received);
+    record(F_GATHER, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    gather_bytes(sendcount, sendtype, recvcounts, 0, recvtype, root, comm, &sent, &received);
+    record(F_GATHERV, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    // With MPI_IN_PLACE the contribution is a recvcount block of recvbuf
+    long long bytes = sendbuf == MPI_IN_PLACE ? type_bytes(recvcount, recvtype) : type_bytes(sendcount, sendtype);
+    int rank = comm_rank(comm), size = comm_size(comm);
+    for (int r = 0; r < size; r++)
+    {
+        if (r != rank)
+        {
+            send_to(comm, r, bytes);
+        }
+    }
+    record(F_ALLGATHER, elapsed, bytes * (size - 1), type_bytes(recvcount, recvtype) * (size - 1));
+    return rc;
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                   const int displs[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    // Like MPI_Allgather, but every rank receives recvcounts[r] from rank r
+    int rank = comm_rank(comm), size = comm_size(comm);
+    long long bytes = sendbuf == MPI_IN_PLACE ? type_bytes(recvcounts[rank], recvtype)
+                                              : type_bytes(sendcount, sendtype);
+    long long received = 0;
+    for (int r = 0; r < size; r++)
+    {
+        if (r != rank)
+        {
+            send_to(comm, r, bytes);
+            received += type_bytes(recvcounts[r], recvtype);
+        }
+    }
+    record(F_ALLGATHERV, elapsed, bytes * (size - 1), received);
+    return rc;
+}
+
+int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    int in_place = sendbuf == MPI_IN_PLACE;
+    long long bytes = in_place ? type_bytes(recvcount, recvtype) : type_bytes(sendcount, sendtype);
+    int rank = comm_rank(comm), size = comm_size(comm);
+    for (int r = 0; r < size; r++)
+    {
+        if (r != rank)
+        {
+            send_to(comm, r, bytes);
+        }
+    }
+    record(F_ALLTOALL, elapsed, bytes * (size - 1), type_bytes(recvcount, recvtype) * (size - 1));
+    return rc;
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+                  void *recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    int in_place = sendbuf == MPI_IN_PLACE;
+    int rank = comm_rank(comm), size = comm_size(comm);
+    long long sent = 0, received = 0;
+    for (int r = 0; r < size; r++)
+    {
+        if (r != rank)
+        {
+            long long bytes = in_place ? type_bytes(recvcounts[r], recvtype) : type_bytes(sendcounts[r], sendtype);
+            send_to(comm, r, bytes);
+            sent += bytes;
+            received += type_bytes(recvcounts[r], recvtype);
+        }
+    }
+    record(F_ALLTOALLV, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[], MPI_Datatype type, MPI_Op op,
+                       MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, type, op, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    int size = comm_size(comm);
+    long long total = 0;
+    for (int r = 0; r < size; r++)
+    {
+        total += recvcounts[r];
+    }
+    record(F_REDUCE_SCATTER, elapsed, type_bytes(1, type) * total, type_bytes(recvcounts[comm_rank(comm)], type));
+    return rc;
+}
+
+int MPI_Exscan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Exscan(sendbuf, recvbuf, count, type, op, comm);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_EXSCAN, elapsed, type_bytes(count, type), type_bytes(count, type));
+    return rc;
+}
+
+int MPI_Ibcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, MPI_Request *request)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Ibcast(buf, count, type, root, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    bcast_bytes(count, type, root, comm, &sent, &received);
+    record(F_IBCAST, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Ireduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, int root,
+                MPI_Comm comm, MPI_Request *request)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Ireduce(sendbuf, recvbuf, count, type, op, root, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    reduce_bytes(count, type, root, comm, &sent, &received);
+    record(F_IREDUCE, elapsed, sent, received);
+    return rc;
+}
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm,
+                   MPI_Request *request)
+{
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Iallreduce(sendbuf, recvbuf, count, type, op, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    record(F_IALLREDUCE, elapsed, type_bytes(count, type), type_bytes(count, type));
+    return rc;
+}
+
+int MPI_Igatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                 const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm, MPI_Request *request)
+{
+    long long sent, received;
+    double t0 = PMPI_Wtime();
+    int rc = PMPI_Igatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm, request);
+    double elapsed = PMPI_Wtime() - t0;
+    gather_bytes(sendcount, sendtype, recvcounts, 0, recvtype, root, comm, &sent, &received);
+    record(F_IGATHERV, elapsed, sent, received);
+    return rc;
+}
+
+// --- Timers: counted only, to show how often a program reads the clock ---
+
+double MPI_Wtime(void)
+{
+    prof.calls[F_WTIME]++;
+    return PMPI_Wtime();
+}
@@ -2,17 +2,303 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <stdint.h> // For the fixed-width words of the Philox generator
+#include <string.h> // For strcmp
 #include <time.h> // For timing
+#ifdef _OPENMP
+#include <omp.h> // For omp_get_max_threads
+#endif
+#include "timing.h"  // Per-phase timing report
+#include "balance.h" // Calibrated shares for the balanced kernel
+#include "topology.h" // Node-aware broadcast and reduction
+
+#define BLOCK_SIZE 4096 // Intervals summed per block before the block sum is folded in
+#define NUM_LANES 8     // Independent accumulators per block (fills AVX-512, two AVX2 registers)
+
+// Kernels that can be selected on the command line
+enum kernel
+{
+    KERNEL_CYCLIC = 1,  // Original: interval i goes to rank i % size, one serial sum
+    KERNEL_BLOCKED = 2, // Contiguous block per rank, threads, SIMD lanes, compensated summation
+    KERNEL_BALANCED = 3,  // Blocked, with each rank's block sized by its calibrated speed
+    KERNEL_MONTECARLO = 4 // Random points in the unit square, counter-based RNG, optional early stop
+};
+
+const char *kernel_names[] = {NULL, "cyclic", "blocked", "balanced", "montecarlo"};
+
+#define PROBE_INTERVALS 65536 // First probe run of the balanced kernel
+
+#define MC_BATCH 64                   // Philox calls per SIMD batch; each call gives two points
+#define MC_BATCH_SAMPLES (2 * MC_BATCH)
+#define MC_ROUND_BATCHES (1 << 17)    // Batches per round between convergence checks (16.8M points)
+#define MC_DEFAULT_SEED 0x5eed5eedULL // Key of the generator unless one is given on the command line
+
+// Original kernel: every size-th interval starting at rank, one dependency chain
+double cyclic_sum(long long num_intervals, double step, int rank, int size)
+{
+    double sum = 0.0;
+    for (long long i = rank; i < num_intervals; i += size)
+    {
+        double x = (i + 0.5) * step;   // Midpoint of the interval
+        sum += 4.0 / (1.0 + x * x);    // Formula derived from integral of 4/(1+x^2) dx from 0 to 1
+    }
+    return sum;
+}
+
+// Sum of f over intervals [first, last). The range is cut into BLOCK_SIZE blocks; inside a block
+// NUM_LANES independent accumulators keep the divides in flight in SIMD lanes, and the short
+// block sums are added with Kahan compensation so the error stays flat as the count grows.
+double blocked_sum(long long first, long long last, double step)
+{
+    double sum = 0.0, compensation = 0.0;
+    for (long long base = first; base < last; base += BLOCK_SIZE)
+    {
+        int len = (last - base < BLOCK_SIZE) ? (int)(last - base) : BLOCK_SIZE;
+        double lanes[NUM_LANES] = {0.0};
+        double x0 = ((double)base + 0.5) * step;
+        int j = 0;
+        for (; j + NUM_LANES <= len; j += NUM_LANES)
+        {
+#pragma omp simd
+            for (int l = 0; l < NUM_LANES; l++)
+            {
+                double x = x0 + (double)(j + l) * step;
+                lanes[l] += 4.0 / (1.0 + x * x);
+            }
+        }
+        for (; j < len; j++)
+        {
+            double x = x0 + (double)j * step;
+            lanes[0] += 4.0 / (1.0 + x * x);
+        }
+
+        // Pairwise combine of the lanes, then a compensated add of the block sum
+        for (int width = NUM_LANES / 2; width > 0; width /= 2)
+        {
+            for (int l = 0; l < width; l++)
+            {
+                lanes[l] += lanes[l + width];
+            }
+        }
+        double y = lanes[0] - compensation;
+        double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+    return sum;
+}
+
+// Blocked kernel for one rank: the rank's contiguous range is split statically over the threads.
+// Thread results are combined in thread order so the answer does not depend on timing.
+double threaded_blocked_sum(long long first, long long last, double step)
+{
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    double *partials = calloc(max_threads, sizeof(double));
+    if (partials == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the partial sums for %d threads.\n", max_threads);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int used_threads = 1;
+
+#pragma omp parallel
+    {
+        int tid = 0, nthreads = 1;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+        nthreads = omp_get_num_threads();
+#endif
+        long long count = last - first;
+        long long t_first = first + count * tid / nthreads;
+        long long t_last = first + count * (tid + 1) / nthreads;
+        partials[tid] = blocked_sum(t_first, t_last, step);
+        if (tid == 0)
+        {
+            used_threads = nthreads;
+        }
+    }
+
+    double sum = 0.0, compensation = 0.0;
+    for (int t = 0; t < used_threads; t++)
+    {
+        double y = partials[t] - compensation;
+        double total = sum + y;
+        compensation = (total - sum) - y;
+        sum = total;
+    }
+    free(partials);
+    return sum;
+}
+
+// Calibration probe of the balanced kernel: the blocked kernel over `units` intervals
+void probe_blocked(long long units, void *ctx)
+{
+    volatile double sink = threaded_blocked_sum(0, units, *(const double *)ctx);
+    (void)sink;
+}
+
+// --- Monte Carlo kernel ---
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11): the
+// output is a keyed bijection of a 128-bit counter, so any sample can be produced from its index
+// alone and there is no generator state to share, seed or split. Point i of the run uses the
+// counter i and the run's key (the seed); whoever computes point i gets the same point, so the
+// sample set does not depend on how the points are divided over processes and threads.
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u // Key schedule increments (golden ratio, sqrt(3) - 1)
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// One block of four random words from counter (c0..c3) and key (k0, k1), in place
+static inline void philox4x32(uint32_t *c0, uint32_t *c1, uint32_t *c2, uint32_t *c3, uint32_t k0, uint32_t k1)
+{
+    for (int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * *c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * *c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ *c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ *c3 ^ k1;
+        *c1 = (uint32_t)p1;
+        *c3 = (uint32_t)p0;
+        *c0 = n0;
+        *c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+// Points of one batch inside the quarter circle. The MC_BATCH generator calls are independent, so
+// they run side by side in SIMD lanes; a call's four words are the coordinates of two points.
+// The first counter of a batch is a multiple of MC_BATCH, so the lanes only differ in the low
+// word and its high word is the same for the whole batch. The 32x32->64 bit products need AVX2 or
+// wider to vectorize (e.g. FLAGS="... -mavx2" in run_mpi.sh); plain x86-64 builds run it scalar,
+// with the same results.
+static inline int batch_hits(uint64_t batch, uint64_t seed)
+{
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+    uint64_t first = batch * MC_BATCH;
+    uint32_t low = (uint32_t)first, high = (uint32_t)(first >> 32);
+    int hits = 0;
+#pragma omp simd reduction(+ : hits)
+    for (uint32_t l = 0; l < MC_BATCH; l++)
+    {
+        uint32_t c0 = low + l, c1 = high, c2 = 0, c3 = 0;
+        philox4x32(&c0, &c1, &c2, &c3, k0, k1);
+        // Top 31 bits of each word to (0, 1), at the centre of their bins: the signed conversion
+        // is the one SIMD units have
+        double x0 = ((double)(int32_t)(c0 >> 1) + 0.5) * 0x1p-31;
+        double y0 = ((double)(int32_t)(c1 >> 1) + 0.5) * 0x1p-31;
+        double x1 = ((double)(int32_t)(c2 >> 1) + 0.5) * 0x1p-31;
+        double y1 = ((double)(int32_t)(c3 >> 1) + 0.5) * 0x1p-31;
+        hits += (x0 * x0 + y0 * y0 <= 1.0) + (x1 * x1 + y1 * y1 <= 1.0);
+    }
+    return hits;
+}
+
+// Hits among the batches [first, last), split statically over the threads. Counts are integers, so
+// the total is the same for any split.
+long long mc_hits(uint64_t first, uint64_t last, uint64_t seed)
+{
+    long long hits = 0;
+#pragma omp parallel for schedule(static) reduction(+ : hits)
+    for (long long b = (long long)first; b < (long long)last; b++)
+    {
+        hits += batch_hits((uint64_t)b, seed);
+    }
+    return hits;
+}
+
+// Standard error of the estimate 4 * hits / samples (binomial proportion)
+double mc_standard_error(long long hits, long long samples)
+{
+    double p = (double)hits / (double)samples;
+    return 4.0 * sqrt(p * (1.0 - p) / (double)samples);
+}
+
+struct mc_result
+{
+    long long hits, samples; // Totals over all processes
+    int rounds;              // Rounds computed
+    int converged;           // Stopped because the standard error reached the target
+};
+
+// Monte Carlo estimate over up to max_samples points (rounded up to whole batches). The points are
+// drawn in rounds of MC_ROUND_BATCHES batches, each round split evenly over the processes. After
+// every round the running totals start on their way with MPI_Iallreduce, and the next round is
+// computed while they travel; the totals of round r are checked once round r + 1 is done, and the
+// run stops there if the standard error is at most target_se (0: never stop early). Rounds are
+// fixed in global point numbers, so where it stops, and the estimate, do not depend on the
+// process count. Collective; the result is the same on every rank.
+void monte_carlo(long long max_samples, double target_se, uint64_t seed, struct mc_result *res, struct timing *tm,
+                 MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    long long total_batches = (max_samples + MC_BATCH_SAMPLES - 1) / MC_BATCH_SAMPLES;
+    long long mine[2] = {0, 0};   // Hits and samples of this rank so far
+    long long sent[2], totals[2]; // Buffers of the reduction in flight
+    MPI_Request request = MPI_REQUEST_NULL;
+    res->rounds = 0;
+    res->converged = 0;
+
+    for (long long round_start = 0; round_start < total_batches; round_start += MC_ROUND_BATCHES)
+    {
+        long long round_batches = total_batches - round_start < MC_ROUND_BATCHES ? total_batches - round_start
+                                                                                 : MC_ROUND_BATCHES;
+        long long first = round_start + round_batches * rank / size;
+        long long last = round_start + round_batches * (rank + 1) / size;
+        timing_start(tm, "compute");
+        mine[0] += mc_hits((uint64_t)first, (uint64_t)last, seed);
+        mine[1] += (last - first) * MC_BATCH_SAMPLES;
+        timing_stop(tm, "compute");
+        res->rounds++;
+
+        timing_start(tm, "reduce");
+        if (request != MPI_REQUEST_NULL)
+        {
+            MPI_Wait(&request, MPI_STATUS_IGNORE); // Totals of the previous round
+            res->converged = target_se > 0.0 && mc_standard_error(totals[0], totals[1]) <= target_se;
+        }
+        if (!res->converged)
+        {
+            sent[0] = mine[0];
+            sent[1] = mine[1];
+            MPI_Iallreduce(sent, totals, 2, MPI_LONG_LONG, MPI_SUM, comm, &request);
+        }
+        timing_stop(tm, "reduce");
+        if (res->converged)
+        {
+            break;
+        }
+    }
+
+    timing_start(tm, "reduce");
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    MPI_Allreduce(mine, totals, 2, MPI_LONG_LONG, MPI_SUM, comm);
+    timing_stop(tm, "reduce");
+    res->hits = totals[0];
+    res->samples = totals[1];
+}
 
 int main(int argc, char *argv[])
 {
     int rank, size;
-    long long i;
     long long num_intervals; // Use long long for potentially large numbers
-    double step, x, sum, pi, local_pi;
+    int kernel = KERNEL_BLOCKED;
+    int num_threads = 1;
+    double target_se = 0.0;          // Monte Carlo: stop once the standard error is this small (0: never)
+    uint64_t seed = MC_DEFAULT_SEED; // Monte Carlo: key of the generator
+    struct mc_result mc;
+    double step, sum, pi, local_pi;
     double start_time, end_time, elapsed_time, total_time;
 
-    MPI_Init(&argc, &argv);
+    // Only the main thread makes MPI calls; threads are used inside the blocked kernel
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
@@ -25,35 +311,130 @@ int main(int argc, char *argv[])
     {
         num_intervals = 100000000; // Default to a reasonably large number
     }
+    if (argc > 2 && strcmp(argv[2], "cyclic") == 0)
+    {
+        kernel = KERNEL_CYCLIC;
+    }
+    else if (argc > 2 && strcmp(argv[2], "balanced") == 0)
+    {
+        kernel = KERNEL_BALANCED;
+    }
+    else if (argc > 2 && strcmp(argv[2], "montecarlo") == 0)
+    {
+        // Here the first argument is the most points to draw
+        kernel = KERNEL_MONTECARLO;
+        if (argc > 3)
+        {
+            target_se = atof(argv[3]);
+        }
+        if (argc > 4)
+        {
+            seed = strtoull(argv[4], NULL, 0);
+        }
+    }
+    else if (argc > 2 && strcmp(argv[2], "blocked") != 0)
+    {
+        // Every rank parsed the same arguments, so every rank stops here
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Unknown kernel '%s' (use blocked, cyclic, balanced or montecarlo).\n", argv[2]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+#ifdef _OPENMP
+    if (kernel != KERNEL_CYCLIC)
+    {
+        num_threads = omp_get_max_threads();
+    }
+#endif
 
-    if (rank == 0)
+    if (rank == 0 && kernel == KERNEL_MONTECARLO)
+    {
+        printf("Estimating Pi from up to %lld random points across %d processes (%s kernel, %d threads/process).\n",
+               num_intervals, size, kernel_names[kernel], num_threads);
+        printf("Philox4x32-10 seed: %#llx, target standard error: ", (unsigned long long)seed);
+        if (target_se > 0.0)
+        {
+            printf("%.3e\n", target_se);
+        }
+        else
+        {
+            printf("none (all points)\n");
+        }
+    }
+    else if (rank == 0)
     {
-        printf("Calculating Pi using %lld intervals across %d processes.\n", num_intervals, size);
+        printf("Calculating Pi using %lld intervals across %d processes (%s kernel, %d threads/process).\n",
+               num_intervals, size, kernel_names[kernel], num_threads);
     }
 
     // Start timing AFTER initialization and argument parsing
+    struct timing tm;
+    timing_init(&tm);
+
+    // --- Calibration (balanced kernel): every rank's share of the intervals from its measured speed ---
+    double *weights = malloc(size * sizeof(double));
+    long long *starts = malloc((size + 1) * sizeof(long long));
+    for (int r = 0; r < size; r++)
+    {
+        weights[r] = 1.0 / size;
+    }
+    if (kernel == KERNEL_BALANCED)
+    {
+        double probe_step = 1.0 / (double)num_intervals;
+        timing_start(&tm, "calibrate");
+        int nodes_probed = balance_weights("pi-blocked", probe_blocked, &probe_step, PROBE_INTERVALS, weights,
+                                           MPI_COMM_WORLD);
+        timing_stop(&tm, "calibrate");
+        balance_print(weights, nodes_probed, MPI_COMM_WORLD);
+    }
+    balance_split(num_intervals, weights, size, starts);
+
+    // Which ranks share a node: the broadcast and reduction below cross the network once per node
+    struct topology topo;
+    topo_init(MPI_COMM_WORLD, &topo);
+
     MPI_Barrier(MPI_COMM_WORLD); // Synchronize before starting timer
     start_time = MPI_Wtime();
 
     // --- Broadcast the number of intervals to all processes ---
     // Although passed as arg, broadcasting ensures consistency if logic changed
-    MPI_Bcast(&num_intervals, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    timing_start(&tm, "distribute");
+    topo_bcast(&num_intervals, 1, MPI_LONG_LONG, 0, &topo, MPI_COMM_WORLD);
+    timing_stop(&tm, "distribute");
 
     // --- Calculation ---
-    sum = 0.0;
     step = 1.0 / (double)num_intervals;
 
-    // Each process calculates its portion of the intervals
-    for (i = rank; i < num_intervals; i += size)
+    if (kernel == KERNEL_MONTECARLO)
     {
-        x = (i + 0.5) * step;       // Midpoint of the interval
-        sum += 4.0 / (1.0 + x * x); // Formula derived from integral of 4/(1+x^2) dx from 0 to 1
+        // Rounds of points with the running totals reduced in the background (times its own regions)
+        monte_carlo(num_intervals, target_se, seed, &mc, &tm, MPI_COMM_WORLD);
+        pi = 4.0 * (double)mc.hits / (double)mc.samples;
     }
-    local_pi = step * sum;
+    else
+    {
+        // Each process calculates its portion of the intervals
+        timing_start(&tm, "compute");
+        if (kernel == KERNEL_CYCLIC)
+        {
+            sum = cyclic_sum(num_intervals, step, rank, size);
+        }
+        else
+        {
+            // Contiguous block of intervals for this process: even, or in proportion to its speed
+            sum = threaded_blocked_sum(starts[rank], starts[rank + 1], step);
+        }
+        local_pi = step * sum;
+        timing_stop(&tm, "compute");
 
-    // --- Reduction ---
-    // Sum up all the local_pi values calculated by each process onto the root process (rank 0)
-    MPI_Reduce(&local_pi, &pi, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        // --- Reduction ---
+        // Sum up all the local_pi values calculated by each process onto the root process (rank 0)
+        timing_start(&tm, "reduce");
+        topo_reduce(&local_pi, &pi, 1, MPI_DOUBLE, MPI_SUM, 0, &topo, MPI_COMM_WORLD);
+        timing_stop(&tm, "reduce");
+    }
 
     end_time = MPI_Wtime();
     elapsed_time = end_time - start_time;
@@ -68,8 +449,27 @@ int main(int argc, char *argv[])
         printf("Reference Pi  = %.15f\n", M_PI); // From math.h
         printf("Error         = %.15f\n", fabs(pi - M_PI));
         printf("Total execution time: %f seconds\n", total_time);
+        if (kernel == KERNEL_MONTECARLO)
+        {
+            printf("Standard error = %.3e (%lld points in %d rounds, %s)\n", mc_standard_error(mc.hits, mc.samples),
+                   mc.samples, mc.rounds, mc.converged ? "stopped at the target" : "all points drawn");
+            printf("Throughput: %.3e samples/second, %.3e samples/second/core (%d cores)\n",
+                   (double)mc.samples / total_time, (double)mc.samples / total_time / (size * num_threads),
+                   size * num_threads);
+        }
+        else
+        {
+            printf("Throughput: %.3e intervals/second\n", (double)num_intervals / total_time);
+        }
     }
 
+    char params[64];
+    snprintf(params, sizeof(params), "n=%lld kernel=%s", num_intervals, kernel_names[kernel]);
+    timing_report(&tm, "pi", params, MPI_COMM_WORLD);
+
+    free(weights);
+    free(starts);
+    topo_free(&topo);
     MPI_Finalize();
     return 0;
 }
\ No newline at end of file
@@ -1,18 +1,213 @@
 #include <mpi.h>
 #include <stdio.h>
-#include <stdlib.h> // For exit()
+#include <stdlib.h> // For exit(), qsort
+#include <string.h> // For strcmp, memset
+#include <unistd.h> // For getopt
+
+// Point-to-point latency / bandwidth benchmark.
+// Ping-pong: rank 0 and one peer bounce a message back and forth (one link, the rest idle).
+// Ring: every rank passes a message to its next neighbour at the same time (all links busy).
+// Each test runs over a sweep of message sizes with blocking MPI_Send/MPI_Recv, nonblocking
+// MPI_Isend/MPI_Irecv and MPI_Sendrecv, times every repetition on its own and prints
+// min / median / p99 latency and bandwidth per size as CSV on stdout.
+
+#define PAGE_ALIGNMENT 4096              // Message buffers start on a page boundary
+#define DEFAULT_MIN_BYTES 1              // Smallest message of the sweep
+#define DEFAULT_MAX_BYTES (64 << 20)     // Largest message of the sweep (64 MiB)
+#define DEFAULT_REPS 1000                // Timed repetitions per size (small messages)
+#define DEFAULT_WARMUP 10                // Untimed repetitions per size
+#define LARGE_MESSAGE (64 << 10)         // Above this size the repetitions shrink with the size
+#define MIN_REPS 10                      // Fewest timed repetitions of any size
+#define TAG_DATA 0
+
+// Tests and variants, selected with -t and -v (bit masks so "all" is every bit)
+enum test
+{
+    TEST_PINGPONG = 1,
+    TEST_RING = 2
+};
+
+enum variant
+{
+    VAR_BLOCKING = 1,    // MPI_Send / MPI_Recv
+    VAR_NONBLOCKING = 2, // MPI_Irecv posted first, MPI_Isend, MPI_Waitall
+    VAR_SENDRECV = 4     // MPI_Sendrecv
+};
+
+const char *test_name(int test)
+{
+    return test == TEST_PINGPONG ? "pingpong" : "ring";
+}
+
+const char *variant_name(int variant)
+{
+    return variant == VAR_BLOCKING ? "blocking" : variant == VAR_NONBLOCKING ? "nonblocking" : "sendrecv";
+}
+
+// Byte every rank fills its send buffer with, so receivers can check where data came from
+unsigned char fill_byte(int rank)
+{
+    return (unsigned char)(rank % 251 + 1);
+}
+
+// Parse a byte count with an optional K, M or G suffix (powers of 1024); -1 if invalid
+long long parse_bytes(const char *text)
+{
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    if (*end == 'K' || *end == 'k')
+    {
+        value <<= 10;
+        end++;
+    }
+    else if (*end == 'M' || *end == 'm')
+    {
+        value <<= 20;
+        end++;
+    }
+    else if (*end == 'G' || *end == 'g')
+    {
+        value <<= 30;
+        end++;
+    }
+    return (*end == '\0' && end != text) ? value : -1;
+}
+
+// Timed repetitions for one message size: the full count for small messages, fewer for large
+// ones so every size moves about the same volume
+int reps_for_size(int bytes, int reps)
+{
+    if (bytes <= LARGE_MESSAGE)
+    {
+        return reps;
+    }
+    long long scaled = (long long)reps * LARGE_MESSAGE / bytes;
+    return scaled < MIN_REPS ? (reps < MIN_REPS ? reps : MIN_REPS) : (int)scaled;
+}
+
+// One ping-pong round between rank 0 and peer. Returns half the round trip seen by rank 0.
+// In the MPI_Sendrecv variant rank 0 sends the ping and receives the pong in one call.
+double pingpong_once(int variant, char *sbuf, char *rbuf, int bytes, int rank, int peer, MPI_Comm comm)
+{
+    int other = (rank == 0) ? peer : 0;
+    MPI_Request requests[2];
+    double t0 = MPI_Wtime();
+
+    if (variant == VAR_NONBLOCKING)
+    {
+        // The receive is posted before the send on both sides, so the message never arrives
+        // unexpected
+        MPI_Irecv(rbuf, bytes, MPI_CHAR, other, TAG_DATA, comm, &requests[0]);
+        if (rank == 0)
+        {
+            MPI_Isend(sbuf, bytes, MPI_CHAR, other, TAG_DATA, comm, &requests[1]);
+            MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+        }
+        else
+        {
+            MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+            MPI_Isend(sbuf, bytes, MPI_CHAR, other, TAG_DATA, comm, &requests[1]);
+            MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
+        }
+    }
+    else if (rank == 0 && variant == VAR_SENDRECV)
+    {
+        MPI_Sendrecv(sbuf, bytes, MPI_CHAR, other, TAG_DATA, rbuf, bytes, MPI_CHAR, other, TAG_DATA,
+                     comm, MPI_STATUS_IGNORE);
+    }
+    else if (rank == 0)
+    {
+        MPI_Send(sbuf, bytes, MPI_CHAR, other, TAG_DATA, comm);
+        MPI_Recv(rbuf, bytes, MPI_CHAR, other, TAG_DATA, comm, MPI_STATUS_IGNORE);
+    }
+    else
+    {
+        // The peer has to see the ping before it can answer, whatever rank 0 uses
+        MPI_Recv(rbuf, bytes, MPI_CHAR, other, TAG_DATA, comm, MPI_STATUS_IGNORE);
+        MPI_Send(sbuf, bytes, MPI_CHAR, other, TAG_DATA, comm);
+    }
+    return 0.5 * (MPI_Wtime() - t0);
+}
+
+// One ring shift: every rank sends to next_rank and receives from prev_rank.
+// Returns the time this rank spent in the shift.
+double ring_once(int variant, char *sbuf, char *rbuf, int bytes, int rank, int next_rank, int prev_rank,
+                 MPI_Comm comm)
+{
+    MPI_Request requests[2];
+    double t0 = MPI_Wtime();
+
+    if (variant == VAR_BLOCKING)
+    {
+        // Even ranks send first, odd ranks receive first, so the ring cannot deadlock even when
+        // MPI_Send waits for the matching receive (large messages)
+        if (rank % 2 == 0)
+        {
+            MPI_Send(sbuf, bytes, MPI_CHAR, next_rank, TAG_DATA, comm);
+            MPI_Recv(rbuf, bytes, MPI_CHAR, prev_rank, TAG_DATA, comm, MPI_STATUS_IGNORE);
+        }
+        else
+        {
+            MPI_Recv(rbuf, bytes, MPI_CHAR, prev_rank, TAG_DATA, comm, MPI_STATUS_IGNORE);
+            MPI_Send(sbuf, bytes, MPI_CHAR, next_rank, TAG_DATA, comm);
+        }
+    }
+    else if (variant == VAR_NONBLOCKING)
+    {
+        MPI_Irecv(rbuf, bytes, MPI_CHAR, prev_rank, TAG_DATA, comm, &requests[0]);
+        MPI_Isend(sbuf, bytes, MPI_CHAR, next_rank, TAG_DATA, comm, &requests[1]);
+        MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    }
+    else
+    {
+        MPI_Sendrecv(sbuf, bytes, MPI_CHAR, next_rank, TAG_DATA, rbuf, bytes, MPI_CHAR, prev_rank, TAG_DATA,
+                     comm, MPI_STATUS_IGNORE);
+    }
+    return MPI_Wtime() - t0;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Print one CSV row from the sorted per-repetition times (seconds)
+void print_row(int test, int variant, int num_procs, int bytes, int reps, double *times)
+{
+    qsort(times, reps, sizeof(double), compare_doubles);
+    double min = times[0];
+    double median = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+    int p99_index = (99 * reps + 99) / 100 - 1; // ceil(0.99 * reps) - 1
+    double p99 = times[p99_index];
+    printf("%s,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", test_name(test), variant_name(variant), num_procs,
+           bytes, reps, min * 1e6, median * 1e6, p99 * 1e6, bytes / min / 1e6, bytes / median / 1e6);
+    fflush(stdout);
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-t pingpong|ring|all] [-v blocking|nonblocking|sendrecv|all]\n", prog);
+    fprintf(stderr, "                  [-s MIN] [-S MAX] [-r REPS] [-w WARMUP] [-p PEER]\n");
+    fprintf(stderr, "  -t TEST     Test to run (default: all)\n");
+    fprintf(stderr, "  -v VARIANT  Point-to-point calls to use (default: all)\n");
+    fprintf(stderr, "  -s MIN      Smallest message in bytes, K/M/G suffixes allowed (default: %d)\n", DEFAULT_MIN_BYTES);
+    fprintf(stderr, "  -S MAX      Largest message in bytes (default: %dM); sizes double from MIN\n", DEFAULT_MAX_BYTES >> 20);
+    fprintf(stderr, "  -r REPS     Timed repetitions per size, scaled down above %dK (default: %d)\n",
+            LARGE_MESSAGE >> 10, DEFAULT_REPS);
+    fprintf(stderr, "  -w WARMUP   Untimed repetitions per size (default: %d)\n", DEFAULT_WARMUP);
+    fprintf(stderr, "  -p PEER     Partner of rank 0 in the ping-pong test (default: 1)\n");
+}
 
 int main(int argc, char *argv[])
 {
     int my_rank, num_procs;
-    int token; // The data being passed around
-    MPI_Status status;
 
     MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
-    // This example requires at least 2 processes
+    // This benchmark requires at least 2 processes
     if (num_procs < 2)
     {
         if (my_rank == 0)
@@ -23,38 +218,187 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    // --- Argument Handling (Rank 0 parses and broadcasts the settings) ---
+    int tests = TEST_PINGPONG | TEST_RING;
+    int variants = VAR_BLOCKING | VAR_NONBLOCKING | VAR_SENDRECV;
+    long long min_bytes = DEFAULT_MIN_BYTES, max_bytes = DEFAULT_MAX_BYTES;
+    int reps = DEFAULT_REPS, warmup = DEFAULT_WARMUP, peer = 1;
+    int args_ok = 1;
+    if (my_rank == 0)
+    {
+        int opt;
+        while (args_ok && (opt = getopt(argc, argv, "t:v:s:S:r:w:p:")) != -1)
+        {
+            if (opt == 't' && strcmp(optarg, "all") == 0)
+            {
+                tests = TEST_PINGPONG | TEST_RING;
+            }
+            else if (opt == 't' && (strcmp(optarg, "pingpong") == 0 || strcmp(optarg, "ring") == 0))
+            {
+                tests = strcmp(optarg, "ring") == 0 ? TEST_RING : TEST_PINGPONG;
+            }
+            else if (opt == 'v' && strcmp(optarg, "all") == 0)
+            {
+                variants = VAR_BLOCKING | VAR_NONBLOCKING | VAR_SENDRECV;
+            }
+            else if (opt == 'v' && strcmp(optarg, "blocking") == 0)
+            {
+                variants = VAR_BLOCKING;
+            }
+            else if (opt == 'v' && strcmp(optarg, "nonblocking") == 0)
+            {
+                variants = VAR_NONBLOCKING;
+            }
+            else if (opt == 'v' && strcmp(optarg, "sendrecv") == 0)
+            {
+                variants = VAR_SENDRECV;
+            }
+            else if (opt == 's' && parse_bytes(optarg) > 0)
+            {
+                min_bytes = parse_bytes(optarg);
+            }
+            else if (opt == 'S' && parse_bytes(optarg) > 0)
+            {
+                max_bytes = parse_bytes(optarg);
+            }
+            else if (opt == 'r' && atoi(optarg) > 0)
+            {
+                reps = atoi(optarg);
+            }
+            else if (opt == 'w' && atoi(optarg) >= 0)
+            {
+                warmup = atoi(optarg);
+            }
+            else if (opt == 'p' && atoi(optarg) > 0 && atoi(optarg) < num_procs)
+            {
+                peer = atoi(optarg);
+            }
+            else
+            {
+                print_usage(argv[0]);
+                args_ok = 0;
+            }
+        }
+        if (args_ok && (optind < argc || min_bytes > max_bytes || max_bytes > 0x7fffffff))
+        {
+            fprintf(stderr, "Error: Need MIN <= MAX < 2 GiB and no extra arguments.\n");
+            args_ok = 0;
+        }
+    }
+    int settings[8] = {args_ok, tests, variants, (int)min_bytes, (int)max_bytes, reps, warmup, peer};
+    MPI_Bcast(settings, 8, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!settings[0])
+    {
+        MPI_Finalize();
+        return 1;
+    }
+    tests = settings[1];
+    variants = settings[2];
+    min_bytes = settings[3];
+    max_bytes = settings[4];
+    reps = settings[5];
+    warmup = settings[6];
+    peer = settings[7];
+
     // Determine the rank of the next process in the ring
     int next_rank = (my_rank + 1) % num_procs;
     // Determine the rank of the previous process in the ring
     int prev_rank = (my_rank - 1 + num_procs) % num_procs; // Modulo handles wrap-around for rank 0
 
-    // Process 0 starts the token
-    if (my_rank == 0)
+    // Message buffers are sized for the largest message and touched once before timing
+    char *sbuf = NULL, *rbuf = NULL;
+    double *times = malloc(reps * sizeof(double));
+    int alloc_failed = posix_memalign((void **)&sbuf, PAGE_ALIGNMENT, max_bytes) != 0 ||
+                       posix_memalign((void **)&rbuf, PAGE_ALIGNMENT, max_bytes) != 0 || times == NULL;
+    int any_failed;
+    MPI_Allreduce(&alloc_failed, &any_failed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (any_failed)
     {
-        token = 100; // Starting value
-        printf("Process %d starting with token %d, sending to process %d\n", my_rank, token, next_rank);
-        MPI_Send(&token, 1, MPI_INT, next_rank, 0, MPI_COMM_WORLD); // Send to next
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Error: Cannot allocate %lld-byte message buffers.\n", max_bytes);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    memset(sbuf, fill_byte(my_rank), max_bytes);
+    memset(rbuf, 0, max_bytes);
 
-        // Now, wait to receive the final token back from the last process
-        MPI_Recv(&token, 1, MPI_INT, prev_rank, 0, MPI_COMM_WORLD, &status);
-        printf("Process %d received final token %d from process %d\n", my_rank, token, prev_rank);
-        printf("--------------------------------------------------\n");
-        printf("Final token value after circulating the ring: %d\n", token);
-        printf("Expected final value (if P processes): 100 + 0 + 1 + ... + (P-1)\n");
-        printf("--------------------------------------------------\n");
+    if (my_rank == 0)
+    {
+        char hostname[MPI_MAX_PROCESSOR_NAME];
+        int len;
+        MPI_Get_processor_name(hostname, &len);
+        printf("# Point-to-point benchmark: %d processes, rank 0 on %s, ping-pong peer %d\n", num_procs, hostname, peer);
+        printf("# Latency in microseconds (one way), bandwidth in MB/s (10^6 bytes) from min and median\n");
+        printf("test,variant,procs,bytes,reps,min_us,median_us,p99_us,max_bw_MBps,median_bw_MBps\n");
     }
-    else
+
+    int bad_messages = 0; // Receives whose contents did not come from the expected sender
+    for (int test = TEST_PINGPONG; test <= TEST_RING; test <<= 1)
     {
-        // All other processes: receive, modify, send
-        MPI_Recv(&token, 1, MPI_INT, prev_rank, 0, MPI_COMM_WORLD, &status); // Receive from previous
-        printf("Process %d received token %d from process %d\n", my_rank, token, prev_rank);
+        if (!(tests & test))
+        {
+            continue;
+        }
+        int active = (test == TEST_RING) || my_rank == 0 || my_rank == peer;
+        int source = (test == TEST_RING) ? prev_rank : (my_rank == 0 ? peer : 0);
 
-        token += my_rank; // Modify the token by adding own rank
+        for (int variant = VAR_BLOCKING; variant <= VAR_SENDRECV; variant <<= 1)
+        {
+            if (!(variants & variant))
+            {
+                continue;
+            }
+            for (long long bytes = min_bytes; bytes <= max_bytes; bytes *= 2)
+            {
+                int size_reps = reps_for_size((int)bytes, reps);
+                int size_warmup = warmup < size_reps ? warmup : size_reps;
+                MPI_Barrier(MPI_COMM_WORLD);
 
-        printf("Process %d sending token %d to process %d\n", my_rank, token, next_rank);
-        MPI_Send(&token, 1, MPI_INT, next_rank, 0, MPI_COMM_WORLD); // Send to next
+                if (active)
+                {
+                    for (int i = -size_warmup; i < size_reps; i++)
+                    {
+                        double t = (test == TEST_PINGPONG)
+                                       ? pingpong_once(variant, sbuf, rbuf, (int)bytes, my_rank, peer, MPI_COMM_WORLD)
+                                       : ring_once(variant, sbuf, rbuf, (int)bytes, my_rank, next_rank, prev_rank, MPI_COMM_WORLD);
+                        if (i >= 0)
+                        {
+                            times[i] = t;
+                        }
+                    }
+                    if (rbuf[0] != (char)fill_byte(source) || rbuf[bytes - 1] != (char)fill_byte(source))
+                    {
+                        bad_messages++;
+                    }
+                    rbuf[0] = rbuf[bytes - 1] = 0;
+                }
+
+                // A ring shift is only as fast as its slowest link: keep the slowest rank's time
+                if (test == TEST_RING)
+                {
+                    MPI_Reduce(my_rank == 0 ? MPI_IN_PLACE : times, times, size_reps, MPI_DOUBLE, MPI_MAX, 0,
+                               MPI_COMM_WORLD);
+                }
+                if (my_rank == 0)
+                {
+                    print_row(test, variant, num_procs, (int)bytes, size_reps, times);
+                }
+            }
+        }
+    }
+
+    int total_bad = 0;
+    MPI_Reduce(&bad_messages, &total_bad, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (my_rank == 0 && total_bad > 0)
+    {
+        fprintf(stderr, "Warning: %d received messages did not hold the sender's data.\n", total_bad);
     }
 
+    free(sbuf);
+    free(rbuf);
+    free(times);
     MPI_Finalize();
-    return 0;
-}
\ No newline at end of file
+    return total_bad > 0 && my_rank == 0;
+}
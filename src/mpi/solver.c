@@ -0,0 +1,589 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // For strcmp
+#include <unistd.h> // For getopt
+#include <math.h>   // For sqrt, fabs, pow
+
+// Iterative solvers on a dense matrix that stays distributed for the whole run:
+// Conjugate Gradient (A x = b) and power iteration (dominant eigenvalue of A).
+// Each rank owns a balanced block of rows of A and the matching slice of the iteration vector.
+// The rest of the vector is exchanged every iteration through persistent requests, and the
+// product starts on the rank's own columns while the remote slices are still in flight.
+
+#define ALIGNMENT 64          // Cache-line alignment for every heap buffer
+#define DEFAULT_N 2000        // Default matrix dimension
+#define DEFAULT_ITERS 500     // Default iteration limit
+#define DEFAULT_TOL 1e-10     // Default relative tolerance
+#define DEFAULT_RHO 0.99      // Default correlation of the test matrix
+#define REPORT_EVERY 25       // Print one progress line every this many iterations
+#define ROW_UNROLL 4          // Rows computed together in the local kernel
+
+// Algorithms selected with -a
+enum algorithm
+{
+    ALG_CG = 1,   // Conjugate Gradient for symmetric positive definite A
+    ALG_POWER = 2 // Power iteration for the dominant eigenvalue
+};
+
+// Persistent exchange of the distributed iteration vector. Every rank sends its slice to all
+// others and receives all other slices straight into the full-length vector buffer.
+struct exchange
+{
+    int size, rank;
+    int *counts, *displs; // Balanced row / vector slices
+    int num_requests;     // size - 1 receives followed by size - 1 sends
+    MPI_Request *requests;
+    int *source_of;       // Rank whose slice each receive request delivers
+};
+
+// Per-rank time accounting for one run
+struct timings
+{
+    double iteration;   // Total wall time of all iterations
+    double compute;     // Time in the local kernel and vector updates
+    double comm_wait;   // Time blocked in MPI_Wait* (communication that was not hidden)
+};
+
+// Allocate a contiguous, cache-line aligned array of doubles (NULL on failure)
+double *alloc_doubles(size_t count)
+{
+    void *ptr = NULL;
+    if (count == 0)
+    {
+        count = 1; // Keep a valid pointer even for ranks that own no rows
+    }
+    if (posix_memalign(&ptr, ALIGNMENT, count * sizeof(double)) != 0)
+    {
+        return NULL;
+    }
+    return (double *)ptr;
+}
+
+// Split n items as evenly as possible over parts: the first (n % parts) parts get one extra item
+void compute_block_distribution(int n, int parts, int *counts, int *displs)
+{
+    int per_part = n / parts;
+    int remainder = n % parts;
+    int offset = 0;
+    for (int p = 0; p < parts; p++)
+    {
+        counts[p] = per_part + (p < remainder ? 1 : 0);
+        displs[p] = offset;
+        offset += counts[p];
+    }
+}
+
+// Test matrix: A[i][j] = rho^|i-j| (Kac-Murdock-Szego). It is symmetric positive definite for
+// 0 < rho < 1, its condition number grows like (1+rho)/(1-rho), so CG needs many iterations
+// as rho approaches 1, and its largest eigenvalue tends to (1+rho)/(1-rho) for large N.
+// Each rank generates its own rows; the owning threads touch them first.
+void generate_rows(int n, int row_start, int rows, double rho, double *A)
+{
+    double *powers = alloc_doubles(n);
+    powers[0] = 1.0;
+    for (int d = 1; d < n; d++)
+    {
+        powers[d] = powers[d - 1] * rho;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++)
+    {
+        int gi = row_start + i;
+        double *row = &A[(size_t)i * n];
+        for (int j = 0; j < n; j++)
+        {
+            row[j] = powers[gi > j ? gi - j : j - gi];
+        }
+    }
+    free(powers);
+}
+
+// y[0..rows) (+)= A[0..rows)[c0..c0+cols) * x[c0..c0+cols), with A row-major and n doubles per row.
+// ROW_UNROLL rows share each load of x and keep independent vectorized accumulators.
+void block_gemv(int rows, int n, const double *A, int c0, int cols, const double *x, double *y, int accumulate)
+{
+    const double *xb = x + c0;
+#pragma omp parallel for schedule(static)
+    for (int g = 0; g < (rows + ROW_UNROLL - 1) / ROW_UNROLL; g++)
+    {
+        int i = g * ROW_UNROLL;
+        if (i + ROW_UNROLL <= rows)
+        {
+            const double *a0 = &A[(size_t)i * n + c0];
+            const double *a1 = a0 + n;
+            const double *a2 = a1 + n;
+            const double *a3 = a2 + n;
+            double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+#pragma omp simd reduction(+ : s0, s1, s2, s3)
+            for (int j = 0; j < cols; j++)
+            {
+                s0 += a0[j] * xb[j];
+                s1 += a1[j] * xb[j];
+                s2 += a2[j] * xb[j];
+                s3 += a3[j] * xb[j];
+            }
+            y[i] = (accumulate ? y[i] : 0.0) + s0;
+            y[i + 1] = (accumulate ? y[i + 1] : 0.0) + s1;
+            y[i + 2] = (accumulate ? y[i + 2] : 0.0) + s2;
+            y[i + 3] = (accumulate ? y[i + 3] : 0.0) + s3;
+        }
+        else
+        {
+            for (; i < rows; i++) // Leftover rows
+            {
+                const double *a = &A[(size_t)i * n + c0];
+                double s = 0.0;
+#pragma omp simd reduction(+ : s)
+                for (int j = 0; j < cols; j++)
+                {
+                    s += a[j] * xb[j];
+                }
+                y[i] = (accumulate ? y[i] : 0.0) + s;
+            }
+        }
+    }
+}
+
+// Create the persistent requests once. vec is the full-length vector whose slices are exchanged;
+// the requests stay bound to it for the whole run.
+void exchange_init(struct exchange *ex, int n, double *vec, MPI_Comm comm)
+{
+    MPI_Comm_size(comm, &ex->size);
+    MPI_Comm_rank(comm, &ex->rank);
+    ex->counts = malloc(ex->size * sizeof(int));
+    ex->displs = malloc(ex->size * sizeof(int));
+    compute_block_distribution(n, ex->size, ex->counts, ex->displs);
+
+    int others = ex->size - 1;
+    ex->num_requests = 2 * others;
+    ex->requests = malloc((ex->num_requests + 1) * sizeof(MPI_Request));
+    ex->source_of = malloc((others + 1) * sizeof(int));
+    int r = 0;
+    for (int step = 1; step < ex->size; step++)
+    {
+        // Receive from the nearest ranks first so their slices tend to arrive first
+        int src = (ex->rank - step + ex->size) % ex->size;
+        ex->source_of[r] = src;
+        MPI_Recv_init(&vec[ex->displs[src]], ex->counts[src], MPI_DOUBLE, src, 0, comm, &ex->requests[r]);
+        r++;
+    }
+    for (int step = 1; step < ex->size; step++)
+    {
+        int dest = (ex->rank + step) % ex->size;
+        MPI_Send_init(&vec[ex->displs[ex->rank]], ex->counts[ex->rank], MPI_DOUBLE, dest, 0, comm, &ex->requests[r]);
+        r++;
+    }
+}
+
+void exchange_free(struct exchange *ex)
+{
+    for (int r = 0; r < ex->num_requests; r++)
+    {
+        MPI_Request_free(&ex->requests[r]);
+    }
+    free(ex->requests);
+    free(ex->source_of);
+    free(ex->counts);
+    free(ex->displs);
+}
+
+// y = A_local * vec. The exchange of vec is started first; the rank's own columns are multiplied
+// while it is in flight, then each remote column block as soon as its slice arrives.
+// With overlap disabled all slices are awaited before any computation (for comparison).
+void distributed_gemv(struct exchange *ex, int n, const double *A, const double *vec, double *y,
+                      int overlap, struct timings *t)
+{
+    int rows = ex->counts[ex->rank];
+    int others = ex->size - 1;
+    double t0;
+
+    MPI_Startall(ex->num_requests, ex->requests);
+    if (!overlap)
+    {
+        t0 = MPI_Wtime();
+        MPI_Waitall(ex->num_requests, ex->requests, MPI_STATUSES_IGNORE);
+        t->comm_wait += MPI_Wtime() - t0;
+        t0 = MPI_Wtime();
+        block_gemv(rows, n, A, 0, n, vec, y, 0);
+        t->compute += MPI_Wtime() - t0;
+        return;
+    }
+
+    t0 = MPI_Wtime();
+    block_gemv(rows, n, A, ex->displs[ex->rank], ex->counts[ex->rank], vec, y, 0);
+    t->compute += MPI_Wtime() - t0;
+
+    for (int done = 0; done < others; done++)
+    {
+        int index;
+        t0 = MPI_Wtime();
+        MPI_Waitany(others, ex->requests, &index, MPI_STATUS_IGNORE);
+        t->comm_wait += MPI_Wtime() - t0;
+
+        int src = ex->source_of[index];
+        t0 = MPI_Wtime();
+        block_gemv(rows, n, A, ex->displs[src], ex->counts[src], vec, y, 1);
+        t->compute += MPI_Wtime() - t0;
+    }
+
+    // Sends must complete before the caller may overwrite its slice of vec
+    t0 = MPI_Wtime();
+    MPI_Waitall(others, &ex->requests[others], MPI_STATUSES_IGNORE);
+    t->comm_wait += MPI_Wtime() - t0;
+}
+
+double local_dot(int len, const double *a, const double *b)
+{
+    double sum = 0.0;
+#pragma omp parallel for simd reduction(+ : sum) schedule(static)
+    for (int i = 0; i < len; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Complete a nonblocking reduction and charge the blocked time to communication
+void wait_reduction(MPI_Request *req, struct timings *t)
+{
+    double t0 = MPI_Wtime();
+    MPI_Wait(req, MPI_STATUS_IGNORE);
+    t->comm_wait += MPI_Wtime() - t0;
+}
+
+// Print one progress line on the root; iteration times are the maximum over all ranks
+void report_iteration(int rank, int iter, double value, double iter_time, MPI_Comm comm)
+{
+    double max_time;
+    MPI_Reduce(&iter_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    if (rank == 0)
+    {
+        printf("  %6d  %22.14e  %12.6f ms\n", iter, value, max_time * 1e3);
+    }
+}
+
+// Conjugate Gradient for A x = b with b = A * ones, so the exact solution is all ones.
+// p is the full-length vector bound to the persistent requests; its owned slice is updated in place.
+// Returns the number of iterations performed; *final_residual is ||r|| / ||b||.
+int run_cg(struct exchange *ex, int n, const double *A, double *p, int max_iters, double tol,
+           int overlap, struct timings *t, double *final_residual, double *max_error, MPI_Comm comm)
+{
+    int rows = ex->counts[ex->rank];
+    double *p_own = &p[ex->displs[ex->rank]];
+    double *x = alloc_doubles(rows);
+    double *r = alloc_doubles(rows);
+    double *q = alloc_doubles(rows);
+    struct timings setup = {0.0, 0.0, 0.0};
+    MPI_Request req;
+
+    // --- b = A * ones, computed with the same distributed product ---
+    for (int i = 0; i < rows; i++)
+    {
+        p_own[i] = 1.0;
+    }
+    distributed_gemv(ex, n, A, p, r, overlap, &setup);
+
+    // x = 0, r = b, p = r
+    double local[2], global[2];
+    for (int i = 0; i < rows; i++)
+    {
+        x[i] = 0.0;
+        p_own[i] = r[i];
+    }
+    local[0] = local_dot(rows, r, r);
+    MPI_Allreduce(local, global, 1, MPI_DOUBLE, MPI_SUM, comm);
+    double rr = global[0];
+    double bnorm = sqrt(rr);
+
+    int iter = 0;
+    double residual = 1.0;
+    while (iter < max_iters && residual > tol)
+    {
+        double iter_start = MPI_Wtime();
+
+        // q = A p, overlapped with the exchange of p
+        distributed_gemv(ex, n, A, p, q, overlap, t);
+
+        // alpha = rr / (p . q)
+        double t0 = MPI_Wtime();
+        local[0] = local_dot(rows, p_own, q);
+        t->compute += MPI_Wtime() - t0;
+        MPI_Iallreduce(local, global, 1, MPI_DOUBLE, MPI_SUM, comm, &req);
+        wait_reduction(&req, t);
+        double alpha = rr / global[0];
+
+        // r -= alpha q, then reduce r . r while x is updated
+        t0 = MPI_Wtime();
+        for (int i = 0; i < rows; i++)
+        {
+            r[i] -= alpha * q[i];
+        }
+        local[1] = local_dot(rows, r, r);
+        t->compute += MPI_Wtime() - t0;
+        MPI_Iallreduce(&local[1], &global[1], 1, MPI_DOUBLE, MPI_SUM, comm, &req);
+
+        t0 = MPI_Wtime();
+        for (int i = 0; i < rows; i++)
+        {
+            x[i] += alpha * p_own[i];
+        }
+        t->compute += MPI_Wtime() - t0;
+        wait_reduction(&req, t);
+
+        double rr_new = global[1];
+        double beta = rr_new / rr;
+        rr = rr_new;
+        t0 = MPI_Wtime();
+        for (int i = 0; i < rows; i++)
+        {
+            p_own[i] = r[i] + beta * p_own[i];
+        }
+        t->compute += MPI_Wtime() - t0;
+
+        iter++;
+        residual = sqrt(rr) / bnorm;
+        double iter_time = MPI_Wtime() - iter_start;
+        t->iteration += iter_time;
+        if (iter % REPORT_EVERY == 0 || iter == 1)
+        {
+            report_iteration(ex->rank, iter, residual, iter_time, comm);
+        }
+    }
+
+    // --- Error against the known solution ---
+    double local_err = 0.0;
+    for (int i = 0; i < rows; i++)
+    {
+        double err = fabs(x[i] - 1.0);
+        local_err = err > local_err ? err : local_err;
+    }
+    MPI_Allreduce(&local_err, max_error, 1, MPI_DOUBLE, MPI_MAX, comm);
+    *final_residual = residual;
+
+    free(x);
+    free(r);
+    free(q);
+    return iter;
+}
+
+// Power iteration: v <- A v / ||A v||, eigenvalue estimate lambda = v . A v for unit v.
+// Both dot products of an iteration travel in one nonblocking reduction.
+// Returns the number of iterations performed; *lambda is the final estimate.
+int run_power(struct exchange *ex, int n, const double *A, double *v, int max_iters, double tol,
+              int overlap, struct timings *t, double *lambda, MPI_Comm comm)
+{
+    int rows = ex->counts[ex->rank];
+    double *v_own = &v[ex->displs[ex->rank]];
+    double *w = alloc_doubles(rows);
+    MPI_Request req;
+
+    // Start from a normalized all-ones vector
+    for (int i = 0; i < rows; i++)
+    {
+        v_own[i] = 1.0 / sqrt((double)n);
+    }
+
+    int iter = 0;
+    double change = 1.0;
+    double estimate = 0.0;
+    while (iter < max_iters && change > tol)
+    {
+        double iter_start = MPI_Wtime();
+
+        distributed_gemv(ex, n, A, v, w, overlap, t);
+
+        double local[2], global[2];
+        double t0 = MPI_Wtime();
+        local[0] = local_dot(rows, v_own, w);
+        local[1] = local_dot(rows, w, w);
+        t->compute += MPI_Wtime() - t0;
+        MPI_Iallreduce(local, global, 2, MPI_DOUBLE, MPI_SUM, comm, &req);
+        wait_reduction(&req, t);
+
+        double previous = estimate;
+        estimate = global[0];
+        double inv_norm = 1.0 / sqrt(global[1]);
+        t0 = MPI_Wtime();
+        for (int i = 0; i < rows; i++)
+        {
+            v_own[i] = w[i] * inv_norm;
+        }
+        t->compute += MPI_Wtime() - t0;
+
+        iter++;
+        change = fabs(estimate - previous) / fabs(estimate);
+        double iter_time = MPI_Wtime() - iter_start;
+        t->iteration += iter_time;
+        if (iter % REPORT_EVERY == 0 || iter == 1)
+        {
+            report_iteration(ex->rank, iter, estimate, iter_time, comm);
+        }
+    }
+
+    *lambda = estimate;
+    free(w);
+    return iter;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-a cg|power] [-k MAX_ITERS] [-t TOL] [-p RHO] [-s] [N]\n", prog);
+    fprintf(stderr, "  -a cg     Conjugate Gradient on A x = A * ones (default)\n");
+    fprintf(stderr, "  -a power  Power iteration for the dominant eigenvalue\n");
+    fprintf(stderr, "  -k ITERS  Iteration limit (default: %d)\n", DEFAULT_ITERS);
+    fprintf(stderr, "  -t TOL    Relative tolerance (default: %g)\n", DEFAULT_TOL);
+    fprintf(stderr, "  -p RHO    Test matrix A[i][j] = RHO^|i-j|, 0 < RHO < 1 (default: %g)\n", DEFAULT_RHO);
+    fprintf(stderr, "  -s        Wait for the whole exchange before computing (no overlap)\n");
+    fprintf(stderr, "  N         Matrix dimension (default: %d)\n", DEFAULT_N);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size;
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided); // Initialize MPI environment
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // --- Argument Handling (Rank 0 parses and broadcasts the settings) ---
+    int ints[5] = {1, ALG_CG, DEFAULT_N, DEFAULT_ITERS, 1}; // ok, algorithm, n, max_iters, overlap
+    double reals[2] = {DEFAULT_TOL, DEFAULT_RHO};          // tol, rho
+    if (rank == 0)
+    {
+        int opt;
+        while (ints[0] && (opt = getopt(argc, argv, "a:k:t:p:s")) != -1)
+        {
+            if (opt == 'a' && strcmp(optarg, "cg") == 0)
+            {
+                ints[1] = ALG_CG;
+            }
+            else if (opt == 'a' && strcmp(optarg, "power") == 0)
+            {
+                ints[1] = ALG_POWER;
+            }
+            else if (opt == 'k' && atoi(optarg) > 0)
+            {
+                ints[3] = atoi(optarg);
+            }
+            else if (opt == 't' && atof(optarg) > 0.0)
+            {
+                reals[0] = atof(optarg);
+            }
+            else if (opt == 'p' && atof(optarg) > 0.0 && atof(optarg) < 1.0)
+            {
+                reals[1] = atof(optarg);
+            }
+            else if (opt == 's')
+            {
+                ints[4] = 0;
+            }
+            else
+            {
+                print_usage(argv[0]);
+                ints[0] = 0;
+            }
+        }
+        if (ints[0] && optind < argc)
+        {
+            ints[2] = atoi(argv[optind]);
+            if (ints[2] <= 0)
+            {
+                print_usage(argv[0]);
+                ints[0] = 0;
+            }
+        }
+    }
+    MPI_Bcast(ints, 5, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(reals, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (!ints[0])
+    {
+        MPI_Finalize();
+        return 1;
+    }
+    int algorithm = ints[1], n = ints[2], max_iters = ints[3], overlap = ints[4];
+    double tol = reals[0], rho = reals[1];
+
+    // --- Distributed, resident data: rows of A and the full-length exchanged vector ---
+    int *counts = malloc(size * sizeof(int));
+    int *displs = malloc(size * sizeof(int));
+    compute_block_distribution(n, size, counts, displs);
+    int rows = counts[rank];
+    double *A = alloc_doubles((size_t)rows * n);
+    double *vec = alloc_doubles(n);
+    int alloc_ok = A != NULL && vec != NULL, all_ok;
+    MPI_Allreduce(&alloc_ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!all_ok)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Failed to allocate buffers for N=%d on one or more processes.\n", n);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    double setup_start = MPI_Wtime();
+    generate_rows(n, displs[rank], rows, rho, A);
+    struct exchange ex;
+    exchange_init(&ex, n, vec, MPI_COMM_WORLD);
+    double setup_time = MPI_Wtime() - setup_start, max_setup;
+    MPI_Reduce(&setup_time, &max_setup, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        printf("MPI Iterative Solver (%s, N=%d, Processes=%d, rho=%g, overlap=%s)\n",
+               algorithm == ALG_CG ? "Conjugate Gradient" : "Power Iteration",
+               n, size, rho, overlap ? "on" : "off");
+        printf("  %6s  %22s  %15s\n", "iter", algorithm == ALG_CG ? "rel. residual" : "eigenvalue", "iteration time");
+    }
+
+    // --- Iterate ---
+    struct timings t = {0.0, 0.0, 0.0};
+    MPI_Barrier(MPI_COMM_WORLD);
+    int iters;
+    double value, max_error = 0.0;
+    if (algorithm == ALG_CG)
+    {
+        iters = run_cg(&ex, n, A, vec, max_iters, tol, overlap, &t, &value, &max_error, MPI_COMM_WORLD);
+    }
+    else
+    {
+        iters = run_power(&ex, n, A, vec, max_iters, tol, overlap, &t, &value, MPI_COMM_WORLD);
+    }
+
+    // --- Summary: slowest rank for totals, plus how much of the exchange stayed exposed ---
+    double local_t[3] = {t.iteration, t.compute, t.comm_wait};
+    double max_t[3];
+    MPI_Reduce(local_t, max_t, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        printf("--------------------------------------------------\n");
+        printf("Iterations:              %d\n", iters);
+        if (algorithm == ALG_CG)
+        {
+            printf("Final relative residual: %.3e\n", value);
+            printf("Max error vs. x = 1:     %.3e\n", max_error);
+        }
+        else
+        {
+            printf("Dominant eigenvalue:     %.12f\n", value);
+            printf("Large-N limit:           %.12f\n", (1.0 + rho) / (1.0 - rho));
+        }
+        printf("Setup time:              %f seconds\n", max_setup);
+        printf("Total iteration time:    %f seconds\n", max_t[0]);
+        printf("Mean time per iteration: %f ms\n", iters > 0 ? max_t[0] / iters * 1e3 : 0.0);
+        printf("Compute time (max rank): %f seconds\n", max_t[1]);
+        printf("Exposed comm (max rank): %f seconds (%.1f%% of iteration time)\n",
+               max_t[2], max_t[0] > 0.0 ? 100.0 * max_t[2] / max_t[0] : 0.0);
+    }
+
+    // --- Cleanup ---
+    exchange_free(&ex);
+    free(A);
+    free(vec);
+    free(counts);
+    free(displs);
+
+    MPI_Finalize();
+    return 0;
+}
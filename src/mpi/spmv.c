@@ -0,0 +1,888 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // For strcmp, memcpy
+#include <unistd.h> // For getopt
+#include <math.h>   // For fabs
+
+// Sparse matrix-vector multiplication y = A * x with A stored in CSR (compressed sparse row) form.
+// Rows are split so every rank gets about the same number of nonzeros, x is distributed like the
+// rows, and each rank receives only the entries of x that its columns actually reference (the halo)
+// instead of a broadcast of the whole vector.
+
+#define ALIGNMENT 64         // Cache-line alignment for every heap buffer
+#define DEFAULT_GRID 100     // Default points per dimension for the built-in stencils
+#define DEFAULT_REPS 10      // Default number of timed products
+#define MAX_PATH_LEN 4096    // Longest Matrix Market path accepted on the command line
+#define MAX_LINE_LEN 1024    // Longest line read from a Matrix Market file
+
+// Built-in matrix generators and file input, selected with -g / -f
+enum matrix_source
+{
+    SOURCE_LAP2D = 1, // 5-point Laplacian on a K x K grid (N = K^2)
+    SOURCE_LAP3D = 2, // 7-point Laplacian on a K x K x K grid (N = K^3)
+    SOURCE_FILE = 3   // Matrix Market coordinate file read by the root
+};
+
+// The rows of a square N x N matrix owned by one rank, in CSR form.
+// Until setup_halo runs col_idx holds global column indices; afterwards it holds indices into
+// the extended local x: [0, rows) are owned entries, [rows, rows + num_ghosts) are halo entries.
+struct csr_matrix
+{
+    int n;              // Global dimension
+    int row_start;      // First global row owned by this rank
+    int rows;           // Number of rows owned by this rank
+    long long nnz;      // Nonzeros owned by this rank
+    long long *row_ptr; // rows + 1 offsets into col_idx / values
+    int *col_idx;
+    double *values;
+};
+
+// Communication pattern for the halo of x, computed once and reused for every product
+struct halo
+{
+    int num_ghosts;     // Remote x entries this rank needs
+    int *ghost_global;  // Global index of each ghost, sorted (so grouped by owner)
+    int num_recv;       // Ranks we receive from
+    int *recv_ranks;
+    int *recv_counts;
+    int *recv_displs;   // Offsets into the ghost part of the extended x
+    int num_send;       // Ranks we send to
+    int *send_ranks;
+    int *send_counts;
+    int *send_displs;   // Offsets into send_idx / send_buf
+    int *send_idx;      // Local x indices to pack for each destination
+    double *send_buf;
+    MPI_Request *requests;
+};
+
+// Allocate a contiguous, cache-line aligned buffer (NULL on failure)
+void *alloc_aligned(size_t bytes)
+{
+    void *ptr = NULL;
+    if (bytes == 0)
+    {
+        bytes = ALIGNMENT; // Keep a valid pointer even for ranks that own nothing
+    }
+    if (posix_memalign(&ptr, ALIGNMENT, bytes) != 0)
+    {
+        return NULL;
+    }
+    return ptr;
+}
+
+// Deterministic, non-constant test vector so a wrong halo entry shows up in the check
+double vector_entry(int j)
+{
+    return 1.0 + (double)(j % 7);
+}
+
+// Row `row` of the 5- or 7-point Laplacian on a k^dim grid. Writes the entries when cols/vals
+// are not NULL and returns the number of nonzeros in the row either way.
+int stencil_row(int source, int k, int row, int *cols, double *vals)
+{
+    int dim = (source == SOURCE_LAP3D) ? 3 : 2;
+    int coord[3] = {0, 0, 0};
+    int stride[3] = {1, k, k * k};
+    int rest = row;
+    for (int d = 0; d < dim; d++)
+    {
+        coord[d] = rest % k;
+        rest /= k;
+    }
+
+    int count = 0;
+    for (int d = dim - 1; d >= 0; d--) // Lower neighbours first keeps the row sorted
+    {
+        if (coord[d] > 0)
+        {
+            if (cols != NULL)
+            {
+                cols[count] = row - stride[d];
+                vals[count] = -1.0;
+            }
+            count++;
+        }
+    }
+    if (cols != NULL)
+    {
+        cols[count] = row;
+        vals[count] = 2.0 * dim;
+    }
+    count++;
+    for (int d = 0; d < dim; d++)
+    {
+        if (coord[d] < k - 1)
+        {
+            if (cols != NULL)
+            {
+                cols[count] = row + stride[d];
+                vals[count] = -1.0;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+// For each target t_k = k * total / size (k = 0..size) count the rows whose preceding nonzero
+// count nnz_before[i] is below t_k. nnz_before is nondecreasing, so the count is the first row of
+// part k; summing the counts over all ranks gives the global nonzero-balanced row bounds.
+void count_rows_below_targets(const long long *nnz_before, int rows, long long total, int size, long long *counts)
+{
+    for (int k = 0; k <= size; k++)
+    {
+        long long target = (long long)((double)total * k / size);
+        int lo = 0, hi = rows; // Binary search for the first row with nnz_before >= target
+        while (lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+            if (nnz_before[mid] < target)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        counts[k] = lo;
+    }
+}
+
+// Turn the summed counts into row bounds: rank p owns rows [bounds[p], bounds[p + 1])
+void finish_bounds(const long long *counts, int n, int size, int *bounds)
+{
+    for (int k = 0; k <= size; k++)
+    {
+        bounds[k] = (int)counts[k];
+    }
+    bounds[0] = 0;
+    bounds[size] = n; // Trailing empty rows still belong to the last rank
+}
+
+// Allocate the CSR arrays for a local block. Returns 0 on success.
+int alloc_csr(struct csr_matrix *A, int rows, long long nnz)
+{
+    A->rows = rows;
+    A->nnz = nnz;
+    A->row_ptr = alloc_aligned((size_t)(rows + 1) * sizeof(long long));
+    A->col_idx = alloc_aligned((size_t)nnz * sizeof(int));
+    A->values = alloc_aligned((size_t)nnz * sizeof(double));
+    return (A->row_ptr != NULL && A->col_idx != NULL && A->values != NULL) ? 0 : 1;
+}
+
+void free_csr(struct csr_matrix *A)
+{
+    free(A->row_ptr);
+    free(A->col_idx);
+    free(A->values);
+}
+
+// Build this rank's rows of a stencil matrix without any rank holding more than its own part.
+// A provisional equal-rows split is used only to count nonzeros; the real split balances them.
+// Returns 0 on success.
+int generate_stencil(int source, int k, struct csr_matrix *A, int *bounds, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int n = (source == SOURCE_LAP3D) ? k * k * k : k * k;
+    A->n = n;
+
+    // --- Count nonzeros over a provisional equal-rows split ---
+    int prov_start = (int)((long long)n * rank / size);
+    int prov_rows = (int)((long long)n * (rank + 1) / size) - prov_start;
+    long long *nnz_before = malloc((size_t)(prov_rows + 1) * sizeof(long long));
+    long long local_nnz = 0;
+    for (int i = 0; i < prov_rows; i++)
+    {
+        nnz_before[i] = local_nnz;
+        local_nnz += stencil_row(source, k, prov_start + i, NULL, NULL);
+    }
+
+    long long offset = 0, total = 0;
+    MPI_Exscan(&local_nnz, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&local_nnz, &total, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0)
+    {
+        offset = 0; // MPI_Exscan leaves rank 0's result undefined
+    }
+    for (int i = 0; i < prov_rows; i++)
+    {
+        nnz_before[i] += offset;
+    }
+
+    // --- Nonzero-balanced bounds ---
+    long long *counts = malloc((size + 1) * sizeof(long long));
+    long long *summed = malloc((size + 1) * sizeof(long long));
+    count_rows_below_targets(nnz_before, prov_rows, total, size, counts);
+    MPI_Allreduce(counts, summed, size + 1, MPI_LONG_LONG, MPI_SUM, comm);
+    finish_bounds(summed, n, size, bounds);
+    free(counts);
+    free(summed);
+    free(nnz_before);
+
+    // --- Generate the owned rows ---
+    A->row_start = bounds[rank];
+    int rows = bounds[rank + 1] - bounds[rank];
+    long long nnz = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        nnz += stencil_row(source, k, A->row_start + i, NULL, NULL);
+    }
+    if (alloc_csr(A, rows, nnz) != 0)
+    {
+        return 1;
+    }
+    A->row_ptr[0] = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        long long pos = A->row_ptr[i];
+        A->row_ptr[i + 1] = pos + stencil_row(source, k, A->row_start + i, &A->col_idx[pos], &A->values[pos]);
+    }
+    return 0;
+}
+
+// Root reads a Matrix Market coordinate file (real, integer or pattern; general or symmetric)
+// into a full CSR matrix. Text input is inherently serial, so this is meant for files that fit
+// on the root; the stencil generators cover the sizes beyond that. Returns 0 on success.
+int read_matrix_market(const char *path, struct csr_matrix *A)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open '%s'.\n", path);
+        return 1;
+    }
+
+    char line[MAX_LINE_LEN];
+    char object[64], format[64], field[64], symmetry[64];
+    if (fgets(line, sizeof(line), fp) == NULL ||
+        sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4 ||
+        strcmp(object, "matrix") != 0 || strcmp(format, "coordinate") != 0 ||
+        strcmp(field, "complex") == 0)
+    {
+        fprintf(stderr, "Error: '%s' is not a real Matrix Market coordinate file.\n", path);
+        fclose(fp);
+        return 1;
+    }
+    int pattern = (strcmp(field, "pattern") == 0);
+    int symmetric = (strcmp(symmetry, "symmetric") == 0);
+
+    // Skip comments, then read the size line
+    long long m, n, entries;
+    do
+    {
+        if (fgets(line, sizeof(line), fp) == NULL)
+        {
+            fclose(fp);
+            return 1;
+        }
+    } while (line[0] == '%');
+    if (sscanf(line, "%lld %lld %lld", &m, &n, &entries) != 3 || m != n || n <= 0 || n > 0x7fffffff)
+    {
+        fprintf(stderr, "Error: '%s' must hold a square matrix.\n", path);
+        fclose(fp);
+        return 1;
+    }
+
+    // --- Read the coordinates, then counting-sort them into CSR ---
+    long long stored = symmetric ? 2 * entries : entries;
+    int *ri = malloc((size_t)stored * sizeof(int));
+    int *ci = malloc((size_t)stored * sizeof(int));
+    double *vi = malloc((size_t)stored * sizeof(double));
+    if (ri == NULL || ci == NULL || vi == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate %lld coordinates for '%s'.\n", stored, path);
+        free(ri);
+        free(ci);
+        free(vi);
+        fclose(fp);
+        return 1;
+    }
+    long long count = 0;
+    for (long long e = 0; e < entries; e++)
+    {
+        long long r, c;
+        double v = 1.0;
+        int ok = pattern ? fscanf(fp, "%lld %lld", &r, &c) == 2 : fscanf(fp, "%lld %lld %lf", &r, &c, &v) == 3;
+        if (!ok || r < 1 || r > n || c < 1 || c > n)
+        {
+            fprintf(stderr, "Error: Bad entry %lld in '%s'.\n", e + 1, path);
+            free(ri);
+            free(ci);
+            free(vi);
+            fclose(fp);
+            return 1;
+        }
+        ri[count] = (int)(r - 1);
+        ci[count] = (int)(c - 1);
+        vi[count++] = v;
+        if (symmetric && r != c)
+        {
+            ri[count] = (int)(c - 1);
+            ci[count] = (int)(r - 1);
+            vi[count++] = v;
+        }
+    }
+    fclose(fp);
+
+    A->n = (int)n;
+    A->row_start = 0;
+    if (alloc_csr(A, (int)n, count) != 0)
+    {
+        free(ri);
+        free(ci);
+        free(vi);
+        return 1;
+    }
+    memset(A->row_ptr, 0, (size_t)(n + 1) * sizeof(long long));
+    for (long long e = 0; e < count; e++)
+    {
+        A->row_ptr[ri[e] + 1]++;
+    }
+    for (long long i = 0; i < n; i++)
+    {
+        A->row_ptr[i + 1] += A->row_ptr[i];
+    }
+    long long *next = malloc((size_t)n * sizeof(long long));
+    if (next == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the row cursors for '%s'.\n", path);
+        free_csr(A);
+        free(ri);
+        free(ci);
+        free(vi);
+        return 1;
+    }
+    memcpy(next, A->row_ptr, (size_t)n * sizeof(long long));
+    for (long long e = 0; e < count; e++)
+    {
+        long long pos = next[ri[e]]++;
+        A->col_idx[pos] = ci[e];
+        A->values[pos] = vi[e];
+    }
+    free(next);
+    free(ri);
+    free(ci);
+    free(vi);
+    return 0;
+}
+
+// Root splits the full matrix by nonzeros and sends every rank its rows. Returns 0 on success.
+int distribute_from_root(const struct csr_matrix *full, struct csr_matrix *A, int *bounds, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int n = 0;
+    int fits = 1;
+    int planned = 1; // Root could allocate its distribution tables
+    int *row_counts = NULL, *row_displs = NULL, *nnz_counts = NULL, *nnz_displs = NULL;
+    long long *row_nnz = NULL;
+    if (rank == 0)
+    {
+        n = full->n;
+        long long *counts = malloc((size + 1) * sizeof(long long));
+        row_counts = malloc(size * sizeof(int));
+        row_displs = malloc(size * sizeof(int));
+        nnz_counts = malloc(size * sizeof(int));
+        nnz_displs = malloc(size * sizeof(int));
+        row_nnz = malloc((size_t)(n > 0 ? n : 1) * sizeof(long long));
+        planned = counts != NULL && row_counts != NULL && row_displs != NULL && nnz_counts != NULL &&
+                  nnz_displs != NULL && row_nnz != NULL;
+        if (planned)
+        {
+            count_rows_below_targets(full->row_ptr, full->rows, full->nnz, size, counts);
+            finish_bounds(counts, n, size, bounds);
+            for (int p = 0; p < size; p++)
+            {
+                long long nnz_p = full->row_ptr[bounds[p + 1]] - full->row_ptr[bounds[p]];
+                row_counts[p] = bounds[p + 1] - bounds[p];
+                row_displs[p] = bounds[p];
+                nnz_counts[p] = (int)nnz_p;
+                nnz_displs[p] = (int)full->row_ptr[bounds[p]];
+                fits = fits && nnz_p <= 0x7fffffff && full->row_ptr[bounds[p]] <= 0x7fffffff;
+            }
+
+            // Per-row nonzero counts are what each rank needs to rebuild its own row_ptr
+            for (int i = 0; i < n; i++)
+            {
+                row_nnz[i] = full->row_ptr[i + 1] - full->row_ptr[i];
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Error: Cannot allocate the distribution tables for %d ranks.\n", size);
+        }
+        free(counts);
+    }
+    MPI_Bcast(&planned, 1, MPI_INT, 0, comm);
+    if (!planned)
+    {
+        // Every rank returns before reading bounds, which the root never filled
+        free(row_counts);
+        free(row_displs);
+        free(nnz_counts);
+        free(nnz_displs);
+        free(row_nnz);
+        return 1;
+    }
+    MPI_Bcast(&fits, 1, MPI_INT, 0, comm);
+    MPI_Bcast(&n, 1, MPI_INT, 0, comm);
+    MPI_Bcast(bounds, size + 1, MPI_INT, 0, comm);
+
+    int ok = fits;
+    A->n = n;
+    A->row_start = bounds[rank];
+    int rows = bounds[rank + 1] - bounds[rank];
+    if (ok)
+    {
+        long long *my_row_nnz = malloc((size_t)(rows > 0 ? rows : 1) * sizeof(long long));
+        if (my_row_nnz == NULL)
+        {
+            fprintf(stderr, "Error: Cannot allocate the row counts of rank %d.\n", rank);
+            MPI_Abort(comm, 1); // The scatter below is collective, so this rank cannot just drop out
+        }
+        MPI_Scatterv(row_nnz, row_counts, row_displs, MPI_LONG_LONG,
+                     my_row_nnz, rows, MPI_LONG_LONG, 0, comm);
+        long long nnz = 0;
+        for (int i = 0; i < rows; i++)
+        {
+            nnz += my_row_nnz[i];
+        }
+        ok = (alloc_csr(A, rows, nnz) == 0);
+        if (ok)
+        {
+            A->row_ptr[0] = 0;
+            for (int i = 0; i < rows; i++)
+            {
+                A->row_ptr[i + 1] = A->row_ptr[i] + my_row_nnz[i];
+            }
+        }
+        free(my_row_nnz);
+    }
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    if (all_ok)
+    {
+        MPI_Scatterv(rank == 0 ? full->col_idx : NULL, nnz_counts, nnz_displs, MPI_INT,
+                     A->col_idx, (int)A->nnz, MPI_INT, 0, comm);
+        MPI_Scatterv(rank == 0 ? full->values : NULL, nnz_counts, nnz_displs, MPI_DOUBLE,
+                     A->values, (int)A->nnz, MPI_DOUBLE, 0, comm);
+    }
+
+    free(row_counts);
+    free(row_displs);
+    free(nnz_counts);
+    free(nnz_displs);
+    free(row_nnz);
+    return all_ok ? 0 : 1;
+}
+
+int compare_ints(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Rank owning global index j: the last p with bounds[p] <= j
+int owner_of(int j, const int *bounds, int size)
+{
+    int lo = 0, hi = size - 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (bounds[mid] <= j)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// Work out once which remote x entries this rank needs and which of its own entries others need,
+// then renumber col_idx to the extended local x. Returns 0 on success.
+int setup_halo(struct csr_matrix *A, const int *bounds, struct halo *h, MPI_Comm comm)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+    int row_end = A->row_start + A->rows;
+
+    // --- Unique remote columns, sorted (and therefore grouped by owner) ---
+    long long remote = 0;
+    for (long long e = 0; e < A->nnz; e++)
+    {
+        int c = A->col_idx[e];
+        remote += (c < A->row_start || c >= row_end);
+    }
+    int *ghosts = malloc((size_t)(remote > 0 ? remote : 1) * sizeof(int));
+    long long g = 0;
+    for (long long e = 0; e < A->nnz; e++)
+    {
+        int c = A->col_idx[e];
+        if (c < A->row_start || c >= row_end)
+        {
+            ghosts[g++] = c;
+        }
+    }
+    qsort(ghosts, (size_t)remote, sizeof(int), compare_ints);
+    int num_ghosts = 0;
+    for (long long e = 0; e < remote; e++)
+    {
+        if (num_ghosts == 0 || ghosts[num_ghosts - 1] != ghosts[e])
+        {
+            ghosts[num_ghosts++] = ghosts[e];
+        }
+    }
+    h->num_ghosts = num_ghosts;
+    h->ghost_global = ghosts;
+
+    // --- How many entries we need from each rank, and how many each rank needs from us ---
+    int *need = calloc(size, sizeof(int));
+    int *give = malloc(size * sizeof(int));
+    for (int i = 0; i < num_ghosts; i++)
+    {
+        need[owner_of(ghosts[i], bounds, size)]++;
+    }
+    MPI_Alltoall(need, 1, MPI_INT, give, 1, MPI_INT, comm);
+
+    int *need_displs = malloc(size * sizeof(int));
+    int *give_displs = malloc(size * sizeof(int));
+    int total_give = 0, offset = 0;
+    h->num_recv = h->num_send = 0;
+    for (int p = 0; p < size; p++)
+    {
+        need_displs[p] = offset;
+        offset += need[p];
+        give_displs[p] = total_give;
+        total_give += give[p];
+        h->num_recv += (need[p] > 0);
+        h->num_send += (give[p] > 0);
+    }
+
+    // Tell every owner which of its entries we need
+    h->send_idx = malloc((size_t)(total_give > 0 ? total_give : 1) * sizeof(int));
+    MPI_Alltoallv(ghosts, need, need_displs, MPI_INT,
+                  h->send_idx, give, give_displs, MPI_INT, comm);
+    for (int i = 0; i < total_give; i++)
+    {
+        h->send_idx[i] -= A->row_start; // Global to local index
+    }
+
+    // --- Compact neighbour lists ---
+    h->recv_ranks = malloc((h->num_recv + 1) * sizeof(int));
+    h->recv_counts = malloc((h->num_recv + 1) * sizeof(int));
+    h->recv_displs = malloc((h->num_recv + 1) * sizeof(int));
+    h->send_ranks = malloc((h->num_send + 1) * sizeof(int));
+    h->send_counts = malloc((h->num_send + 1) * sizeof(int));
+    h->send_displs = malloc((h->num_send + 1) * sizeof(int));
+    int r = 0, s = 0;
+    for (int p = 0; p < size; p++)
+    {
+        if (need[p] > 0)
+        {
+            h->recv_ranks[r] = p;
+            h->recv_counts[r] = need[p];
+            h->recv_displs[r++] = need_displs[p];
+        }
+        if (give[p] > 0)
+        {
+            h->send_ranks[s] = p;
+            h->send_counts[s] = give[p];
+            h->send_displs[s++] = give_displs[p];
+        }
+    }
+    h->send_buf = alloc_aligned((size_t)total_give * sizeof(double));
+    h->requests = malloc((h->num_recv + h->num_send + 1) * sizeof(MPI_Request));
+    free(need);
+    free(give);
+    free(need_displs);
+    free(give_displs);
+
+    // --- Renumber columns: owned -> [0, rows), ghost -> rows + position in ghost list ---
+    for (long long e = 0; e < A->nnz; e++)
+    {
+        int c = A->col_idx[e];
+        if (c >= A->row_start && c < row_end)
+        {
+            A->col_idx[e] = c - A->row_start;
+        }
+        else
+        {
+            int *pos = bsearch(&c, ghosts, num_ghosts, sizeof(int), compare_ints);
+            A->col_idx[e] = A->rows + (int)(pos - ghosts);
+        }
+    }
+    return h->send_buf != NULL ? 0 : 1;
+}
+
+void free_halo(struct halo *h)
+{
+    free(h->ghost_global);
+    free(h->recv_ranks);
+    free(h->recv_counts);
+    free(h->recv_displs);
+    free(h->send_ranks);
+    free(h->send_counts);
+    free(h->send_displs);
+    free(h->send_idx);
+    free(h->send_buf);
+    free(h->requests);
+}
+
+// Fill the ghost part of x_ext (which starts with the rows owned entries) from the neighbours
+void exchange_halo(const struct csr_matrix *A, struct halo *h, double *x_ext, MPI_Comm comm)
+{
+    int req = 0;
+    for (int r = 0; r < h->num_recv; r++)
+    {
+        MPI_Irecv(&x_ext[A->rows + h->recv_displs[r]], h->recv_counts[r], MPI_DOUBLE,
+                  h->recv_ranks[r], 0, comm, &h->requests[req++]);
+    }
+    for (int s = 0; s < h->num_send; s++)
+    {
+        double *buf = &h->send_buf[h->send_displs[s]];
+        const int *idx = &h->send_idx[h->send_displs[s]];
+        for (int i = 0; i < h->send_counts[s]; i++)
+        {
+            buf[i] = x_ext[idx[i]];
+        }
+        MPI_Isend(buf, h->send_counts[s], MPI_DOUBLE, h->send_ranks[s], 0, comm, &h->requests[req++]);
+    }
+    MPI_Waitall(req, h->requests, MPI_STATUSES_IGNORE);
+}
+
+// Local kernel: y = A * x_ext over the owned rows, rows split across the OpenMP threads
+void local_spmv(const struct csr_matrix *A, const double *x_ext, double *y)
+{
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < A->rows; i++)
+    {
+        double sum = 0.0;
+        for (long long e = A->row_ptr[i]; e < A->row_ptr[i + 1]; e++)
+        {
+            sum += A->values[e] * x_ext[A->col_idx[e]];
+        }
+        y[i] = sum;
+    }
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-g lap2d|lap3d] [-n K] [-f FILE.mtx] [-r REPS]\n", prog);
+    fprintf(stderr, "  -g lap2d  5-point Laplacian on a K x K grid (default)\n");
+    fprintf(stderr, "  -g lap3d  7-point Laplacian on a K x K x K grid\n");
+    fprintf(stderr, "  -n K      Grid points per dimension (default: %d)\n", DEFAULT_GRID);
+    fprintf(stderr, "  -f FILE   Read a square Matrix Market coordinate file instead\n");
+    fprintf(stderr, "  -r REPS   Number of timed products (default: %d)\n", DEFAULT_REPS);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size;
+    int source = SOURCE_LAP2D;
+    int k = DEFAULT_GRID;
+    int reps = DEFAULT_REPS;
+    char path[MAX_PATH_LEN] = "";
+    double start_time, elapsed_time, max_time;
+
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided); // Initialize MPI environment
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // --- Argument Handling (Rank 0 parses and broadcasts the settings) ---
+    int args_ok = 1;
+    if (rank == 0)
+    {
+        int opt;
+        while (args_ok && (opt = getopt(argc, argv, "g:n:f:r:")) != -1)
+        {
+            if (opt == 'g' && strcmp(optarg, "lap2d") == 0)
+            {
+                source = SOURCE_LAP2D;
+            }
+            else if (opt == 'g' && strcmp(optarg, "lap3d") == 0)
+            {
+                source = SOURCE_LAP3D;
+            }
+            else if (opt == 'n' && atoi(optarg) > 0)
+            {
+                k = atoi(optarg);
+            }
+            else if (opt == 'f' && strlen(optarg) < MAX_PATH_LEN)
+            {
+                source = SOURCE_FILE;
+                strcpy(path, optarg);
+            }
+            else if (opt == 'r' && atoi(optarg) > 0)
+            {
+                reps = atoi(optarg);
+            }
+            else
+            {
+                print_usage(argv[0]);
+                args_ok = 0;
+            }
+        }
+        long long n_check = (source == SOURCE_LAP3D) ? (long long)k * k * k : (long long)k * k;
+        if (args_ok && source != SOURCE_FILE && n_check > 0x7fffffff)
+        {
+            fprintf(stderr, "Error: Grid too large, N must fit in an int.\n");
+            args_ok = 0;
+        }
+    }
+    int settings[4] = {args_ok, source, k, reps};
+    MPI_Bcast(settings, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(path, MAX_PATH_LEN, MPI_CHAR, 0, MPI_COMM_WORLD);
+    source = settings[1];
+    k = settings[2];
+    reps = settings[3];
+    if (!settings[0])
+    {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // --- Build the distributed matrix ---
+    struct csr_matrix A;
+    int *bounds = malloc((size + 1) * sizeof(int));
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+
+    int status;
+    if (source == SOURCE_FILE)
+    {
+        struct csr_matrix full;
+        int read_ok = 1;
+        if (rank == 0)
+        {
+            read_ok = (read_matrix_market(path, &full) == 0);
+        }
+        MPI_Bcast(&read_ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (!read_ok)
+        {
+            MPI_Finalize();
+            return 1;
+        }
+        status = distribute_from_root(&full, &A, bounds, MPI_COMM_WORLD);
+        if (rank == 0)
+        {
+            free_csr(&full);
+        }
+    }
+    else
+    {
+        status = generate_stencil(source, k, &A, bounds, MPI_COMM_WORLD);
+    }
+
+    int all_status;
+    MPI_Allreduce(&status, &all_status, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (all_status)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Failed to build the distributed matrix.\n");
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // --- Communication pattern (once) ---
+    struct halo h;
+    status = setup_halo(&A, bounds, &h, MPI_COMM_WORLD);
+    double *x_ext = alloc_aligned((size_t)(A.rows + h.num_ghosts) * sizeof(double));
+    double *y = alloc_aligned((size_t)A.rows * sizeof(double));
+    status = status || x_ext == NULL || y == NULL;
+    MPI_Allreduce(&status, &all_status, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (all_status)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Failed to allocate the halo buffers.\n");
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < A.rows; i++)
+    {
+        x_ext[i] = vector_entry(A.row_start + i); // Each rank owns the x entries of its rows
+    }
+
+    elapsed_time = MPI_Wtime() - start_time;
+    double setup_time;
+    MPI_Reduce(&elapsed_time, &setup_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // --- Timed products: halo exchange + local SpMV ---
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+    for (int rep = 0; rep < reps; rep++)
+    {
+        exchange_halo(&A, &h, x_ext, MPI_COMM_WORLD);
+        local_spmv(&A, x_ext, y);
+    }
+    elapsed_time = (MPI_Wtime() - start_time) / reps;
+    MPI_Reduce(&elapsed_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // --- Verify against x evaluated directly at the global column indices ---
+    double local_err = 0.0;
+    for (int i = 0; i < A.rows; i++)
+    {
+        double expected = 0.0;
+        for (long long e = A.row_ptr[i]; e < A.row_ptr[i + 1]; e++)
+        {
+            int c = A.col_idx[e];
+            int global = (c < A.rows) ? A.row_start + c : h.ghost_global[c - A.rows];
+            expected += A.values[e] * vector_entry(global);
+        }
+        double err = fabs(y[i] - expected);
+        if (err > local_err)
+        {
+            local_err = err;
+        }
+    }
+
+    // --- Statistics ---
+    long long nnz_stats[2] = {A.nnz, -A.nnz}; // Max and (negated) min in one reduction
+    long long nnz_max[2];
+    long long halo_local = h.num_ghosts, halo_total, nnz_total;
+    double max_err;
+    MPI_Reduce(nnz_stats, nnz_max, 2, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&A.nnz, &nnz_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&halo_local, &halo_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&local_err, &max_err, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        const char *names[] = {"", "lap2d", "lap3d", path};
+        printf("MPI Sparse Matrix-Vector Multiplication (CSR)\n");
+        printf("Matrix:               %s\n", names[source]);
+        printf("Processes:            %d\n", size);
+        printf("Dimension N:          %d\n", A.n);
+        printf("Nonzeros:             %lld\n", nnz_total);
+        printf("Nonzeros per process: %lld to %lld (imbalance %.3f)\n",
+               -nnz_max[1], nnz_max[0], (double)nnz_max[0] * size / (double)nnz_total);
+        printf("Halo entries:         %lld per product (a full broadcast would move %lld)\n",
+               halo_total, (long long)A.n * (size - 1));
+        printf("Max abs error:        %.3e\n", max_err);
+        printf("Setup time:           %f seconds\n", setup_time);
+        printf("Time per product:     %f seconds (%d repetitions)\n", max_time, reps);
+        printf("Throughput:           %.3f GFLOP/s\n", 2.0 * (double)nnz_total / max_time * 1e-9);
+    }
+
+    // --- Cleanup ---
+    free_halo(&h);
+    free_csr(&A);
+    free(x_ext);
+    free(y);
+    free(bounds);
+
+    MPI_Finalize();
+    return 0;
+}
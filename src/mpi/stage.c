@@ -0,0 +1,414 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>   // For strcpy, strrchr
+#include <stdint.h>   // For uint64_t checksums
+#include <unistd.h>   // For getopt, read, write, getpid
+#include <fcntl.h>    // For open
+#include <errno.h>    // For EEXIST
+#include <sys/stat.h> // For fstat, mkdir, fchmod
+#include "topology.h" // One leader per node
+
+// File staging, in the spirit of Slurm's sbcast: copy one file from rank 0 to node-local storage
+// on every node in roughly the time of a single transfer.
+// Rank 0 reads the file in chunks and broadcasts them to the node leaders with MPI_Ibcast; up to
+// DEPTH chunks are in flight, so reading chunk i+1, the network carrying chunk i and the leaders
+// writing chunk i-1 overlap. Every chunk carries a checksum of its data, which the leaders check
+// before writing; a leader writes to a temporary file and only renames it to the destination when
+// every chunk arrived intact. The file's permission bits are kept, so executables stay executable.
+// One process per node is enough: mpirun --map-by ppr:1:node stage <source> <dest>
+// (other ranks on a node just wait). A relative destination is relative to each process's
+// working directory. If the destination is the source itself on rank 0's node, that node skips it.
+
+#define DEFAULT_CHUNK (4 << 20) // Bytes per broadcast chunk
+#define DEFAULT_DEPTH 4         // Chunks in flight at once
+#define MAX_PATH_LEN 4096       // Longest path accepted on the command line
+#define HOST_LEN 64             // Host name length in the per-node report
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// Node outcome, reported to rank 0
+enum stage_status
+{
+    STAGE_OK = 0,
+    STAGE_SKIPPED = 1,  // Destination is the source (rank 0's node)
+    STAGE_CORRUPT = 2,  // A chunk arrived with a wrong checksum
+    STAGE_IO_ERROR = 3, // Could not create, write or rename the file
+    STAGE_VERIFY = 4    // Re-reading the written file gave a different checksum
+};
+
+const char *status_names[] = {"ok", "skipped (source)", "checksum mismatch", "I/O error", "verify failed"};
+
+// FNV-1a over 64-bit words (bytes for the tail): cheap enough to keep up with the network, and
+// any corrupted word changes the result. Not meant to resist deliberate tampering.
+uint64_t checksum(const unsigned char *data, size_t len)
+{
+    uint64_t h = FNV_OFFSET;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * FNV_PRIME;
+    }
+    for (; i < len; i++)
+    {
+        h = (h ^ data[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+// Whole-file checksum: the chunk checksums folded in order
+uint64_t fold_checksum(uint64_t file_sum, uint64_t chunk_sum)
+{
+    return (((file_sum << 29) | (file_sum >> 35)) ^ chunk_sum) * FNV_PRIME;
+}
+
+// Parse a byte count with an optional K, M or G suffix (powers of 1024); -1 if invalid
+long long parse_bytes(const char *text)
+{
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    if (*end == 'K' || *end == 'k')
+    {
+        value <<= 10;
+        end++;
+    }
+    else if (*end == 'M' || *end == 'm')
+    {
+        value <<= 20;
+        end++;
+    }
+    else if (*end == 'G' || *end == 'g')
+    {
+        value <<= 30;
+        end++;
+    }
+    return (*end == '\0' && end != text) ? value : -1;
+}
+
+// read/write that retry short transfers; 0 on success
+int read_full(int fd, unsigned char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t got = read(fd, buf, len);
+        if (got <= 0)
+        {
+            return 1;
+        }
+        buf += got;
+        len -= got;
+    }
+    return 0;
+}
+
+int write_full(int fd, const unsigned char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t put = write(fd, buf, len);
+        if (put <= 0)
+        {
+            return 1;
+        }
+        buf += put;
+        len -= put;
+    }
+    return 0;
+}
+
+// mkdir -p of the directory part of path
+void make_parent_dirs(const char *path)
+{
+    char dir[MAX_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash == NULL || slash == dir)
+    {
+        return;
+    }
+    *slash = '\0';
+    for (char *p = dir + 1; *p != '\0'; p++)
+    {
+        if (*p == '/')
+        {
+            *p = '\0';
+            mkdir(dir, 0755);
+            *p = '/';
+        }
+    }
+    mkdir(dir, 0755);
+}
+
+// Checksum of a written file, read back in the same chunks it was staged in
+uint64_t file_checksum(const char *path, long long size, int chunk, unsigned char *buf, int *failed)
+{
+    uint64_t file_sum = FNV_OFFSET;
+    int fd = open(path, O_RDONLY);
+    *failed = fd < 0;
+    for (long long offset = 0; !*failed && offset < size; offset += chunk)
+    {
+        int len = (size - offset < chunk) ? (int)(size - offset) : chunk;
+        *failed = read_full(fd, buf, len);
+        file_sum = fold_checksum(file_sum, checksum(buf, len));
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return file_sum;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun --map-by ppr:1:node ... %s [-c CHUNK] [-d DEPTH] [-V] <source> <dest>\n", prog);
+    fprintf(stderr, "  -c CHUNK  Bytes per broadcast chunk, K/M/G suffixes allowed (default: %dM)\n", DEFAULT_CHUNK >> 20);
+    fprintf(stderr, "  -d DEPTH  Chunks in flight at once (default: %d)\n", DEFAULT_DEPTH);
+    fprintf(stderr, "  -V        Re-read the written file on every node and compare checksums\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    struct topology topo;
+    topo_init(MPI_COMM_WORLD, &topo);
+
+    // --- Argument Handling (Rank 0 parses, opens the source and broadcasts the settings) ---
+    long long chunk = DEFAULT_CHUNK, file_size = 0;
+    int depth = DEFAULT_DEPTH, verify = 0, file_mode = 0644;
+    int args_ok = 1, src_fd = -1;
+    char paths[2][MAX_PATH_LEN]; // Source, destination
+    struct stat src_stat;
+    memset(paths, 0, sizeof(paths));
+    if (rank == 0)
+    {
+        int opt;
+        while (args_ok && (opt = getopt(argc, argv, "c:d:V")) != -1)
+        {
+            if (opt == 'c' && parse_bytes(optarg) > 0 && parse_bytes(optarg) <= (1LL << 30))
+            {
+                chunk = parse_bytes(optarg);
+            }
+            else if (opt == 'd' && atoi(optarg) > 0)
+            {
+                depth = atoi(optarg);
+            }
+            else if (opt == 'V')
+            {
+                verify = 1;
+            }
+            else
+            {
+                print_usage(argv[0]);
+                args_ok = 0;
+            }
+        }
+        if (args_ok && (argc - optind != 2 || strlen(argv[optind]) >= MAX_PATH_LEN ||
+                        strlen(argv[optind + 1]) >= MAX_PATH_LEN - 32))
+        {
+            print_usage(argv[0]);
+            args_ok = 0;
+        }
+        if (args_ok)
+        {
+            strcpy(paths[0], argv[optind]);
+            strcpy(paths[1], argv[optind + 1]);
+            src_fd = open(paths[0], O_RDONLY);
+            if (src_fd < 0 || fstat(src_fd, &src_stat) != 0 || !S_ISREG(src_stat.st_mode))
+            {
+                fprintf(stderr, "Error: Cannot read regular file '%s'.\n", paths[0]);
+                args_ok = 0;
+            }
+            else
+            {
+                file_size = src_stat.st_size;
+                file_mode = src_stat.st_mode & 07777;
+            }
+        }
+    }
+    long long settings[6] = {args_ok, file_size, chunk, depth, verify, file_mode};
+    MPI_Bcast(settings, 6, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (!settings[0])
+    {
+        topo_free(&topo);
+        MPI_Finalize();
+        return 1;
+    }
+    file_size = settings[1];
+    chunk = settings[2];
+    depth = (int)settings[3];
+    verify = (int)settings[4];
+    file_mode = (int)settings[5];
+    MPI_Bcast(paths, 2 * MAX_PATH_LEN, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    int status = STAGE_OK;
+    uint64_t file_sum = FNV_OFFSET;
+    double start_time = MPI_Wtime();
+    if (topo.is_leader)
+    {
+        // --- Destination: a temporary file next to it, renamed once complete ---
+        int write_here = 1;
+        struct stat dest_stat;
+        if (rank == 0 && stat(paths[1], &dest_stat) == 0 && dest_stat.st_dev == src_stat.st_dev &&
+            dest_stat.st_ino == src_stat.st_ino)
+        {
+            write_here = 0;
+            status = STAGE_SKIPPED;
+        }
+        char tmp_path[MAX_PATH_LEN];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.stage%d", paths[1], (int)getpid());
+        int dest_fd = -1;
+        if (write_here)
+        {
+            make_parent_dirs(paths[1]);
+            dest_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0700);
+            status = dest_fd < 0 ? STAGE_IO_ERROR : STAGE_OK;
+        }
+
+        // Each slot holds one chunk followed by its checksum
+        size_t slot_bytes = (size_t)chunk + sizeof(uint64_t);
+        unsigned char *slots = malloc(depth * slot_bytes);
+        MPI_Request *requests = malloc(depth * sizeof(MPI_Request));
+        if (slots == NULL || requests == NULL)
+        {
+            fprintf(stderr, "Error: Cannot allocate %d chunks of %lld bytes.\n", depth, chunk);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int s = 0; s < depth; s++)
+        {
+            requests[s] = MPI_REQUEST_NULL;
+        }
+
+        // --- Pipeline: post chunk i, then finish chunk i - depth + 1 ---
+        long long num_chunks = (file_size + chunk - 1) / chunk;
+        for (long long i = 0; i < num_chunks + depth - 1; i++)
+        {
+            if (i < num_chunks)
+            {
+                // Slot i % depth was last used by chunk i - depth, finished in the previous round
+                unsigned char *slot = slots + (i % depth) * slot_bytes;
+                int len = (file_size - i * chunk < chunk) ? (int)(file_size - i * chunk) : (int)chunk;
+                if (rank == 0)
+                {
+                    if (read_full(src_fd, slot, len) != 0)
+                    {
+                        fprintf(stderr, "Error: Reading '%s' failed at byte %lld.\n", paths[0], i * chunk);
+                        MPI_Abort(MPI_COMM_WORLD, 1);
+                    }
+                    uint64_t sum = checksum(slot, len);
+                    memcpy(slot + len, &sum, sizeof(sum));
+                }
+                MPI_Ibcast(slot, len + (int)sizeof(uint64_t), MPI_BYTE, 0, topo.leader_comm, &requests[i % depth]);
+                int done;
+                MPI_Testall(depth, requests, &done, MPI_STATUSES_IGNORE); // Drives the earlier chunks along
+            }
+
+            long long j = i - (depth - 1);
+            if (j >= 0 && j < num_chunks)
+            {
+                unsigned char *slot = slots + (j % depth) * slot_bytes;
+                int len = (file_size - j * chunk < chunk) ? (int)(file_size - j * chunk) : (int)chunk;
+                MPI_Wait(&requests[j % depth], MPI_STATUS_IGNORE);
+                uint64_t sum;
+                memcpy(&sum, slot + len, sizeof(sum));
+                file_sum = fold_checksum(file_sum, sum);
+                if (write_here && status == STAGE_OK)
+                {
+                    if (checksum(slot, len) != sum)
+                    {
+                        status = STAGE_CORRUPT;
+                    }
+                    else if (write_full(dest_fd, slot, len) != 0)
+                    {
+                        status = STAGE_IO_ERROR;
+                    }
+                }
+            }
+        }
+
+        // --- Install the file ---
+        if (write_here)
+        {
+            if (dest_fd >= 0 && (fsync(dest_fd) != 0 || fchmod(dest_fd, file_mode) != 0) && status == STAGE_OK)
+            {
+                status = STAGE_IO_ERROR;
+            }
+            if (dest_fd >= 0)
+            {
+                close(dest_fd);
+            }
+            if (status == STAGE_OK && rename(tmp_path, paths[1]) != 0)
+            {
+                status = STAGE_IO_ERROR;
+            }
+            if (status != STAGE_OK)
+            {
+                unlink(tmp_path);
+            }
+            int failed = 0;
+            if (status == STAGE_OK && verify &&
+                (file_checksum(paths[1], file_size, (int)chunk, slots, &failed) != file_sum || failed))
+            {
+                status = STAGE_VERIFY;
+            }
+        }
+        free(slots);
+        free(requests);
+    }
+    if (src_fd >= 0)
+    {
+        close(src_fd);
+    }
+
+    // --- Per-node report on rank 0 ---
+    double elapsed = MPI_Wtime() - start_time;
+    int failures = 0;
+    if (topo.is_leader)
+    {
+        char host[HOST_LEN];
+        memset(host, 0, sizeof(host));
+        gethostname(host, sizeof(host) - 1);
+        int *statuses = NULL;
+        char *hosts = NULL;
+        if (rank == 0)
+        {
+            statuses = malloc(topo.num_nodes * sizeof(int));
+            hosts = malloc((size_t)topo.num_nodes * HOST_LEN);
+        }
+        MPI_Gather(&status, 1, MPI_INT, statuses, 1, MPI_INT, 0, topo.leader_comm);
+        MPI_Gather(host, HOST_LEN, MPI_CHAR, hosts, HOST_LEN, MPI_CHAR, 0, topo.leader_comm);
+        MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, topo.leader_comm);
+        if (rank == 0)
+        {
+            int written = 0;
+            printf("Staged '%s' -> '%s': %lld bytes in %lld-byte chunks, %d in flight\n", paths[0], paths[1],
+                   file_size, chunk, depth);
+            printf("%6s  %-24s %s\n", "Node", "Host", "Status");
+            for (int n = 0; n < topo.num_nodes; n++)
+            {
+                printf("%6d  %-24s %s\n", n, hosts + (size_t)n * HOST_LEN, status_names[statuses[n]]);
+                failures += statuses[n] != STAGE_OK && statuses[n] != STAGE_SKIPPED;
+                written += statuses[n] == STAGE_OK;
+            }
+            printf("Checksum: %016llx%s\n", (unsigned long long)file_sum, verify ? " (written files re-read)" : "");
+            printf("Time: %.6f seconds, %.1f MB/s per node, %.1f MB/s delivered in total\n", elapsed,
+                   elapsed > 0.0 ? file_size / elapsed / 1e6 : 0.0,
+                   elapsed > 0.0 ? (double)file_size * written / elapsed / 1e6 : 0.0);
+            if (failures > 0)
+            {
+                fprintf(stderr, "Error: Staging failed on %d of %d nodes.\n", failures, topo.num_nodes);
+            }
+            free(statuses);
+            free(hosts);
+        }
+    }
+
+    topo_free(&topo);
+    MPI_Finalize();
+    return failures > 0 ? 1 : 0;
+}
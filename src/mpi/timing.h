@@ -0,0 +1,258 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+// Per-phase timing shared by the programs in this directory. A program brackets its phases with
+// named regions on every rank; at the end one collective call combines the per-rank times into
+// min / mean / max / imbalance per region and prints them on rank 0.
+//
+//   timing_init                     empty table
+//   timing_start / timing_stop      open / close a region by name; a region may be entered many
+//                                   times and its time accumulates
+//   timing_add                      charge time measured elsewhere to a region
+//   timing_get                      accumulated time of one region on this rank
+//   timing_report                   gather, combine and print (collective over comm)
+//
+// Regions are matched by name across ranks, so ranks may skip a region (it counts as 0 there)
+// or open them in a different order. A pseudo-region "total" is added to the report: the sum of
+// all regions of a rank, so regions should not overlap.
+// Imbalance is max / mean - 1: how much longer the slowest rank spent in the region than the
+// average rank (0 = perfectly balanced).
+//
+// The report goes to stdout as a table unless TIMING_FORMAT is "csv" or "json" (one JSON
+// object per line); if TIMING_OUTPUT names a file the report is appended there instead. Both
+// variables are read on rank 0 only, so launch with mpirun -x to set them on remote nodes.
+//
+// Header-only so that every program in this directory can include it and still build from a
+// single source file (see compile.sh).
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h> // For omp_get_max_threads
+#endif
+
+#define TIMING_MAX_REGIONS 16 // Regions per program
+#define TIMING_NAME_LEN 24    // Longest region name, including the terminator
+
+struct timing
+{
+    int num_regions;
+    char name[TIMING_MAX_REGIONS][TIMING_NAME_LEN];
+    double seconds[TIMING_MAX_REGIONS]; // Accumulated time of closed intervals
+    double started[TIMING_MAX_REGIONS]; // MPI_Wtime at timing_start, negative when closed
+    long calls[TIMING_MAX_REGIONS];
+};
+
+static inline void timing_init(struct timing *t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+// Index of a region, added if it is new; -1 if the table is full
+static inline int timing_region(struct timing *t, const char *name)
+{
+    for (int r = 0; r < t->num_regions; r++)
+    {
+        if (strncmp(t->name[r], name, TIMING_NAME_LEN - 1) == 0)
+        {
+            return r;
+        }
+    }
+    if (t->num_regions == TIMING_MAX_REGIONS)
+    {
+        return -1;
+    }
+    int r = t->num_regions++;
+    strncpy(t->name[r], name, TIMING_NAME_LEN - 1);
+    t->started[r] = -1.0;
+    return r;
+}
+
+static inline void timing_start(struct timing *t, const char *name)
+{
+    int r = timing_region(t, name);
+    if (r >= 0)
+    {
+        t->started[r] = MPI_Wtime();
+    }
+}
+
+// Close a region; returns the length of this interval (0 if the region was not open)
+static inline double timing_stop(struct timing *t, const char *name)
+{
+    int r = timing_region(t, name);
+    if (r < 0 || t->started[r] < 0.0)
+    {
+        return 0.0;
+    }
+    double interval = MPI_Wtime() - t->started[r];
+    t->seconds[r] += interval;
+    t->calls[r]++;
+    t->started[r] = -1.0;
+    return interval;
+}
+
+static inline void timing_add(struct timing *t, const char *name, double seconds)
+{
+    int r = timing_region(t, name);
+    if (r >= 0)
+    {
+        t->seconds[r] += seconds;
+        t->calls[r]++;
+    }
+}
+
+static inline double timing_get(const struct timing *t, const char *name)
+{
+    for (int r = 0; r < t->num_regions; r++)
+    {
+        if (strncmp(t->name[r], name, TIMING_NAME_LEN - 1) == 0)
+        {
+            return t->seconds[r];
+        }
+    }
+    return 0.0;
+}
+
+// Combine the regions of all ranks of comm and print them on rank 0. program and params (for
+// example "n=1000000") label the output; they must not contain commas or quotes.
+static inline void timing_report(const struct timing *t, const char *program, const char *params, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // --- Union of the region names, in order of first appearance (rank 0's order first) ---
+    char (*all_names)[TIMING_NAME_LEN] = NULL;
+    char names[TIMING_MAX_REGIONS + 1][TIMING_NAME_LEN];
+    int num_names = 0;
+    memset(names, 0, sizeof(names));
+    if (rank == 0)
+    {
+        all_names = calloc((size_t)size * TIMING_MAX_REGIONS, TIMING_NAME_LEN);
+    }
+    MPI_Gather(t->name, TIMING_MAX_REGIONS * TIMING_NAME_LEN, MPI_CHAR, all_names,
+               TIMING_MAX_REGIONS * TIMING_NAME_LEN, MPI_CHAR, 0, comm);
+    if (rank == 0)
+    {
+        for (int i = 0; i < size * TIMING_MAX_REGIONS; i++)
+        {
+            int known = all_names[i][0] == '\0';
+            for (int u = 0; u < num_names && !known; u++)
+            {
+                known = strcmp(names[u], all_names[i]) == 0;
+            }
+            if (!known && num_names < TIMING_MAX_REGIONS)
+            {
+                memcpy(names[num_names++], all_names[i], TIMING_NAME_LEN);
+            }
+        }
+        free(all_names);
+    }
+    MPI_Bcast(&num_names, 1, MPI_INT, 0, comm);
+    MPI_Bcast(names, num_names * TIMING_NAME_LEN, MPI_CHAR, 0, comm);
+    strcpy(names[num_names], "total");
+
+    // --- This rank's times in union order (0 for regions it never entered), then the total ---
+    int n = num_names + 1;
+    double mine[TIMING_MAX_REGIONS + 1], min[TIMING_MAX_REGIONS + 1], max[TIMING_MAX_REGIONS + 1];
+    double sum[TIMING_MAX_REGIONS + 1];
+    long my_calls[TIMING_MAX_REGIONS + 1], calls[TIMING_MAX_REGIONS + 1];
+    mine[num_names] = 0.0;
+    my_calls[num_names] = 1;
+    for (int u = 0; u < num_names; u++)
+    {
+        mine[u] = 0.0;
+        my_calls[u] = 0;
+        for (int r = 0; r < t->num_regions; r++)
+        {
+            if (strcmp(t->name[r], names[u]) == 0)
+            {
+                mine[u] = t->seconds[r];
+                my_calls[u] = t->calls[r];
+            }
+        }
+        mine[num_names] += mine[u];
+    }
+    MPI_Reduce(mine, min, n, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(mine, max, n, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(mine, sum, n, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(my_calls, calls, n, MPI_LONG, MPI_MAX, 0, comm);
+    if (rank != 0)
+    {
+        return;
+    }
+
+    // --- Rank 0 prints in the requested format ---
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    const char *format = getenv("TIMING_FORMAT");
+    const char *path = getenv("TIMING_OUTPUT");
+    int csv = format != NULL && strcmp(format, "csv") == 0;
+    int json = format != NULL && strcmp(format, "json") == 0;
+    FILE *out = stdout;
+    if (path != NULL && path[0] != '\0')
+    {
+        out = fopen(path, "a");
+        if (out == NULL)
+        {
+            fprintf(stderr, "Warning: Cannot open timing output '%s', using stdout.\n", path);
+            out = stdout;
+        }
+    }
+    int fresh = out == stdout || (fseek(out, 0, SEEK_END) == 0 && ftell(out) == 0); // CSV header once per file
+
+    if (csv && fresh)
+    {
+        fprintf(out, "program,procs,threads,params,region,calls,min_s,mean_s,max_s,imbalance\n");
+    }
+    else if (json)
+    {
+        fprintf(out, "{\"program\":\"%s\",\"procs\":%d,\"threads\":%d,\"params\":\"%s\",\"regions\":[", program,
+                size, threads, params);
+    }
+    else if (!csv)
+    {
+        fprintf(out, "\nPhase timing of %s (%s) over %d processes x %d threads, seconds:\n", program, params, size,
+                threads);
+        fprintf(out, "%-16s %8s %12s %12s %12s %10s\n", "Region", "Calls", "Min", "Mean", "Max", "Imbalance");
+    }
+    for (int u = 0; u < n; u++)
+    {
+        double mean = sum[u] / size;
+        double imbalance = mean > 0.0 ? max[u] / mean - 1.0 : 0.0;
+        if (csv)
+        {
+            fprintf(out, "%s,%d,%d,%s,%s,%ld,%.9f,%.9f,%.9f,%.4f\n", program, size, threads, params, names[u],
+                    calls[u], min[u], mean, max[u], imbalance);
+        }
+        else if (json)
+        {
+            fprintf(out, "%s{\"name\":\"%s\",\"calls\":%ld,\"min\":%.9f,\"mean\":%.9f,\"max\":%.9f,\"imbalance\":%.4f}",
+                    u > 0 ? "," : "", names[u], calls[u], min[u], mean, max[u], imbalance);
+        }
+        else
+        {
+            fprintf(out, "%-16s %8ld %12.6f %12.6f %12.6f %9.1f%%\n", names[u], calls[u], min[u], mean, max[u],
+                    100.0 * imbalance);
+        }
+    }
+    if (json)
+    {
+        fprintf(out, "]}\n");
+    }
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    else
+    {
+        fflush(out);
+    }
+}
+
+#endif // TIMING_H
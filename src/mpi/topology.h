@@ -0,0 +1,230 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+// Node-aware view of a communicator: which ranks share a node (and so can share memory), one
+// leader per node, and collectives that keep as much traffic as possible inside a node.
+//
+//   topo_init / topo_free      build / release the node and leader communicators
+//   topo_print_map             rank-to-host table on the communicator's rank 0
+//   topo_reduce, topo_bcast    hierarchical MPI_Reduce / MPI_Bcast: node-local step plus one
+//                              inter-node step among the leaders only
+//   topo_alloc_shared          one buffer per node (MPI_Win_allocate_shared) that every rank of
+//                              the node reads directly
+//   topo_bcast_shared          fill such a buffer on every node from the root's copy
+//
+// Header-only so that every program in this directory can include it and still build from a
+// single source file (see compile.sh).
+//
+// Testing on one machine: TOPO_FAKE_NODES=k (exported to every rank) splits each real node into k
+// groups by rank % k that are then treated as separate nodes, so the leader steps run too. The
+// groups stay inside a real node, so the shared-memory windows remain valid.
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOPO_TAG 32001 // Root <-> node leader hand-offs (next to COLL_TAG in collectives.h)
+
+struct topology
+{
+    MPI_Comm node_comm;   // Ranks on this node, in the parent communicator's order
+    MPI_Comm leader_comm; // Node leaders (node rank 0) only; MPI_COMM_NULL elsewhere
+    int node_rank, node_size;
+    int node_id, num_nodes; // Node index = the leader's rank in leader_comm
+    int is_leader;
+    int *node_of;      // Node index of every rank of the parent communicator
+    int *node_rank_of; // Rank within its node of every rank of the parent communicator
+};
+
+// Split comm by shared-memory domain and build the leader communicator. Collective over comm.
+static inline void topo_init(MPI_Comm comm, struct topology *topo)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &topo->node_comm);
+    const char *fake = getenv("TOPO_FAKE_NODES");
+    int fake_nodes = fake != NULL ? atoi(fake) : 0;
+    if (fake_nodes > 1)
+    {
+        MPI_Comm real_node = topo->node_comm;
+        MPI_Comm_split(real_node, rank % fake_nodes, rank, &topo->node_comm);
+        MPI_Comm_free(&real_node);
+    }
+    MPI_Comm_rank(topo->node_comm, &topo->node_rank);
+    MPI_Comm_size(topo->node_comm, &topo->node_size);
+    topo->is_leader = topo->node_rank == 0;
+    MPI_Comm_split(comm, topo->is_leader ? 0 : MPI_UNDEFINED, rank, &topo->leader_comm);
+
+    int node_info[2] = {0, 0};
+    if (topo->is_leader)
+    {
+        MPI_Comm_rank(topo->leader_comm, &node_info[0]);
+        MPI_Comm_size(topo->leader_comm, &node_info[1]);
+    }
+    MPI_Bcast(node_info, 2, MPI_INT, 0, topo->node_comm);
+    topo->node_id = node_info[0];
+    topo->num_nodes = node_info[1];
+
+    // Every rank keeps the full map so the collectives below need no extra messages to find a root
+    int mine[2] = {topo->node_id, topo->node_rank};
+    int *all = malloc(2 * size * sizeof(int));
+    topo->node_of = malloc(size * sizeof(int));
+    topo->node_rank_of = malloc(size * sizeof(int));
+    MPI_Allgather(mine, 2, MPI_INT, all, 2, MPI_INT, comm);
+    for (int r = 0; r < size; r++)
+    {
+        topo->node_of[r] = all[2 * r];
+        topo->node_rank_of[r] = all[2 * r + 1];
+    }
+    free(all);
+}
+
+static inline void topo_free(struct topology *topo)
+{
+    if (topo->leader_comm != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&topo->leader_comm);
+    }
+    MPI_Comm_free(&topo->node_comm);
+    free(topo->node_of);
+    free(topo->node_rank_of);
+}
+
+// Print which host every rank runs on (rank 0 of comm prints). Collective over comm.
+static inline void topo_print_map(const struct topology *topo, MPI_Comm comm)
+{
+    int rank, size, len;
+    char host[MPI_MAX_PROCESSOR_NAME];
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    memset(host, 0, sizeof(host));
+    MPI_Get_processor_name(host, &len);
+
+    char *hosts = NULL;
+    if (rank == 0)
+    {
+        hosts = malloc((size_t)size * MPI_MAX_PROCESSOR_NAME);
+    }
+    MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, comm);
+    if (rank == 0)
+    {
+        printf("Rank-to-host map (%d processes on %d nodes):\n", size, topo->num_nodes);
+        printf("%6s  %-24s %6s %12s\n", "Rank", "Host", "Node", "Node rank");
+        for (int r = 0; r < size; r++)
+        {
+            printf("%6d  %-24s %6d %12d%s\n", r, hosts + (size_t)r * MPI_MAX_PROCESSOR_NAME, topo->node_of[r],
+                   topo->node_rank_of[r], topo->node_rank_of[r] == 0 ? "  (leader)" : "");
+        }
+        free(hosts);
+    }
+}
+
+// Hierarchical MPI_Reduce: reduce inside every node onto its leader, reduce the per-node results
+// among the leaders onto the leader of root's node, hand the result to root if it is not that
+// leader. Only one message per node crosses the network. Non-commutative operations go to
+// MPI_Reduce, because the ranks of one node need not be consecutive in comm.
+static inline int topo_reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                              int root, const struct topology *topo, MPI_Comm comm)
+{
+    int rank, commutative;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Op_commutative(op, &commutative);
+    if (!commutative)
+    {
+        return MPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    }
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(type, &lb, &extent);
+    int root_node = topo->node_of[root];
+    int root_is_leader = topo->node_rank_of[root] == 0;
+    const void *src = (sendbuf == MPI_IN_PLACE) ? recvbuf : sendbuf; // MPI_IN_PLACE is only valid on root
+
+    // Leaders accumulate into recvbuf when they are root, into a scratch buffer otherwise
+    void *part = NULL;
+    if (topo->is_leader)
+    {
+        part = (rank == root) ? recvbuf : malloc((size_t)count * extent);
+    }
+    MPI_Reduce(topo->is_leader && src == part ? MPI_IN_PLACE : src, part, count, type, op, 0, topo->node_comm);
+
+    if (topo->is_leader && topo->num_nodes > 1)
+    {
+        int leader_root = topo->node_id == root_node;
+        MPI_Reduce(leader_root ? MPI_IN_PLACE : part, part, count, type, op, root_node, topo->leader_comm);
+    }
+    if (!root_is_leader && topo->node_id == root_node)
+    {
+        if (topo->is_leader)
+        {
+            MPI_Send(part, count, type, topo->node_rank_of[root], TOPO_TAG, topo->node_comm);
+        }
+        else if (rank == root)
+        {
+            MPI_Recv(recvbuf, count, type, 0, TOPO_TAG, topo->node_comm, MPI_STATUS_IGNORE);
+        }
+    }
+    if (topo->is_leader && part != recvbuf)
+    {
+        free(part);
+    }
+    return MPI_SUCCESS;
+}
+
+// Hierarchical MPI_Bcast: root hands the data to its node leader, the leaders broadcast among
+// themselves, then every leader broadcasts inside its node.
+static inline int topo_bcast(void *buf, int count, MPI_Datatype type, int root, const struct topology *topo,
+                             MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int root_node = topo->node_of[root];
+    if (topo->node_rank_of[root] != 0 && topo->node_id == root_node)
+    {
+        if (rank == root)
+        {
+            MPI_Send(buf, count, type, 0, TOPO_TAG, topo->node_comm);
+        }
+        else if (topo->is_leader)
+        {
+            MPI_Recv(buf, count, type, topo->node_rank_of[root], TOPO_TAG, topo->node_comm, MPI_STATUS_IGNORE);
+        }
+    }
+    if (topo->is_leader && topo->num_nodes > 1)
+    {
+        MPI_Bcast(buf, count, type, root_node, topo->leader_comm);
+    }
+    return MPI_Bcast(buf, count, type, 0, topo->node_comm);
+}
+
+// Allocate `bytes` once per node in a shared-memory window; every rank of the node gets a
+// pointer to the same memory. Release with MPI_Win_free(win). Collective over the node. Returns
+// NULL if the memory could not be allocated.
+static inline void *topo_alloc_shared(MPI_Aint bytes, const struct topology *topo, MPI_Win *win)
+{
+    void *base = NULL;
+    MPI_Aint segment_size;
+    int disp_unit;
+    MPI_Win_allocate_shared(topo->is_leader ? bytes : 0, 1, MPI_INFO_NULL, topo->node_comm, &base, win);
+    MPI_Win_shared_query(*win, 0, &segment_size, &disp_unit, &base);
+    return segment_size >= bytes ? base : NULL;
+}
+
+// Make the root's copy of a node-shared buffer (from topo_alloc_shared) visible on every node.
+// Root writes the data into its node's buffer before the call; afterwards every rank of every
+// node may read it. Only the leaders receive anything, one message per node.
+static inline int topo_bcast_shared(void *ptr, int count, MPI_Datatype type, int root,
+                                    const struct topology *topo, MPI_Win win)
+{
+    MPI_Win_fence(0, win); // Root's stores are complete before its leader sends them
+    if (topo->is_leader && topo->num_nodes > 1)
+    {
+        MPI_Bcast(ptr, count, type, topo->node_of[root], topo->leader_comm);
+    }
+    MPI_Win_fence(0, win); // Leaders' received data is visible to the rest of the node
+    return MPI_SUCCESS;
+}
+
+#endif // TOPOLOGY_H
@@ -1,153 +1,745 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h> // For atoll, exit
-#include <math.h>   // For the function f(x)
+#include <string.h> // For strcmp
+#include <stddef.h> // For offsetof
+#include <unistd.h> // For getopt
+#include <math.h>   // For the integrands
+#include <float.h>  // For DBL_EPSILON
+#include "timing.h"  // Per-phase timing report
+#include "balance.h" // Calibrated shares for the balanced schedule
+#include "topology.h" // Node-aware final reduction
 
-// Function to integrate
-double f(double x)
+// Work distribution modes, selected by the schedule argument
+enum schedule
 {
-    // Example: Integrate x^2
-    return x * x;
-    // Example: Integrate sin(x)
-    // return sin(x);
+    SCHED_STATIC = 1,   // n panels split evenly up front (original behaviour)
+    SCHED_ADAPTIVE = 2, // n chunks refined by error estimate, handed out on demand by rank 0
+    SCHED_BALANCED = 3  // n panels split up front in proportion to each rank's calibrated speed
+};
+
+const char *schedule_names[] = {NULL, "static", "adaptive", "balanced"};
+
+#define DEFAULT_TOLERANCE 1e-10 // Absolute error target for the whole integral (adaptive mode)
+#define MAX_DEPTH 20            // Deepest bisection allowed inside one chunk (reported when hit)
+#define TAG_REQUEST 1           // Worker -> master: ready for more work
+#define TAG_WORK 2              // Master -> worker: {first chunk, chunk count}; count 0 means stop
+#define MAX_LINE_LEN 256        // Longest job line accepted in batch mode
+#define MAX_NAME_LEN 32         // Longest integrand / rule name in batch mode
+#define MAX_NODES 5             // Most evaluation points per panel of any rule
+#define PROBE_PANELS 16384      // First probe run of the balanced schedule
+
+// Parameters of one integration. Everything a rank needs travels in one broadcast of this
+// struct (see create_job_type) instead of one broadcast per field.
+struct job
+{
+    long long n;   // Panels (static) or chunks (adaptive); 0 ends a batch, < 0 is an error
+    double a, b;   // Integration limits
+    double tol;    // Error target of the adaptive schedule
+    int schedule;  // SCHED_STATIC, SCHED_ADAPTIVE or SCHED_BALANCED
+    int rule;      // Index into the rules table
+    int integrand; // Index into the integrands table
+    int id;        // Job number within a batch, from 1
+};
+
+// --- Quadrature rules ---
+// A rule integrates panel [x_i, x_i + h] as h * sum_k w[k] * f(x_i + t[k] * h).
+// Rules whose points include both panel ends (trapezoid, Simpson) only evaluate the left end of
+// each panel; the sum then holds f(a) in full and lacks f(b), which end_weight * (f(b) - f(a))
+// corrects once at the end, so no point is evaluated twice.
+struct rule
+{
+    const char *name;
+    int order;     // Error falls as h^order
+    int num_nodes; // Evaluations per panel
+    double t[MAX_NODES];
+    double w[MAX_NODES];
+    double end_weight;
+};
+
+// Gauss-Legendre nodes xi and weights omega on [-1, 1] are stored as t = (1 + xi) / 2, w = omega / 2
+const struct rule rules[] = {
+    {"trapezoid", 2, 1, {0.0}, {1.0}, 0.5},
+    {"midpoint", 2, 1, {0.5}, {1.0}, 0.0},
+    {"simpson", 4, 2, {0.0, 0.5}, {1.0 / 3.0, 2.0 / 3.0}, 1.0 / 6.0},
+    {"gauss2", 4, 2, {0.2113248654051871, 0.7886751345948129}, {0.5, 0.5}, 0.0},
+    {"gauss3", 6, 3,
+     {0.1127016653792583, 0.5, 0.8872983346207417},
+     {0.2777777777777778, 0.4444444444444444, 0.2777777777777778}, 0.0},
+    {"gauss4", 8, 4,
+     {0.0694318442029737, 0.3300094782075719, 0.6699905217924281, 0.9305681557970263},
+     {0.1739274225687269, 0.3260725774312731, 0.3260725774312731, 0.1739274225687269}, 0.0},
+    {"gauss5", 10, 5,
+     {0.0469100770306680, 0.2307653449471585, 0.5, 0.7692346550528415, 0.9530899229693320},
+     {0.1184634425280945, 0.2393143352496832, 0.2844444444444444, 0.2393143352496832, 0.1184634425280945}, 0.0},
+};
+const int num_rules = sizeof(rules) / sizeof(rules[0]);
+#define DEFAULT_RULE 0 // trapezoid
+
+// --- Integrands ---
+// DEFINE_INTEGRAND(name, f(x), F(x)) instantiates the kernels of one integrand with the
+// expression written inline: the sum over a range of panels for one rule point (vectorized with
+// omp simd) and the adaptive refinement. The registry below is only consulted once per range or
+// chunk, never once per evaluation.
+#define DEFINE_INTEGRAND(NAME, EXPR, ANTI)                                                           \
+    static inline double NAME##_f(double x)                                                          \
+    {                                                                                                \
+        return (EXPR);                                                                               \
+    }                                                                                                \
+    static double NAME##_antiderivative(double x)                                                    \
+    {                                                                                                \
+        return (ANTI);                                                                               \
+    }                                                                                                \
+    /* Sum of f(a + (i + t) * h) for i in [first, first + count) */                                  \
+    static double NAME##_node_sum(double a, double h, double t, long long first, long long count)   \
+    {                                                                                                \
+        double sum = 0.0;                                                                            \
+        _Pragma("omp simd reduction(+ : sum)") for (long long i = first; i < first + count; i++)     \
+        {                                                                                            \
+            double x = a + ((double)i + t) * h;                                                      \
+            sum += (EXPR);                                                                           \
+        }                                                                                            \
+        return sum;                                                                                  \
+    }                                                                                                \
+    /* Adaptive trapezoid on [a, b] given f at both ends and the midpoint and the one-panel */       \
+    /* estimate; see integrate_chunk */                                                              \
+    static double NAME##_adaptive(double a, double b, double fa, double fm, double fb, double whole, \
+                                  double tol, int depth, long long *evals, long long *capped)        \
+    {                                                                                                \
+        double m = 0.5 * (a + b);                                                                    \
+        double left = 0.5 * (m - a) * (fa + fm); /* Each half with its own rounded width, as */      \
+        double right = 0.5 * (b - m) * (fm + fb); /* the child will recompute it */                 \
+        double refined = left + right;                                                               \
+        double lm = 0.5 * (a + m), rm = 0.5 * (m + b);                                               \
+        /* The tolerance cannot go below the rounding of the estimate: of the values (|whole| */     \
+        /* alone is no scale where f changes sign) and of the abscissas, which moves the */          \
+        /* midpoint by an ulp of x. Halves that cannot be split again in double are done. */         \
+        double floor = 4.0 * DBL_EPSILON *                                                           \
+                       (fmax(fabs(whole), fabs(left) + fabs(right)) +                                \
+                        (fabs(a) + fabs(b)) * (fabs(fm - fa) + fabs(fb - fm)));                      \
+        int converged = fabs(refined - whole) <= 3.0 * fmax(tol, floor);                             \
+        int unresolvable = !(a < lm && lm < m && m < rm && rm < b);                                  \
+        if (converged || unresolvable || depth >= MAX_DEPTH)                                         \
+        {                                                                                            \
+            *capped += !converged && !unresolvable;                                                  \
+            return refined + (refined - whole) / 3.0; /* Richardson-extrapolated */                  \
+        }                                                                                            \
+        double flm = NAME##_f(lm);                                                                   \
+        double frm = NAME##_f(rm);                                                                   \
+        *evals += 2;                                                                                 \
+        return NAME##_adaptive(a, m, fa, flm, fm, left, 0.5 * tol, depth + 1, evals, capped) +       \
+               NAME##_adaptive(m, b, fm, frm, fb, right, 0.5 * tol, depth + 1, evals, capped);       \
+    }
+
+DEFINE_INTEGRAND(square, x * x, x * x * x / 3.0)                                            // The original example
+DEFINE_INTEGRAND(sin, sin(x), -cos(x))                                                      // Smooth, periodic
+DEFINE_INTEGRAND(exp, exp(x), exp(x))                                                       // Smooth, growing
+DEFINE_INTEGRAND(pi, 4.0 / (1.0 + x * x), 4.0 * atan(x))                                    // Integral from 0 to 1 is pi
+DEFINE_INTEGRAND(osc, x * sin(50.0 * x), (sin(50.0 * x) - 50.0 * x * cos(50.0 * x)) / 2500.0) // Oscillatory
+DEFINE_INTEGRAND(bell, exp(-x * x), 0.8862269254527580 * erf(x))                            // Gaussian, sqrt(pi)/2 * erf
+DEFINE_INTEGRAND(sqrt, sqrt(x), 2.0 / 3.0 * x * sqrt(x))                                    // Infinite slope at 0
+
+// Integrands chosen at runtime by name, each with an antiderivative for the error report
+struct integrand
+{
+    const char *name;
+    double (*f)(double);
+    double (*antiderivative)(double);
+    double (*node_sum)(double, double, double, long long, long long);
+    double (*adaptive)(double, double, double, double, double, double, double, int, long long *, long long *);
+};
+
+#define INTEGRAND_ENTRY(NAME) {#NAME, NAME##_f, NAME##_antiderivative, NAME##_node_sum, NAME##_adaptive}
+
+const struct integrand integrands[] = {
+    INTEGRAND_ENTRY(square),
+    INTEGRAND_ENTRY(sin),
+    INTEGRAND_ENTRY(exp),
+    INTEGRAND_ENTRY(pi),
+    INTEGRAND_ENTRY(osc),
+    INTEGRAND_ENTRY(bell),
+    INTEGRAND_ENTRY(sqrt),
+};
+const int num_integrands = sizeof(integrands) / sizeof(integrands[0]);
+
+// Index of an integrand or rule by name, -1 if there is none
+int find_integrand(const char *name)
+{
+    for (int k = 0; k < num_integrands; k++)
+    {
+        if (strcmp(name, integrands[k].name) == 0)
+        {
+            return k;
+        }
+    }
+    return -1;
 }
 
-// Function to compute the local sum for the trapezoid rule
-// Note: This computes sum(f(x_i)) for i = local_first_i to local_last_i - 1
-double compute_local_sum(double local_a, double h, int local_n)
+int find_rule(const char *name)
 {
+    for (int k = 0; k < num_rules; k++)
+    {
+        if (strcmp(name, rules[k].name) == 0)
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+// Rule sum over panels [first, first + count) of a job (without the factor h and end correction)
+double rule_sum(const struct job *job, long long first, long long count)
+{
+    const struct integrand *in = &integrands[job->integrand];
+    const struct rule *r = &rules[job->rule];
+    double h = (job->b - job->a) / (double)job->n;
     double sum = 0.0;
-    double x;
-    int i;
+    for (int k = 0; k < r->num_nodes; k++)
+    {
+        sum += r->w[k] * in->node_sum(job->a, h, r->t[k], first, count);
+    }
+    return sum;
+}
+
+// Complete the rule: scale the sum over all panels by h and add the end correction
+double finish_rule(const struct job *job, double global_sum)
+{
+    const struct integrand *in = &integrands[job->integrand];
+    double h = (job->b - job->a) / (double)job->n;
+    return h * (global_sum + rules[job->rule].end_weight * (in->f(job->b) - in->f(job->a)));
+}
 
-    for (i = 0; i < local_n; i++)
+// Integrate chunk [ca, cb] adaptively to an absolute tolerance of tol.
+// The chunk is bisected until the two-panel estimate agrees with the one-panel estimate to
+// within the tolerance; the difference / 3 is the Richardson error estimate of the finer result.
+// Refinement also stops where the tolerance is below the rounding of the estimate or the
+// interval cannot be split any more in double; intervals that still miss the tolerance at
+// MAX_DEPTH are counted in capped.
+double integrate_chunk(const struct integrand *in, double ca, double cb, double tol, long long *evals,
+                       long long *capped)
+{
+    double fa = in->f(ca), fb = in->f(cb), fm = in->f(0.5 * (ca + cb));
+    *evals += 3;
+    return in->adaptive(ca, cb, fa, fm, fb, 0.5 * (cb - ca) * (fa + fb), tol, 0, evals, capped);
+}
+
+// Master loop (rank 0): hand out chunks until they run out, then tell every worker to stop.
+// Grants shrink as the queue drains (guided scheduling) so the last pieces are small.
+// Returns the time spent waiting for requests.
+double run_master(long long num_chunks, int num_workers, MPI_Comm comm)
+{
+    long long next_chunk = 0;
+    int active = num_workers;
+    double idle = 0.0;
+    MPI_Status status;
+
+    while (active > 0)
     {
-        x = local_a + i * h; // Calculate x for the current local point
-        sum += f(x);
+        int dummy;
+        double t0 = MPI_Wtime();
+        MPI_Recv(&dummy, 1, MPI_INT, MPI_ANY_SOURCE, TAG_REQUEST, comm, &status);
+        idle += MPI_Wtime() - t0;
+
+        long long grant[2] = {next_chunk, 0};
+        long long remaining = num_chunks - next_chunk;
+        if (remaining > 0)
+        {
+            grant[1] = remaining / (2LL * num_workers);
+            if (grant[1] < 1)
+            {
+                grant[1] = 1;
+            }
+            next_chunk += grant[1];
+        }
+        else
+        {
+            active--;
+        }
+        MPI_Send(grant, 2, MPI_LONG_LONG, status.MPI_SOURCE, TAG_WORK, comm);
+    }
+    return idle;
+}
+
+// Worker loop: request chunks from rank 0 and integrate them until told to stop.
+// Returns this worker's partial integral; idle is the time spent waiting for grants.
+double run_worker(const struct job *job, MPI_Comm comm, long long *chunks_done, long long *evals,
+                  long long *capped, double *idle)
+{
+    const struct integrand *in = &integrands[job->integrand];
+    double chunk_width = (job->b - job->a) / (double)job->n;
+    double chunk_tol = job->tol / (double)job->n; // Errors of the chunks add up
+    double sum = 0.0;
+    int dummy = 0;
+
+    for (;;)
+    {
+        long long grant[2];
+        double t0 = MPI_Wtime();
+        MPI_Send(&dummy, 1, MPI_INT, 0, TAG_REQUEST, comm);
+        MPI_Recv(grant, 2, MPI_LONG_LONG, 0, TAG_WORK, comm, MPI_STATUS_IGNORE);
+        *idle += MPI_Wtime() - t0;
+        if (grant[1] == 0)
+        {
+            break;
+        }
+
+        for (long long c = grant[0]; c < grant[0] + grant[1]; c++)
+        {
+            double ca = job->a + c * chunk_width;
+            double cb = (c == job->n - 1) ? job->b : ca + chunk_width;
+            sum += integrate_chunk(in, ca, cb, chunk_tol, evals, capped);
+        }
+        *chunks_done += grant[1];
     }
     return sum;
 }
 
+// Describe struct job to MPI so it can be broadcast in one call
+MPI_Datatype create_job_type(void)
+{
+    int lengths[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+    MPI_Aint displs[8] = {offsetof(struct job, n), offsetof(struct job, a), offsetof(struct job, b),
+                          offsetof(struct job, tol), offsetof(struct job, schedule), offsetof(struct job, rule),
+                          offsetof(struct job, integrand), offsetof(struct job, id)};
+    MPI_Datatype types[8] = {MPI_LONG_LONG, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE,
+                             MPI_INT, MPI_INT, MPI_INT, MPI_INT};
+    MPI_Datatype tmp, job_type;
+    MPI_Type_create_struct(8, lengths, displs, types, &tmp);
+    MPI_Type_create_resized(tmp, 0, sizeof(struct job), &job_type); // Account for trailing padding
+    MPI_Type_commit(&job_type);
+    MPI_Type_free(&tmp);
+    return job_type;
+}
+
+// Start and count of this rank's share of n panels, as evenly as possible.
+// All counts are 64-bit so n beyond 2^31 does not overflow.
+void local_range(long long n, int rank, int size, long long *first, long long *count)
+{
+    long long base = n / size;
+    long long remainder = n % size;
+    *count = base + (rank < remainder ? 1 : 0);
+    *first = rank * base + (rank < remainder ? rank : remainder);
+}
+
+// This rank's part of the rule sum of a static job (without the factor h)
+double job_local_sum(const struct job *job, int rank, int size)
+{
+    long long first, count;
+    local_range(job->n, rank, size, &first, &count);
+    return rule_sum(job, first, count);
+}
+
+// Calibration probe of the balanced schedule: the rule sum of the job over `units` panels
+void probe_rule_sum(long long units, void *ctx)
+{
+    volatile double sink = rule_sum((const struct job *)ctx, 0, units);
+    (void)sink;
+}
+
+// Read the next job line from fp into job. Returns 1 for a job, 0 at end of input.
+// Lines look like "<integrand> <a> <b> <n> <rule>"; blank lines and # comments are skipped.
+int read_job(FILE *fp, struct job *job, int *line_number)
+{
+    char line[MAX_LINE_LEN];
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        (*line_number)++;
+        char name[MAX_NAME_LEN], rule[MAX_NAME_LEN];
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0')
+        {
+            continue;
+        }
+        if (sscanf(start, "%31s %lf %lf %lld %31s", name, &job->a, &job->b, &job->n, rule) != 5 || job->n <= 0)
+        {
+            fprintf(stderr, "Warning: Skipping malformed job on line %d.\n", *line_number);
+            continue;
+        }
+        job->integrand = find_integrand(name);
+        job->rule = find_rule(rule);
+        if (job->integrand < 0 || job->rule < 0)
+        {
+            fprintf(stderr, "Warning: Skipping job on line %d (unknown integrand or rule).\n", *line_number);
+            continue;
+        }
+        job->schedule = SCHED_STATIC;
+        job->tol = 0.0;
+        return 1;
+    }
+    return 0;
+}
+
+// Batch mode: the ranks stay up and work through a stream of jobs read by rank 0.
+// Two job slots are used so the broadcast of job k+1 and the reduction of job k are in flight
+// together (MPI_Ibcast + MPI_Ireduce) while job k is computed. Returns 0 on every rank if the
+// job file could be opened, 1 on every rank otherwise.
+int run_batch(const char *path, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Datatype job_type = create_job_type();
+
+    FILE *fp = NULL;
+    int line_number = 0;
+    int num_jobs = 0;
+    struct job jobs[2];
+    memset(jobs, 0, sizeof(jobs));
+    if (rank == 0)
+    {
+        fp = (path == NULL || strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Error: Cannot open job file '%s'.\n", path);
+        }
+    }
+    int open_failed = rank == 0 && fp == NULL;
+    MPI_Bcast(&open_failed, 1, MPI_INT, 0, comm);
+    if (open_failed)
+    {
+        MPI_Type_free(&job_type);
+        return 1;
+    }
+    if (rank == 0)
+    {
+        if (read_job(fp, &jobs[0], &line_number))
+        {
+            jobs[0].id = ++num_jobs;
+        }
+        printf("%5s %-8s %12s %12s %14s %-9s %22s %12s %10s\n",
+               "Job", "f", "a", "b", "n", "Rule", "Integral", "Error", "Time (s)");
+    }
+
+    double batch_start = MPI_Wtime();
+    MPI_Bcast(&jobs[0], 1, job_type, 0, comm);
+
+    int cur = 0;
+    while (jobs[cur].n > 0)
+    {
+        double job_start = MPI_Wtime();
+        int nxt = 1 - cur;
+        MPI_Request requests[2];
+
+        // Job k+1 goes out while job k is computed and reduced
+        if (rank == 0)
+        {
+            memset(&jobs[nxt], 0, sizeof(struct job));
+            if (read_job(fp, &jobs[nxt], &line_number))
+            {
+                jobs[nxt].id = ++num_jobs;
+            }
+        }
+        MPI_Ibcast(&jobs[nxt], 1, job_type, 0, comm, &requests[0]);
+
+        double local_sum = job_local_sum(&jobs[cur], rank, size);
+        double global_sum = 0.0;
+        MPI_Ireduce(&local_sum, &global_sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm, &requests[1]);
+        MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+
+        if (rank == 0)
+        {
+            const struct job *job = &jobs[cur];
+            const struct integrand *in = &integrands[job->integrand];
+            double integral = finish_rule(job, global_sum);
+            double exact = in->antiderivative(job->b) - in->antiderivative(job->a);
+            printf("%5d %-8s %12.5g %12.5g %14lld %-9s %22.15f %12.3e %10.6f\n",
+                   job->id, in->name, job->a, job->b, job->n, rules[job->rule].name,
+                   integral, fabs(integral - exact), MPI_Wtime() - job_start);
+        }
+        cur = nxt;
+    }
+
+    double batch_time = MPI_Wtime() - batch_start;
+    if (rank == 0)
+    {
+        if (fp != NULL && fp != stdin)
+        {
+            fclose(fp);
+        }
+        printf("--------------------------------------------------\n");
+        printf("Processes:      %d\n", size);
+        printf("Jobs completed: %d\n", num_jobs);
+        printf("Batch time:     %.6f seconds\n", batch_time);
+        printf("Throughput:     %.1f jobs/second\n", batch_time > 0.0 ? num_jobs / batch_time : 0.0);
+    }
+    MPI_Type_free(&job_type);
+    return 0;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-f integrand] [-r rule] [-a a] [-b b] <num_panels|num_chunks> [static|adaptive|balanced] [tolerance]\n", prog);
+    fprintf(stderr, "       mpirun ... %s batch [job_file|-]\n", prog);
+    fprintf(stderr, "  Integrands:");
+    for (int k = 0; k < num_integrands; k++)
+    {
+        fprintf(stderr, " %s", integrands[k].name);
+    }
+    fprintf(stderr, " (default %s)\n  Rules:     ", integrands[0].name);
+    for (int k = 0; k < num_rules; k++)
+    {
+        fprintf(stderr, " %s", rules[k].name);
+    }
+    fprintf(stderr, " (default %s, static and balanced schedules only)\n", rules[DEFAULT_RULE].name);
+}
+
 int main(int argc, char *argv[])
 {
     int my_rank, num_procs;
-    long long n;             // Total number of trapezoids (using long long)
-    double a = 0.0, b = 1.0; // Integration limits [a, b]
-    double h;                // Trapezoid width
-    double local_a;          // Starting point for this process
-    int local_n;             // Number of trapezoids for this process
-    double local_sum;        // Sum of f(x_i) calculated by this process
-    double global_sum;       // Total sum obtained after reduction
-    double integral;         // Final integral estimate
-    int i;
+    struct job job = {0, 0.0, 1.0, DEFAULT_TOLERANCE, SCHED_STATIC, DEFAULT_RULE, 0, 0};
+    double local_sum;  // Part of the rule sum (static) or of the integral (adaptive) on this process
+    double global_sum; // Total sum obtained after reduction
+    double integral;   // Final integral estimate
     double start_time, end_time, elapsed_time;
 
     MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
-    // --- Argument Handling (Rank 0 reads and broadcasts n) ---
+    // --- Batch mode: many jobs, one launch ---
+    if (argc >= 2 && strcmp(argv[1], "batch") == 0)
+    {
+        int status = run_batch(argc > 2 ? argv[2] : NULL, MPI_COMM_WORLD);
+        MPI_Finalize();
+        return status;
+    }
+
+    // --- Argument Handling (Rank 0 reads and broadcasts the job) ---
     if (my_rank == 0)
     {
-        if (argc != 2)
+        int opt, bad_option = 0;
+        while ((opt = getopt(argc, argv, "f:r:a:b:")) != -1)
+        {
+            if (opt == 'f' && (job.integrand = find_integrand(optarg)) < 0)
+            {
+                fprintf(stderr, "Error: Unknown integrand '%s'.\n", optarg);
+                bad_option = 1;
+            }
+            else if (opt == 'r' && (job.rule = find_rule(optarg)) < 0)
+            {
+                fprintf(stderr, "Error: Unknown rule '%s'.\n", optarg);
+                bad_option = 1;
+            }
+            else if (opt == 'a')
+            {
+                job.a = atof(optarg);
+            }
+            else if (opt == 'b')
+            {
+                job.b = atof(optarg);
+            }
+            else if (opt == '?')
+            {
+                bad_option = 1;
+            }
+        }
+
+        int num_args = argc - optind;
+        if (bad_option || num_args < 1 || num_args > 3)
         {
-            fprintf(stderr, "Usage: mpirun ... %s <num_trapezoids>\n", argv[0]);
-            n = -1; // Signal error
+            print_usage(argv[0]);
+            job.n = -1; // Signal error
         }
         else
         {
-            n = atoll(argv[1]); // Use atoll for long long
-            if (n <= 0)
+            job.n = atoll(argv[optind]); // Use atoll for long long
+            if (job.n <= 0)
+            {
+                fprintf(stderr, "Error: Number of panels must be positive.\n");
+                job.n = -1; // Signal error
+            }
+            if (num_args > 1 && strcmp(argv[optind + 1], "adaptive") == 0)
+            {
+                job.schedule = SCHED_ADAPTIVE;
+            }
+            else if (num_args > 1 && strcmp(argv[optind + 1], "balanced") == 0)
+            {
+                job.schedule = SCHED_BALANCED;
+            }
+            else if (num_args > 1 && strcmp(argv[optind + 1], "static") != 0)
             {
-                fprintf(stderr, "Error: Number of trapezoids must be positive.\n");
-                n = -1; // Signal error
+                fprintf(stderr, "Error: Unknown schedule '%s' (use static, adaptive or balanced).\n", argv[optind + 1]);
+                job.n = -1; // Signal error
+            }
+            if (num_args > 2)
+            {
+                job.tol = atof(argv[optind + 2]);
+                if (job.tol <= 0.0)
+                {
+                    fprintf(stderr, "Error: Tolerance must be positive.\n");
+                    job.n = -1; // Signal error
+                }
             }
         }
-        // Broadcast a and b as well, in case they were changed
-        // We could broadcast n, a, b in one go using a struct or array if needed.
     }
 
-    // Broadcast n, a, b from rank 0 to all processes
-    MPI_Bcast(&n, 1, MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&a, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&b, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    // Broadcast n, a, b, the integrand, rule and schedule settings from rank 0 in one go
+    MPI_Datatype job_type = create_job_type();
+    MPI_Bcast(&job, 1, job_type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&job_type);
 
     // Check if input was valid after broadcast
-    if (n <= 0)
+    if (job.n <= 0)
     {
         MPI_Finalize();
         return 1;
     }
+    const struct integrand *in = &integrands[job.integrand];
+    const struct rule *rule = &rules[job.rule];
 
-    // --- Calculation Setup ---
-    h = (b - a) / (double)n; // Width of each trapezoid
+    // --- Timing and Calculation ---
+    struct timing tm;
+    timing_init(&tm);
 
-    // Calculate the number of trapezoids and starting point for this process
-    // This method distributes the intervals as evenly as possible
-    int base_local_n = n / num_procs;
-    int remainder = n % num_procs;
-    if (my_rank < remainder)
+    // Balanced schedule: measure every rank's speed on this job's rule sum (or use the cached one)
+    long long *starts = malloc((num_procs + 1) * sizeof(long long));
+    if (job.schedule == SCHED_BALANCED)
     {
-        local_n = base_local_n + 1;
-        local_a = a + my_rank * local_n * h; // Note: This formula for local_a might be slightly off due to varying local_n
+        double *weights = malloc(num_procs * sizeof(double));
+        char key[BALANCE_KEY_LEN / 2];
+        snprintf(key, sizeof(key), "trapezoid:f=%s:rule=%s", in->name, rule->name);
+        timing_start(&tm, "calibrate");
+        int nodes_probed = balance_weights(key, probe_rule_sum, &job, PROBE_PANELS, weights, MPI_COMM_WORLD);
+        timing_stop(&tm, "calibrate");
+        balance_print(weights, nodes_probed, MPI_COMM_WORLD);
+        balance_split(job.n, weights, num_procs, starts);
+        free(weights);
     }
-    else
-    {
-        local_n = base_local_n;
-        local_a = a + (remainder * (base_local_n + 1) + (my_rank - remainder) * base_local_n) * h; // More precise start
-    }
-
-    // A simpler, common way to calculate local range (might have slight load imbalance if n % num_procs != 0):
-    // local_n = n / num_procs;
-    // if (my_rank == num_procs - 1) {
-    //     // Last process might take a few more trapezoids
-    //     local_n = n - my_rank * (n / num_procs);
-    // }
-    // local_a = a + my_rank * (n / num_procs) * h;
-
-    // --- Timing and Calculation ---
+    struct topology topo; // Which ranks share a node, for the final reduction
+    topo_init(MPI_COMM_WORLD, &topo);
     MPI_Barrier(MPI_COMM_WORLD); // Synchronize before timing
     start_time = MPI_Wtime();
 
-    // Each process computes its part of the sum
-    // IMPORTANT: The formula h * [ f(x_0)/2 + f(x_1) + ... + f(x_{n-1}) + f(x_n)/2 ]
-    // We are summing f(x_i) where x_i is the *left* endpoint of trapezoid i
-    // The first point x_0 = a, last point x_n = b
-    // Each process sums f(x_i) for its range of i, starting from its local_a
-    local_sum = 0.0;
-    for (i = 0; i < local_n; i++)
+    long long chunks_done = 0; // Work done by this process (chunks or panels)
+    long long evals = 0;       // Function evaluations by this process
+    long long capped = 0;      // Adaptive intervals that hit MAX_DEPTH before the tolerance
+    double idle = 0.0;         // Time this process spent waiting instead of computing
+
+    if (job.schedule != SCHED_ADAPTIVE)
+    {
+        // Each process computes the rule sum over its share of the panels
+        long long first;
+        local_range(job.n, my_rank, num_procs, &first, &chunks_done);
+        if (job.schedule == SCHED_BALANCED)
+        {
+            first = starts[my_rank];
+            chunks_done = starts[my_rank + 1] - first;
+        }
+        local_sum = rule_sum(&job, first, chunks_done);
+        evals = chunks_done * rule->num_nodes;
+    }
+    else if (num_procs == 1)
     {
-        local_sum += f(local_a + i * h);
+        // No one to hand work to: integrate every chunk here
+        double chunk_width = (job.b - job.a) / (double)job.n;
+        local_sum = 0.0;
+        for (long long c = 0; c < job.n; c++)
+        {
+            double ca = job.a + c * chunk_width;
+            double cb = (c == job.n - 1) ? job.b : ca + chunk_width;
+            local_sum += integrate_chunk(in, ca, cb, job.tol / (double)job.n, &evals, &capped);
+        }
+        chunks_done = job.n;
+    }
+    else if (my_rank == 0)
+    {
+        // Rank 0 is a dedicated master with the work queue
+        local_sum = 0.0;
+        idle = run_master(job.n, num_procs - 1, MPI_COMM_WORLD);
+    }
+    else
+    {
+        local_sum = run_worker(&job, MPI_COMM_WORLD, &chunks_done, &evals, &capped, &idle);
     }
 
-    // Reduce all local sums into global_sum on rank 0
-    MPI_Reduce(&local_sum, &global_sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    // Time each process waits for the slowest one is idle time too
+    double t0 = MPI_Wtime();
+    MPI_Barrier(MPI_COMM_WORLD);
+    idle += MPI_Wtime() - t0;
+    timing_add(&tm, "compute", MPI_Wtime() - start_time - idle);
+    timing_add(&tm, "idle", idle);
+
+    // Reduce all local sums into global_sum on rank 0, one message per node across the network
+    timing_start(&tm, "reduce");
+    topo_reduce(&local_sum, &global_sum, 1, MPI_DOUBLE, MPI_SUM, 0, &topo, MPI_COMM_WORLD);
+    timing_stop(&tm, "reduce");
 
     end_time = MPI_Wtime();
     elapsed_time = end_time - start_time;
+    double max_elapsed; // The run is only done when the slowest process is done
+    MPI_Reduce(&elapsed_time, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // --- Per-process load report ---
+    double stats[2] = {elapsed_time - idle, idle};
+    long long counts[3] = {chunks_done, evals, capped};
+    double *all_stats = NULL;
+    long long *all_counts = NULL;
+    if (my_rank == 0)
+    {
+        all_stats = malloc(2 * num_procs * sizeof(double));
+        all_counts = malloc(3 * num_procs * sizeof(long long));
+    }
+    MPI_Gather(stats, 2, MPI_DOUBLE, all_stats, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gather(counts, 3, MPI_LONG_LONG, all_counts, 3, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
 
     // --- Final Calculation and Output (Rank 0 only) ---
     if (my_rank == 0)
     {
-        // Complete the trapezoid rule formula
-        integral = h * (global_sum + (f(a) - f(b)) / 2.0); // Adjust sum for endpoints
+        integral = (job.schedule != SCHED_ADAPTIVE) ? finish_rule(&job, global_sum) : global_sum;
+        double exact = in->antiderivative(job.b) - in->antiderivative(job.a);
+        long long total_evals = 0, total_capped = 0;
+        for (int r = 0; r < num_procs; r++)
+        {
+            total_evals += all_counts[3 * r + 1];
+            total_capped += all_counts[3 * r + 2];
+        }
 
-        // Note: The exact analytic integral of x^2 from 0 to 1 is 1/3
         printf("Number of Processes:  %d\n", num_procs);
-        printf("Integration Limits:   [%.4f, %.4f]\n", a, b);
-        printf("Number of Trapezoids: %lld\n", n);
-        printf("Trapezoid Width (h):  %.10f\n", h);
-        printf("Calculated Integral:  %.10f\n", integral);
-        printf("Elapsed Time:         %.6f seconds\n", elapsed_time);
+        printf("Integrand:            %s\n", in->name);
+        printf("Integration Limits:   [%.4f, %.4f]\n", job.a, job.b);
+        if (job.schedule != SCHED_ADAPTIVE)
+        {
+            printf("Schedule:             %s\n", schedule_names[job.schedule]);
+            printf("Rule:                 %s (order %d, %d evaluations per panel)\n",
+                   rule->name, rule->order, rule->num_nodes);
+            printf("Number of Panels:     %lld\n", job.n);
+            printf("Panel Width (h):      %.10f\n", (job.b - job.a) / (double)job.n);
+        }
+        else
+        {
+            printf("Schedule:             adaptive (%s)\n", num_procs > 1 ? "rank 0 is master" : "single process");
+            printf("Number of Chunks:     %lld\n", job.n);
+            printf("Tolerance:            %.3e\n", job.tol);
+            if (total_capped > 0)
+            {
+                printf("Depth Cap Reached:    %lld intervals still above tolerance at depth %d\n", total_capped,
+                       MAX_DEPTH);
+            }
+        }
+        printf("Function Evaluations: %lld\n", total_evals);
+        printf("Calculated Integral:  %.15f\n", integral);
+        printf("Analytic Integral:    %.15f\n", exact);
+        printf("Error:                %.10e\n", fabs(integral - exact));
+        printf("Elapsed Time:         %.6f seconds (slowest process)\n", max_elapsed);
 
-        // If integrating x^2 from 0 to 1:
-        if (a == 0.0 && b == 1.0)
+        printf("\n%6s %14s %14s %12s %12s\n", "Rank", job.schedule != SCHED_ADAPTIVE ? "Panels" : "Chunks",
+               "Evaluations", "Busy (s)", "Idle (s)");
+        for (int r = 0; r < num_procs; r++)
         {
-            printf("Analytic Integral:    %.10f\n", 1.0 / 3.0);
-            printf("Error:                %.10e\n", fabs(integral - 1.0 / 3.0));
+            printf("%6d %14lld %14lld %12.6f %12.6f\n", r, all_counts[3 * r], all_counts[3 * r + 1],
+                   all_stats[2 * r], all_stats[2 * r + 1]);
         }
+        free(all_stats);
+        free(all_counts);
     }
 
+    char params[128];
+    snprintf(params, sizeof(params), "n=%lld f=%s rule=%s schedule=%s", job.n, in->name, rule->name,
+             schedule_names[job.schedule]);
+    timing_report(&tm, "trapezoid", params, MPI_COMM_WORLD);
+    free(starts);
+    topo_free(&topo);
+
     MPI_Finalize();
     return 0;
-}
\ No newline at end of file
+}
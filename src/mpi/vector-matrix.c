@@ -1,15 +1,92 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h> // For srand
+#include <string.h> // For strcmp, memcpy
+#include <unistd.h> // For getopt
+#include <math.h>   // For fabs
+#include <stdint.h> // For int64_t in the matrix file header
+#include <limits.h> // For INT_MAX
+#ifdef _OPENMP
+#include <omp.h> // For omp_get_max_threads
+#endif
+#include "topology.h" // Node-shared copy of x
+#include "timing.h"   // Per-phase timing report
+#include "balance.h"  // Calibrated row shares (-b)
 
-// Define matrix dimensions (make N divisible by number of processes for this simple example)
-// If N is not divisible, the root handles the remainder, making the logic slightly more complex.
-// Let's assume N is large enough and potentially divisible for simplicity.
-#define N 8 // Dimension of the square matrix and vector
+// Default dimension of the square matrix and vector if none is given on the command line.
+// The real size is read from the command line at runtime, so N can go well past what fits on the stack.
+#define DEFAULT_N 8
+#define ALIGNMENT 64            // Cache-line alignment for every heap buffer
+#define PRINT_LIMIT 16          // Only print the result vector when it is this small
+#define X_BLOCK 2048            // Doubles of x per cache block in the local kernel (16 KiB)
+#define ROW_UNROLL 4            // Rows computed together in the local kernel (must match its accumulators)
+#define MAX_PATH_LEN 4096       // Longest matrix file path accepted on the command line
+#define PROBE_DOUBLES (1 << 22) // Matrix elements in the calibration probe of -b (32 MiB, past most caches)
+#define REF_DOUBLES (1 << 20)   // Elements of A held in double at once for the fp64 reference (8 MiB)
+#define TAG_ROWS 1              // Root -> worker: one chunk of rows of A (pipelined mode)
+#define TAG_RESULT 2            // Worker -> root: the results of one chunk (pipelined mode)
 
-// Function to print a matrix (optional, for debugging)
-void print_matrix(double mat[N][N], int rows, int cols)
+// Binary matrix file format used by -f and -w:
+//   int64 rows, int64 cols (native byte order), then rows*cols doubles in row-major order.
+#define FILE_HEADER_BYTES (2 * sizeof(int64_t))
+
+// Data decompositions that can be selected with -d
+enum decomposition
+{
+    DECOMP_1D = 1, // Row blocks, x broadcast to everyone, results gathered on the root
+    DECOMP_2D = 2  // Blocks on a process grid, x sliced per grid column, row-wise reduce-scatter
+};
+
+// Where the matrix comes from, selected with -i / -f
+enum input_mode
+{
+    INPUT_ROOT = 1, // Root fills the whole matrix and distributes it
+    INPUT_GEN = 2,  // Every rank generates only its own block from the global indices
+    INPUT_FILE = 3  // Every rank reads only its own block from a binary file with MPI-IO
+};
+
+// Storage format of A, selected with -t (1d only). x and b stay double everywhere; only the
+// matrix, which is nearly all of the memory traffic, shrinks.
+enum precision
+{
+    PREC_FP64 = 1,     // double A, double sums (the reference)
+    PREC_FP32 = 2,     // float A, float copy of x, float sums: half the bytes of A
+    PREC_FP32_ACC = 3, // float A, double x and sums: half the bytes, only A is rounded
+    PREC_BF16 = 4      // bfloat16 A (upper half of a float), float x and sums: a quarter of the bytes
+};
+
+const char *precision_names[] = {NULL, "fp64", "fp32", "fp32acc", "bf16"};
+const size_t precision_bytes[] = {0, sizeof(double), sizeof(float), sizeof(float), sizeof(uint16_t)};
+
+// Extent of the block of A owned by one rank
+struct block
+{
+    int row_start, rows; // Global rows [row_start, row_start + rows)
+    int col_start, cols; // Global columns [col_start, col_start + cols)
+};
+
+// Allocate a contiguous, cache-line aligned array of count elements of size bytes (NULL on failure)
+void *alloc_elements(size_t count, size_t size)
+{
+    void *ptr = NULL;
+    if (count == 0)
+    {
+        count = 1; // Keep a valid pointer even for ranks that own no rows
+    }
+    if (posix_memalign(&ptr, ALIGNMENT, count * size) != 0)
+    {
+        return NULL;
+    }
+    return ptr;
+}
+
+double *alloc_doubles(size_t count)
+{
+    return alloc_elements(count, sizeof(double));
+}
+
+// Function to print a matrix stored row-major in a flat buffer (optional, for debugging)
+void print_matrix(const double *mat, int rows, int cols)
 {
     printf("Matrix:\n");
     for (int i = 0; i < rows; i++)
@@ -17,14 +94,14 @@ void print_matrix(double mat[N][N], int rows, int cols)
         printf("  [");
         for (int j = 0; j < cols; j++)
         {
-            printf("%6.2f%s", mat[i][j], (j == cols - 1) ? "" : ", ");
+            printf("%6.2f%s", mat[(size_t)i * cols + j], (j == cols - 1) ? "" : ", ");
         }
         printf("]\n");
     }
 }
 
 // Function to print a vector (optional, for debugging)
-void print_vector(double vec[], int size)
+void print_vector(const double *vec, int size)
 {
     printf("Vector: [");
     for (int i = 0; i < size; i++)
@@ -34,181 +111,1449 @@ void print_vector(double vec[], int size)
     printf("]\n");
 }
 
-int main(int argc, char *argv[])
+// Split n items as evenly as possible over parts: the first (n % parts) parts get one extra item.
+// Used for the row blocks of the 1D mode and for both grid dimensions of the 2D mode.
+void compute_block_distribution(int n, int parts, int *counts, int *displs)
+{
+    int per_part = n / parts;
+    int remainder = n % parts;
+    int offset = 0;
+    for (int p = 0; p < parts; p++)
+    {
+        counts[p] = per_part + (p < remainder ? 1 : 0);
+        displs[p] = offset;
+        offset += counts[p];
+    }
+}
+
+// Start and length of part `index` when n items are split with compute_block_distribution
+void block_range(int n, int parts, int index, int *start, int *count)
+{
+    int per_part = n / parts;
+    int remainder = n % parts;
+    *count = per_part + (index < remainder ? 1 : 0);
+    *start = index * per_part + (index < remainder ? index : remainder);
+}
+
+// Block of A owned by rank under the given decomposition. This mirrors the layouts that
+// multiply_1d (size x 1) and multiply_2d (MPI_Dims_create grid, row-major ranks) use,
+// so a rank can create or read its data in place without asking the root. (With -b the 1D row
+// blocks are not even; main then takes the rows from the calibrated table instead.)
+void local_block(int n, int decomp, int rank, int size, struct block *blk)
+{
+    int dims[2] = {size, 1};
+    if (decomp == DECOMP_2D)
+    {
+        dims[0] = dims[1] = 0;
+        MPI_Dims_create(size, 2, dims);
+    }
+    block_range(n, dims[0], rank / dims[1], &blk->row_start, &blk->rows);
+    block_range(n, dims[1], rank % dims[1], &blk->col_start, &blk->cols);
+}
+
+// Deterministic test data: A[i][j] = i*N + j + 1 and x[j] = j + 1, so b has a closed form
+double matrix_entry(int n, int i, int j)
+{
+    return (double)((size_t)i * n + j + 1);
+}
+
+double vector_entry(int j)
+{
+    return (double)(j + 1);
+}
+
+// bfloat16 is the upper 16 bits of an IEEE float: same range, 8 bits of significand
+static inline float bf16_to_float(uint16_t value)
+{
+    uint32_t bits = (uint32_t)value << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest, ties to even (no NaNs occur in this program's data)
+static inline uint16_t float_to_bf16(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+// Store count doubles at dst in the storage format of precision
+void convert_elements(int precision, const double *src, void *dst, size_t count)
+{
+    if (precision == PREC_FP64)
+    {
+        memcpy(dst, src, count * sizeof(double));
+    }
+    else if (precision == PREC_BF16)
+    {
+        uint16_t *out = dst;
+        for (size_t k = 0; k < count; k++)
+        {
+            out[k] = float_to_bf16((float)src[k]);
+        }
+    }
+    else
+    {
+        float *out = dst;
+        for (size_t k = 0; k < count; k++)
+        {
+            out[k] = (float)src[k];
+        }
+    }
+}
+
+// Fill a rank's block of A, stored in the format of precision, from the global indices. Each
+// thread writes the rows it will later multiply, so the pages are first touched on the right
+// NUMA node. Reduced formats go through a short double buffer on the stack of the thread.
+void generate_block(int n, const struct block *blk, int precision, void *A)
+{
+    size_t elem = precision_bytes[precision];
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < blk->rows; i++)
+    {
+        char *row = (char *)A + (size_t)i * blk->cols * elem;
+        if (precision == PREC_FP64)
+        {
+            for (int j = 0; j < blk->cols; j++)
+            {
+                ((double *)row)[j] = matrix_entry(n, blk->row_start + i, blk->col_start + j);
+            }
+            continue;
+        }
+        double values[X_BLOCK];
+        for (int jb = 0; jb < blk->cols; jb += X_BLOCK)
+        {
+            int len = (blk->cols - jb < X_BLOCK) ? blk->cols - jb : X_BLOCK;
+            for (int j = 0; j < len; j++)
+            {
+                values[j] = matrix_entry(n, blk->row_start + i, blk->col_start + jb + j);
+            }
+            convert_elements(precision, values, row + (size_t)jb * elem, len);
+        }
+    }
+}
+
+// Hints for collective buffering; implementations ignore the ones they do not know
+MPI_Info make_io_hints(void)
+{
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "romio_cb_read", "enable");
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    MPI_Info_set(info, "cb_buffer_size", "16777216");
+    return info;
+}
+
+// Set a file view that exposes exactly this rank's block of the matrix, and return the memory
+// datatype (one block row) to transfer it with. Empty blocks get a plain view and a zero count.
+void set_block_view(MPI_File fh, int n, const struct block *blk, MPI_Info info,
+                    MPI_Datatype *filetype, MPI_Datatype *memtype, int *count)
+{
+    if (blk->rows == 0 || blk->cols == 0)
+    {
+        *filetype = MPI_DATATYPE_NULL;
+        *memtype = MPI_DATATYPE_NULL;
+        *count = 0;
+        MPI_File_set_view(fh, FILE_HEADER_BYTES, MPI_DOUBLE, MPI_DOUBLE, "native", info);
+        return;
+    }
+    int sizes[2] = {n, n};
+    int subsizes[2] = {blk->rows, blk->cols};
+    int starts[2] = {blk->row_start, blk->col_start};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, filetype);
+    MPI_Type_commit(filetype);
+    MPI_Type_contiguous(blk->cols, MPI_DOUBLE, memtype);
+    MPI_Type_commit(memtype);
+    *count = blk->rows;
+    MPI_File_set_view(fh, FILE_HEADER_BYTES, MPI_DOUBLE, *filetype, "native", info);
+}
+
+void free_block_types(MPI_Datatype *filetype, MPI_Datatype *memtype)
+{
+    if (*filetype != MPI_DATATYPE_NULL)
+    {
+        MPI_Type_free(filetype);
+        MPI_Type_free(memtype);
+    }
+}
+
+// Read the dimension of a square matrix file on every rank. Returns 0 on success.
+int read_matrix_header(const char *path, int *n, MPI_Comm comm)
+{
+    MPI_File fh;
+    int64_t header[2] = {0, 0};
+    if (MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        return 1;
+    }
+    int rc = MPI_File_read_at_all(fh, 0, header, 2, MPI_INT64_T, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    if (rc != MPI_SUCCESS || header[0] <= 0 || header[0] != header[1] || header[0] > INT_MAX)
+    {
+        return 1;
+    }
+    *n = (int)header[0];
+    return 0;
+}
+
+// Every rank reads only its own block of A with one collective call. Returns 0 on success.
+int read_matrix_block(const char *path, int n, const struct block *blk, double *A, MPI_Comm comm)
+{
+    MPI_File fh;
+    MPI_Info info = make_io_hints();
+    int rc = MPI_File_open(comm, path, MPI_MODE_RDONLY, info, &fh);
+    if (rc == MPI_SUCCESS)
+    {
+        MPI_Datatype filetype, memtype;
+        int count;
+        set_block_view(fh, n, blk, info, &filetype, &memtype, &count);
+        rc = MPI_File_read_at_all(fh, 0, A, count, count > 0 ? memtype : MPI_DOUBLE, MPI_STATUS_IGNORE);
+        free_block_types(&filetype, &memtype);
+        MPI_File_close(&fh);
+    }
+    MPI_Info_free(&info);
+    return rc == MPI_SUCCESS ? 0 : 1;
+}
+
+// Every rank writes its own block of A with one collective call; root writes the header.
+// Returns 0 on success.
+int write_matrix_block(const char *path, int n, const struct block *blk, const double *A, MPI_Comm comm)
+{
+    MPI_File fh;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Info info = make_io_hints();
+    int rc = MPI_File_open(comm, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, info, &fh);
+    if (rc == MPI_SUCCESS)
+    {
+        // Drop anything left over from a larger matrix previously stored under the same name
+        MPI_File_set_size(fh, (MPI_Offset)FILE_HEADER_BYTES + (MPI_Offset)n * n * (MPI_Offset)sizeof(double));
+        if (rank == 0)
+        {
+            int64_t header[2] = {n, n};
+            rc = MPI_File_write_at(fh, 0, header, 2, MPI_INT64_T, MPI_STATUS_IGNORE);
+        }
+        MPI_Datatype filetype, memtype;
+        int count;
+        set_block_view(fh, n, blk, info, &filetype, &memtype, &count);
+        int rc_data = MPI_File_write_at_all(fh, 0, A, count, count > 0 ? memtype : MPI_DOUBLE, MPI_STATUS_IGNORE);
+        if (rc == MPI_SUCCESS)
+        {
+            rc = rc_data;
+        }
+        free_block_types(&filetype, &memtype);
+        MPI_File_close(&fh);
+    }
+    MPI_Info_free(&info);
+    return rc == MPI_SUCCESS ? 0 : 1;
+}
+
+// Local kernel: y[0..rows) = A[0..rows)[0..cols) * x, with A row-major and lda elements between rows.
+// x is walked in blocks of X_BLOCK so each block stays in L1/L2 while every row uses it, and
+// ROW_UNROLL rows are processed together with independent register accumulators that the
+// compiler vectorizes (omp simd). Rows are split statically across the OpenMP threads of the rank;
+// the same schedule is used for every x block, so each thread always updates the same rows of y.
+//
+// DEFINE_GEMV(NAME, ELEM, XELEM, ACC, LOAD) instantiates the kernel for one storage format of A:
+// A holds ELEM, x holds XELEM, every element of A is widened with LOAD and the sums run in ACC.
+// Each format gets its own function, specialized and vectorized by the compiler, so the inner
+// loop never branches on the format; y is double for all of them.
+#define LOAD_PLAIN(value) (value)
+
+#define DEFINE_GEMV(NAME, ELEM, XELEM, ACC, LOAD)                                                       \
+    void NAME(int rows, int cols, const ELEM *A, size_t lda, const XELEM *x, double *y)                 \
+    {                                                                                                   \
+        _Pragma("omp parallel")                                                                         \
+        {                                                                                               \
+            int groups = (rows + ROW_UNROLL - 1) / ROW_UNROLL;                                          \
+            /* Zero y in the same row groups and schedule as the products below, so each */             \
+            /* row is first touched by the thread that later updates it */                              \
+            _Pragma("omp for schedule(static)") for (int g = 0; g < groups; g++)                        \
+            {                                                                                           \
+                int iend = (g + 1) * ROW_UNROLL < rows ? (g + 1) * ROW_UNROLL : rows;                   \
+                for (int i = g * ROW_UNROLL; i < iend; i++)                                             \
+                {                                                                                       \
+                    y[i] = 0.0;                                                                         \
+                }                                                                                       \
+            }                                                                                           \
+                                                                                                        \
+            for (int jb = 0; jb < cols; jb += X_BLOCK)                                                  \
+            {                                                                                           \
+                int jend = (jb + X_BLOCK < cols) ? jb + X_BLOCK : cols;                                 \
+                const XELEM *xb = x + jb;                                                               \
+                int len = jend - jb;                                                                    \
+                                                                                                        \
+                _Pragma("omp for schedule(static) nowait") for (int g = 0; g < groups; g++)             \
+                {                                                                                       \
+                    int i = g * ROW_UNROLL;                                                             \
+                    if (i + ROW_UNROLL <= rows)                                                         \
+                    {                                                                                   \
+                        const ELEM *a0 = &A[(size_t)i * lda + jb];                                      \
+                        const ELEM *a1 = a0 + lda;                                                      \
+                        const ELEM *a2 = a1 + lda;                                                      \
+                        const ELEM *a3 = a2 + lda;                                                      \
+                        ACC s0 = 0, s1 = 0, s2 = 0, s3 = 0;                                             \
+                        _Pragma("omp simd reduction(+ : s0, s1, s2, s3)") for (int j = 0; j < len; j++) \
+                        {                                                                               \
+                            ACC xj = xb[j];                                                             \
+                            s0 += (ACC)LOAD(a0[j]) * xj;                                                \
+                            s1 += (ACC)LOAD(a1[j]) * xj;                                                \
+                            s2 += (ACC)LOAD(a2[j]) * xj;                                                \
+                            s3 += (ACC)LOAD(a3[j]) * xj;                                                \
+                        }                                                                               \
+                        y[i] += s0;                                                                     \
+                        y[i + 1] += s1;                                                                 \
+                        y[i + 2] += s2;                                                                 \
+                        y[i + 3] += s3;                                                                 \
+                    }                                                                                   \
+                    else                                                                                \
+                    {                                                                                   \
+                        /* Leftover rows when rows is not a multiple of ROW_UNROLL */                   \
+                        for (; i < rows; i++)                                                           \
+                        {                                                                               \
+                            const ELEM *a = &A[(size_t)i * lda + jb];                                   \
+                            ACC s = 0;                                                                  \
+                            _Pragma("omp simd reduction(+ : s)") for (int j = 0; j < len; j++)          \
+                            {                                                                           \
+                                s += (ACC)LOAD(a[j]) * (ACC)xb[j];                                      \
+                            }                                                                           \
+                            y[i] += s;                                                                  \
+                        }                                                                               \
+                    }                                                                                   \
+                }                                                                                       \
+            }                                                                                           \
+        }                                                                                               \
+    }
+
+DEFINE_GEMV(local_gemv, double, double, double, LOAD_PLAIN)
+DEFINE_GEMV(local_gemv_fp32, float, float, float, LOAD_PLAIN)
+DEFINE_GEMV(local_gemv_fp32_acc, float, double, double, LOAD_PLAIN)
+DEFINE_GEMV(local_gemv_bf16, uint16_t, float, float, bf16_to_float)
+
+// Local kernel for A stored in the format of precision. x is the double vector; x_single is its
+// float copy, needed by the formats that multiply in float (fp32, bf16).
+void local_gemv_typed(int precision, int rows, int cols, const void *A, size_t lda, const double *x,
+                      const float *x_single, double *y)
+{
+    switch (precision)
+    {
+    case PREC_FP32:
+        local_gemv_fp32(rows, cols, A, lda, x_single, y);
+        break;
+    case PREC_FP32_ACC:
+        local_gemv_fp32_acc(rows, cols, A, lda, x, y);
+        break;
+    case PREC_BF16:
+        local_gemv_bf16(rows, cols, A, lda, x_single, y);
+        break;
+    default:
+        local_gemv(rows, cols, A, lda, x, y);
+        break;
+    }
+}
+
+// A in a reduced format, with generated or file input: build this rank's rows in double
+// chunk_rows at a time (in rows_fp64), multiply them by x in double for the fp64 reference y, and
+// convert them into the storage format A. Only one chunk is ever held in double. Collective over
+// comm (the file reads are). Returns 0 on success.
+int build_reduced_block(int n, const struct block *blk, int precision, const char *read_path, const double *x,
+                        double *rows_fp64, int chunk_rows, void *A, double *y, MPI_Comm comm)
+{
+    // File reads are collective, so every rank takes as many steps as the rank with the most rows
+    int steps = blk->rows > 0 ? (blk->rows + chunk_rows - 1) / chunk_rows : 0, max_steps;
+    MPI_Allreduce(&steps, &max_steps, 1, MPI_INT, MPI_MAX, comm);
+    int status = 0;
+    for (int s = 0; s < max_steps; s++)
+    {
+        int first = s < steps ? s * chunk_rows : blk->rows;
+        struct block part = *blk;
+        part.row_start = blk->row_start + first;
+        part.rows = blk->rows - first < chunk_rows ? blk->rows - first : chunk_rows;
+        if (read_path != NULL)
+        {
+            status |= read_matrix_block(read_path, n, &part, rows_fp64, comm);
+        }
+        else
+        {
+            generate_block(n, &part, PREC_FP64, rows_fp64);
+        }
+        if (part.rows > 0)
+        {
+            local_gemv(part.rows, part.cols, rows_fp64, part.cols, x, y + first);
+            convert_elements(precision, rows_fp64, (char *)A + (size_t)first * part.cols * precision_bytes[precision],
+                             (size_t)part.rows * part.cols);
+        }
+    }
+    return status;
+}
+
+// float copy of x for the formats that multiply in float, or NULL when the format needs none.
+// *ok is cleared if the allocation fails.
+float *single_copy_of_x(int precision, int n, int *ok)
+{
+    if (precision != PREC_FP32 && precision != PREC_BF16)
+    {
+        return NULL;
+    }
+    float *x_single = alloc_elements(n, sizeof(float));
+    *ok = *ok && x_single != NULL;
+    return x_single;
+}
+
+// Calibration probe of the balanced 1D mode: `units` rows of local_gemv, cycling over a buffer of
+// generated rows
+struct gemv_probe
+{
+    int n, rows;   // Row length, rows in the buffer
+    int precision; // Storage format of A (-t)
+    void *A;
+    double *x, *y;
+    float *x_single;
+};
+
+void probe_gemv(long long units, void *ctx)
+{
+    const struct gemv_probe *p = ctx;
+    for (long long done = 0; done < units; done += p->rows)
+    {
+        int rows = (units - done < p->rows) ? (int)(units - done) : p->rows;
+        local_gemv_typed(p->precision, rows, p->n, p->A, p->n, p->x, p->x_single, p->y);
+    }
+}
+
+// Rows of every rank in the balanced 1D mode (-b): in proportion to the speed each rank measured
+// on the local kernel of the storage format with rows of length n, or cached for its host.
+// Collective over comm.
+void balanced_row_distribution(int n, int precision, int *counts, int *displs, struct timing *tm, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    struct gemv_probe probe;
+    probe.n = n;
+    probe.precision = precision;
+    probe.rows = PROBE_DOUBLES / n < ROW_UNROLL ? ROW_UNROLL : (PROBE_DOUBLES / n < n ? PROBE_DOUBLES / n : n);
+    int probe_ok = 1;
+    probe.A = alloc_elements((size_t)probe.rows * n, precision_bytes[precision]);
+    probe.x = alloc_doubles(n);
+    probe.y = alloc_doubles(probe.rows);
+    probe.x_single = single_copy_of_x(precision, n, &probe_ok);
+    double *weights = malloc(size * sizeof(double));
+    long long *starts = malloc((size + 1) * sizeof(long long));
+    if (!probe_ok || probe.A == NULL || probe.x == NULL || probe.y == NULL || weights == NULL || starts == NULL)
+    {
+        fprintf(stderr, "Error: Rank %d cannot allocate the calibration probe for N=%d.\n", rank, n);
+        MPI_Abort(comm, 1);
+    }
+    struct block probe_blk = {0, probe.rows, 0, n};
+    generate_block(n, &probe_blk, precision, probe.A);
+    for (int j = 0; j < n; j++)
+    {
+        probe.x[j] = vector_entry(j);
+    }
+    if (probe.x_single != NULL)
+    {
+        convert_elements(PREC_FP32, probe.x, probe.x_single, n);
+    }
+
+    char key[BALANCE_KEY_LEN / 2];
+    snprintf(key, sizeof(key), "vector-matrix:n=%d:type=%s", n, precision_names[precision]);
+    timing_start(tm, "calibrate");
+    int nodes_probed = balance_weights(key, probe_gemv, &probe, probe.rows, weights, comm);
+    timing_stop(tm, "calibrate");
+    balance_print(weights, nodes_probed, comm);
+    balance_split(n, weights, size, starts);
+    for (int r = 0; r < size; r++)
+    {
+        displs[r] = (int)starts[r];
+        counts[r] = (int)(starts[r + 1] - starts[r]);
+    }
+    free(weights);
+    free(starts);
+    free(probe.A);
+    free(probe.x);
+    free(probe.y);
+    free(probe.x_single);
+}
+
+// One row of n elements of A in the format of precision. bfloat16 has no MPI type of its own;
+// its bit patterns travel as MPI_UINT16_T, which no implementation converts.
+MPI_Datatype make_row_type(int n, int precision)
+{
+    MPI_Datatype element = MPI_DOUBLE;
+    if (precision == PREC_FP32 || precision == PREC_FP32_ACC)
+    {
+        element = MPI_FLOAT;
+    }
+    else if (precision == PREC_BF16)
+    {
+        element = MPI_UINT16_T;
+    }
+    MPI_Datatype row_type;
+    MPI_Type_contiguous(n, element, &row_type);
+    MPI_Type_commit(&row_type);
+    return row_type;
+}
+
+// 1D row-block product. Root holds the full matrix_A, vector_x and result_b; every other rank
+// receives its block of rows (counts / displs, in rows) with Scatterv and returns its results
+// with Gatherv.
+// vector_x is one node-shared buffer (topo_alloc_shared, window x_win): x only travels to the
+// node leaders and the other ranks read the leader's copy. If preloaded_A is not NULL, every rank
+// already holds its own rows there and all of x in vector_x, and nothing is distributed.
+// A (matrix_A or preloaded_A) is stored in the format of precision and travels in it.
+// Phases are timed into tm. Returns 0 on success.
+int multiply_1d(int n, const void *matrix_A, double *vector_x, const void *preloaded_A, double *result_b,
+                const int *counts, const int *displs, int precision, const struct topology *topo, MPI_Win x_win,
+                struct timing *tm, MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int local_n = counts[rank];
+
+    // One row of A is N contiguous elements; using it as the transfer unit keeps
+    // Scatterv counts in rows so they never overflow an int for large N.
+    MPI_Datatype row_type = make_row_type(n, precision);
+
+    // Root's own block is the first slice of the full matrix and result,
+    // so it works in place instead of keeping a second copy.
+    const void *local_rows = preloaded_A != NULL ? preloaded_A : matrix_A;
+    double *local_result = result_b;
+    void *recv_rows = NULL;
+    int alloc_ok = 1;
+    float *x_single = single_copy_of_x(precision, n, &alloc_ok);
+    if (rank != 0)
+    {
+        if (preloaded_A == NULL)
+        {
+            recv_rows = alloc_elements((size_t)local_n * n, precision_bytes[precision]);
+            local_rows = recv_rows;
+        }
+        local_result = alloc_doubles(local_n);
+        alloc_ok = alloc_ok && local_rows != NULL && local_result != NULL;
+    }
+
+    int all_ok;
+    MPI_Allreduce(&alloc_ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    if (all_ok && preloaded_A == NULL)
+    {
+        timing_start(tm, "distribute");
+        // --- Distribute vector x to all nodes (one copy per node) ---
+        topo_bcast_shared(vector_x, n, MPI_DOUBLE, 0, topo, x_win);
+
+        // --- Distribute rows of matrix A: every rank receives its block at once ---
+        MPI_Scatterv(matrix_A, counts, displs, row_type,
+                     rank == 0 ? MPI_IN_PLACE : recv_rows, local_n, row_type,
+                     0, comm);
+        timing_stop(tm, "distribute");
+    }
+    if (all_ok)
+    {
+        // --- Each process calculates its portion of the result ---
+        timing_start(tm, "compute");
+        if (x_single != NULL)
+        {
+            convert_elements(PREC_FP32, vector_x, x_single, n);
+        }
+        local_gemv_typed(precision, local_n, n, local_rows, n, vector_x, x_single, local_result);
+        timing_stop(tm, "compute");
+
+        // --- Gather the partial results back onto the root ---
+        timing_start(tm, "gather");
+        MPI_Gatherv(rank == 0 ? MPI_IN_PLACE : local_result, local_n, MPI_DOUBLE,
+                    result_b, counts, displs, MPI_DOUBLE,
+                    0, comm);
+        timing_stop(tm, "gather");
+    }
+
+    if (rank != 0)
+    {
+        free(recv_rows);
+        free(local_result);
+    }
+    free(x_single);
+    MPI_Type_free(&row_type);
+    return all_ok ? 0 : 1;
+}
+
+// Pipelined 1D row-block product (-c): the same row blocks as multiply_1d, but a block travels as
+// chunks of chunk_rows rows so that nobody waits for a whole block before computing.
+// Root: posts a receive for every result chunk, then an MPI_Isend for every row chunk (round-robin
+// over the workers, so each worker's first chunk leaves early), and multiplies its own rows chunk
+// by chunk, polling the transfers in between so they keep moving.
+// Worker: keeps two chunk receives posted; while chunk k is multiplied chunk k+1 is arriving, and
+// the results of chunk k go back with MPI_Isend at once, into their place in result_b on the root.
+// matrix_A is stored in the format of precision. Returns 0 on success.
+int multiply_1d_pipelined(int n, const void *matrix_A, double *vector_x, double *result_b, const int *counts,
+                          const int *displs, int chunk_rows, int precision, const struct topology *topo,
+                          MPI_Win x_win, struct timing *tm, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int local_n = counts[rank];
+    int local_chunks = (local_n + chunk_rows - 1) / chunk_rows;
+
+    // Transfer unit of the row chunks: one row of A (see multiply_1d)
+    MPI_Datatype row_type = make_row_type(n, precision);
+    size_t row_bytes = (size_t)n * precision_bytes[precision];
+
+    int total_chunks = 0; // Chunks of all workers (root only)
+    int max_chunks = 0;   // Most chunks of any rank
+    for (int r = 0; r < size; r++)
+    {
+        int chunks = (counts[r] + chunk_rows - 1) / chunk_rows;
+        total_chunks += r > 0 ? chunks : 0;
+        max_chunks = chunks > max_chunks ? chunks : max_chunks;
+    }
+    void *buffers[2] = {NULL, NULL};
+    double *local_result = result_b;
+    MPI_Request *requests = NULL;
+    int alloc_ok = 1;
+    float *x_single = single_copy_of_x(precision, n, &alloc_ok);
+    if (rank == 0)
+    {
+        requests = malloc((2 * (size_t)total_chunks + 1) * sizeof(MPI_Request));
+        alloc_ok = alloc_ok && requests != NULL;
+    }
+    else
+    {
+        buffers[0] = alloc_elements((size_t)chunk_rows * n, precision_bytes[precision]);
+        buffers[1] = alloc_elements((size_t)chunk_rows * n, precision_bytes[precision]);
+        local_result = alloc_doubles(local_n);
+        requests = malloc((local_chunks + 2) * sizeof(MPI_Request));
+        alloc_ok = alloc_ok && buffers[0] != NULL && buffers[1] != NULL && local_result != NULL && requests != NULL;
+    }
+    int all_ok;
+    MPI_Allreduce(&alloc_ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    if (!all_ok)
+    {
+        free(buffers[0]);
+        free(buffers[1]);
+        if (rank != 0)
+        {
+            free(local_result);
+        }
+        free(requests);
+        free(x_single);
+        MPI_Type_free(&row_type);
+        return 1;
+    }
+
+    // --- x goes out whole first (one copy per node), every chunk needs all of it ---
+    timing_start(tm, "distribute");
+    topo_bcast_shared(vector_x, n, MPI_DOUBLE, 0, topo, x_win);
+    timing_stop(tm, "distribute");
+    if (x_single != NULL)
+    {
+        timing_start(tm, "compute");
+        convert_elements(PREC_FP32, vector_x, x_single, n);
+        timing_stop(tm, "compute");
+    }
+
+    if (rank == 0)
+    {
+        // --- Root: post all transfers, then compute its own rows while they drain ---
+        timing_start(tm, "distribute");
+        int num_requests = 0;
+        for (int r = 1; r < size; r++)
+        {
+            for (int row = 0; row < counts[r]; row += chunk_rows)
+            {
+                int rows = (counts[r] - row < chunk_rows) ? counts[r] - row : chunk_rows;
+                MPI_Irecv(&result_b[displs[r] + row], rows, MPI_DOUBLE, r, TAG_RESULT, comm, &requests[num_requests++]);
+            }
+        }
+        for (int c = 0; c < max_chunks; c++)
+        {
+            for (int r = 1; r < size; r++)
+            {
+                int row = c * chunk_rows;
+                if (row < counts[r])
+                {
+                    int rows = (counts[r] - row < chunk_rows) ? counts[r] - row : chunk_rows;
+                    MPI_Isend((const char *)matrix_A + (size_t)(displs[r] + row) * row_bytes, rows, row_type, r,
+                              TAG_ROWS, comm, &requests[num_requests++]);
+                }
+            }
+        }
+        timing_stop(tm, "distribute");
+
+        for (int row = 0; row < local_n; row += chunk_rows)
+        {
+            int rows = (local_n - row < chunk_rows) ? local_n - row : chunk_rows;
+            timing_start(tm, "compute");
+            local_gemv_typed(precision, rows, n, (const char *)matrix_A + (size_t)row * row_bytes, n, vector_x,
+                             x_single, &result_b[row]);
+            timing_stop(tm, "compute");
+            int done;
+            MPI_Testall(num_requests, requests, &done, MPI_STATUSES_IGNORE); // Progress for the transfers
+        }
+
+        timing_start(tm, "gather");
+        MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+        timing_stop(tm, "gather");
+    }
+    else
+    {
+        // --- Worker: double-buffered chunk receives, results returned chunk by chunk ---
+        MPI_Request *recv_requests = requests + local_chunks; // Two slots, one per buffer
+        for (int c = 0; c < 2 && c < local_chunks; c++)
+        {
+            int rows = (local_n - c * chunk_rows < chunk_rows) ? local_n - c * chunk_rows : chunk_rows;
+            MPI_Irecv(buffers[c], rows, row_type, 0, TAG_ROWS, comm, &recv_requests[c]);
+        }
+        for (int c = 0; c < local_chunks; c++)
+        {
+            int row = c * chunk_rows;
+            int rows = (local_n - row < chunk_rows) ? local_n - row : chunk_rows;
+            timing_start(tm, "wait");
+            MPI_Wait(&recv_requests[c % 2], MPI_STATUS_IGNORE);
+            timing_stop(tm, "wait");
+
+            timing_start(tm, "compute");
+            local_gemv_typed(precision, rows, n, buffers[c % 2], n, vector_x, x_single, &local_result[row]);
+            timing_stop(tm, "compute");
+            MPI_Isend(&local_result[row], rows, MPI_DOUBLE, 0, TAG_RESULT, comm, &requests[c]);
+
+            // This buffer is free again: it takes chunk c+2 while chunk c+1 is being multiplied
+            int next_row = (c + 2) * chunk_rows;
+            if (next_row < local_n)
+            {
+                int next_rows = (local_n - next_row < chunk_rows) ? local_n - next_row : chunk_rows;
+                MPI_Irecv(buffers[c % 2], next_rows, row_type, 0, TAG_ROWS, comm, &recv_requests[c % 2]);
+            }
+        }
+        timing_start(tm, "gather");
+        MPI_Waitall(local_chunks, requests, MPI_STATUSES_IGNORE);
+        timing_stop(tm, "gather");
+        free(local_result);
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+    free(requests);
+    free(x_single);
+    MPI_Type_free(&row_type);
+    return 0;
+}
+
+// 2D block product on a pr x pc process grid. Rank (r, c) owns the block of A made of row block r
+// and column block c, receives only slice c of x, and the partial products of each grid row are
+// combined with a reduce-scatter along the row communicator. If preloaded_A is not NULL, every
+// rank already holds its block of A there and its slice of x in preloaded_x, and nothing is
+// distributed. Phases are timed into tm. Returns 0 on success.
+int multiply_2d(int n, const double *matrix_A, const double *vector_x,
+                const double *preloaded_A, const double *preloaded_x,
+                double *result_b, struct timing *tm, MPI_Comm comm)
 {
     int rank, size;
-    double matrix_A[N][N];
-    double vector_x[N];
-    double result_b[N];          // Final result vector (only rank 0 needs the full one)
-    double local_rows[N / 2][N]; // Buffer for rows received by workers (adjust size if needed)
-    double local_result[N / 2];  // Buffer for partial results calculated by workers
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // --- Build the process grid and its row/column sub-communicators ---
+    int dims[2] = {0, 0};
+    int periods[2] = {0, 0};
+    int coords[2];
+    MPI_Dims_create(size, 2, dims);
+    int pr = dims[0], pc = dims[1];
+
+    MPI_Comm grid_comm, row_comm, col_comm;
+    MPI_Cart_create(comm, 2, dims, periods, 0, &grid_comm); // No reordering: grid rank == comm rank
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+    int my_row = coords[0], my_col = coords[1];
+
+    int keep_cols[2] = {0, 1}; // Ranks in the same grid row (varying column)
+    int keep_rows[2] = {1, 0}; // Ranks in the same grid column (varying row)
+    MPI_Cart_sub(grid_comm, keep_cols, &row_comm);
+    MPI_Cart_sub(grid_comm, keep_rows, &col_comm);
+
+    // --- Block sizes along each grid dimension ---
+    int *row_counts = malloc(pr * sizeof(int));
+    int *row_displs = malloc(pr * sizeof(int));
+    int *col_counts = malloc(pc * sizeof(int));
+    int *col_displs = malloc(pc * sizeof(int));
+    compute_block_distribution(n, pr, row_counts, row_displs);
+    compute_block_distribution(n, pc, col_counts, col_displs);
+    int local_rows = row_counts[my_row];
+    int local_cols = col_counts[my_col];
+
+    // The row block of this grid row is further split over its pc ranks for the reduce-scatter
+    int *piece_counts = malloc(pc * sizeof(int));
+    int *piece_displs = malloc(pc * sizeof(int));
+    compute_block_distribution(local_rows, pc, piece_counts, piece_displs);
+    int my_piece = piece_counts[my_col];
+
+    double *local_A = NULL;
+    double *local_x = NULL;
+    if (preloaded_A == NULL)
+    {
+        local_A = alloc_doubles((size_t)local_rows * local_cols);
+        local_x = alloc_doubles(local_cols);
+    }
+    const double *block_A = preloaded_A != NULL ? preloaded_A : local_A;
+    const double *block_x = preloaded_A != NULL ? preloaded_x : local_x;
+    double *partial_y = alloc_doubles(local_rows);
+    double *piece_y = alloc_doubles(my_piece);
+    int alloc_ok = block_A != NULL && block_x != NULL && partial_y != NULL && piece_y != NULL;
+
+    int all_ok;
+    MPI_Allreduce(&alloc_ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    if (all_ok && preloaded_A == NULL)
+    {
+        timing_start(tm, "distribute");
+        // --- Distribute the blocks of A from the root ---
+        if (rank == 0)
+        {
+            MPI_Request *requests = malloc(size * sizeof(MPI_Request));
+            MPI_Datatype *block_types = malloc(size * sizeof(MPI_Datatype));
+            for (int dest = 0; dest < size; dest++)
+            {
+                int dest_coords[2];
+                MPI_Cart_coords(grid_comm, dest, 2, dest_coords);
+                int sizes[2] = {n, n};
+                int subsizes[2] = {row_counts[dest_coords[0]], col_counts[dest_coords[1]]};
+                int starts[2] = {row_displs[dest_coords[0]], col_displs[dest_coords[1]]};
+                requests[dest] = MPI_REQUEST_NULL;
+                block_types[dest] = MPI_DATATYPE_NULL;
+                if (dest == 0 || subsizes[0] == 0 || subsizes[1] == 0)
+                {
+                    continue; // Root copies its own block below; empty blocks need no message
+                }
+                MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &block_types[dest]);
+                MPI_Type_commit(&block_types[dest]);
+                MPI_Isend(matrix_A, 1, block_types[dest], dest, 0, comm, &requests[dest]);
+            }
 
-    MPI_Status status;
+            for (int i = 0; i < local_rows; i++)
+            {
+                memcpy(&local_A[(size_t)i * local_cols], &matrix_A[(size_t)i * n], local_cols * sizeof(double));
+            }
 
-    MPI_Init(&argc, &argv);               // Initialize MPI environment
+            MPI_Waitall(size, requests, MPI_STATUSES_IGNORE);
+            for (int dest = 0; dest < size; dest++)
+            {
+                if (block_types[dest] != MPI_DATATYPE_NULL)
+                {
+                    MPI_Type_free(&block_types[dest]);
+                }
+            }
+            free(requests);
+            free(block_types);
+        }
+        else if (local_rows > 0 && local_cols > 0)
+        {
+            // Receive in units of one block row so the count stays within an int
+            MPI_Datatype block_row_type;
+            MPI_Type_contiguous(local_cols, MPI_DOUBLE, &block_row_type);
+            MPI_Type_commit(&block_row_type);
+            MPI_Recv(local_A, local_rows, block_row_type, 0, 0, comm, MPI_STATUS_IGNORE);
+            MPI_Type_free(&block_row_type);
+        }
+
+        // --- Distribute x: scatter the column slices along grid row 0, then down each grid column ---
+        if (my_row == 0)
+        {
+            MPI_Scatterv(vector_x, col_counts, col_displs, MPI_DOUBLE,
+                         local_x, local_cols, MPI_DOUBLE, 0, row_comm);
+        }
+        MPI_Bcast(local_x, local_cols, MPI_DOUBLE, 0, col_comm);
+        timing_stop(tm, "distribute");
+    }
+    if (all_ok)
+    {
+        // --- Local block product, then sum the partial row results across the grid row ---
+        timing_start(tm, "compute");
+        local_gemv(local_rows, local_cols, block_A, local_cols, block_x, partial_y);
+        timing_stop(tm, "compute");
+        timing_start(tm, "reduce");
+        MPI_Reduce_scatter(partial_y, piece_y, piece_counts, MPI_DOUBLE, MPI_SUM, row_comm);
+        timing_stop(tm, "reduce");
+
+        // --- Collect the finished pieces on the root ---
+        timing_start(tm, "gather");
+        // Grid ranks are row-major, so the pieces are already in global row order.
+        int *gather_counts = NULL;
+        int *gather_displs = NULL;
+        if (rank == 0)
+        {
+            gather_counts = malloc(size * sizeof(int));
+            gather_displs = malloc(size * sizeof(int));
+        }
+        int my_offset = row_displs[my_row] + piece_displs[my_col];
+        MPI_Gather(&my_piece, 1, MPI_INT, gather_counts, 1, MPI_INT, 0, comm);
+        MPI_Gather(&my_offset, 1, MPI_INT, gather_displs, 1, MPI_INT, 0, comm);
+        MPI_Gatherv(piece_y, my_piece, MPI_DOUBLE,
+                    result_b, gather_counts, gather_displs, MPI_DOUBLE, 0, comm);
+        timing_stop(tm, "gather");
+        free(gather_counts);
+        free(gather_displs);
+    }
+
+    if (rank == 0 && all_ok)
+    {
+        printf("Process grid: %d x %d. Block size: %d to %d rows, %d to %d columns.\n",
+               pr, pc, row_counts[pr - 1], row_counts[0], col_counts[pc - 1], col_counts[0]);
+    }
+
+    free(local_A);
+    free(local_x);
+    free(partial_y);
+    free(piece_y);
+    free(row_counts);
+    free(row_displs);
+    free(col_counts);
+    free(col_displs);
+    free(piece_counts);
+    free(piece_displs);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    MPI_Comm_free(&grid_comm);
+    return all_ok ? 0 : 1;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: mpirun ... %s [-d 1d|2d] [-b] [-c ROWS] [-t TYPE] [-i root|gen] [-f FILE] [-w FILE] [N]\n",
+            prog);
+    fprintf(stderr, "  -d 1d    Row-block decomposition (default)\n");
+    fprintf(stderr, "  -d 2d    Block decomposition on a 2D process grid\n");
+    fprintf(stderr, "  -b       Rows per process in proportion to its calibrated speed (1d only)\n");
+    fprintf(stderr, "  -c ROWS  Pipeline the 1d distribution in chunks of ROWS rows (with -i root)\n");
+    fprintf(stderr, "  -t TYPE  Storage of A (1d only): fp64 (default), fp32, fp32acc (fp32 with double sums), bf16\n");
+    fprintf(stderr, "  -i root  Root initializes the whole matrix and distributes it (default)\n");
+    fprintf(stderr, "  -i gen   Every process generates only its own block\n");
+    fprintf(stderr, "  -f FILE  Every process reads its own block of a binary matrix file (N comes from the file)\n");
+    fprintf(stderr, "  -w FILE  Write the matrix to a binary file in parallel (with -i gen or -f)\n");
+    fprintf(stderr, "  N        Matrix dimension (default: %d)\n", DEFAULT_N);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size;
+    int n = DEFAULT_N;
+    int decomp = DECOMP_1D;
+    int input = INPUT_ROOT;
+    int balanced = 0;
+    int chunk_rows = 0; // 0: whole blocks with Scatterv / Gatherv
+    int precision = PREC_FP64;
+    char read_path[MAX_PATH_LEN] = "";
+    char write_path[MAX_PATH_LEN] = "";
+    double start_time, elapsed_time, max_time, init_time;
+
+    // Only the main thread makes MPI calls; OpenMP threads are used inside the local kernel
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided); // Initialize MPI environment
     MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Get the rank (ID) of the current process
     MPI_Comm_size(MPI_COMM_WORLD, &size); // Get the total number of processes
 
-    // Basic check: Ensure N is somewhat reasonable compared to size
-    if (N < size)
+    if (provided < MPI_THREAD_FUNNELED && rank == 0)
+    {
+        fprintf(stderr, "Warning: MPI library does not provide MPI_THREAD_FUNNELED.\n");
+    }
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+
+    // --- Argument Handling (Rank 0 parses and broadcasts the settings) ---
+    if (rank == 0)
+    {
+        int opt;
+        while (n > 0 && (opt = getopt(argc, argv, "d:i:f:w:bc:t:")) != -1)
+        {
+            if (opt == 'd' && strcmp(optarg, "1d") == 0)
+            {
+                decomp = DECOMP_1D;
+            }
+            else if (opt == 'd' && strcmp(optarg, "2d") == 0)
+            {
+                decomp = DECOMP_2D;
+            }
+            else if (opt == 'b')
+            {
+                balanced = 1;
+            }
+            else if (opt == 'c' && atoi(optarg) > 0)
+            {
+                chunk_rows = atoi(optarg);
+            }
+            else if (opt == 't' && strcmp(optarg, "fp64") == 0)
+            {
+                precision = PREC_FP64;
+            }
+            else if (opt == 't' && strcmp(optarg, "fp32") == 0)
+            {
+                precision = PREC_FP32;
+            }
+            else if (opt == 't' && strcmp(optarg, "fp32acc") == 0)
+            {
+                precision = PREC_FP32_ACC;
+            }
+            else if (opt == 't' && strcmp(optarg, "bf16") == 0)
+            {
+                precision = PREC_BF16;
+            }
+            else if (opt == 'i' && strcmp(optarg, "root") == 0)
+            {
+                input = INPUT_ROOT;
+            }
+            else if (opt == 'i' && strcmp(optarg, "gen") == 0)
+            {
+                input = INPUT_GEN;
+            }
+            else if (opt == 'f' && strlen(optarg) < MAX_PATH_LEN)
+            {
+                input = INPUT_FILE;
+                strcpy(read_path, optarg);
+            }
+            else if (opt == 'w' && strlen(optarg) < MAX_PATH_LEN)
+            {
+                strcpy(write_path, optarg);
+            }
+            else
+            {
+                print_usage(argv[0]);
+                n = -1; // Signal error
+            }
+        }
+        if (n > 0 && write_path[0] != '\0' && input == INPUT_ROOT)
+        {
+            print_usage(argv[0]);
+            fprintf(stderr, "Error: -w needs the matrix distributed in place (-i gen or -f).\n");
+            n = -1; // Signal error
+        }
+        if (n > 0 && balanced && decomp == DECOMP_2D)
+        {
+            print_usage(argv[0]);
+            fprintf(stderr, "Error: -b balances the row blocks of the 1d decomposition only.\n");
+            n = -1; // Signal error
+        }
+        if (n > 0 && chunk_rows > 0 && (decomp == DECOMP_2D || input != INPUT_ROOT))
+        {
+            print_usage(argv[0]);
+            fprintf(stderr, "Error: -c pipelines the root's 1d distribution (-d 1d -i root) only.\n");
+            n = -1; // Signal error
+        }
+        if (n > 0 && precision != PREC_FP64 && decomp == DECOMP_2D)
+        {
+            print_usage(argv[0]);
+            fprintf(stderr, "Error: -t selects the storage of A for the 1d decomposition only.\n");
+            n = -1; // Signal error
+        }
+        if (n > 0 && precision != PREC_FP64 && write_path[0] != '\0')
+        {
+            print_usage(argv[0]);
+            fprintf(stderr, "Error: -w writes fp64 matrix files only; leave out -t.\n");
+            n = -1; // Signal error
+        }
+        if (n > 0 && optind < argc)
+        {
+            n = atoi(argv[optind]);
+            if (n <= 0)
+            {
+                print_usage(argv[0]);
+                fprintf(stderr, "Error: Matrix dimension N must be a positive integer.\n");
+                n = -1; // Signal error
+            }
+        }
+    }
+    int settings[6] = {n, decomp, input, balanced, chunk_rows, precision};
+    MPI_Bcast(settings, 6, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(read_path, MAX_PATH_LEN, MPI_CHAR, 0, MPI_COMM_WORLD);
+    MPI_Bcast(write_path, MAX_PATH_LEN, MPI_CHAR, 0, MPI_COMM_WORLD);
+    n = settings[0];
+    decomp = settings[1];
+    input = settings[2];
+    balanced = settings[3];
+    chunk_rows = settings[4];
+    precision = settings[5];
+    if (n <= 0)
+    {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // For file input the dimension comes from the file header
+    if (input == INPUT_FILE && read_matrix_header(read_path, &n, MPI_COMM_WORLD) != 0)
     {
         if (rank == 0)
         {
-            fprintf(stderr, "Error: Matrix dimension N (%d) should ideally be >= number of processes (%d) for good distribution.\n", N, size);
+            fprintf(stderr, "Error: Cannot read a square matrix header from '%s'.\n", read_path);
         }
         MPI_Finalize();
         return 1;
     }
 
-    // --- Root Process (Rank 0): Initialize data and distribute ---
-    if (rank == 0)
+    // Which ranks share a node: in the 1D mode they share one copy of x
+    struct topology topo;
+    topo_init(MPI_COMM_WORLD, &topo);
+
+    // --- Row distribution of the 1D mode (every rank computes the same table) ---
+    // Even by default; with -b every rank first measures how fast it multiplies rows.
+    struct timing tm;
+    timing_init(&tm);
+    int *row_counts = malloc(size * sizeof(int));
+    int *row_displs = malloc(size * sizeof(int));
+    if (balanced)
     {
-        printf("MPI Matrix-Vector Multiplication (N=%d, Processes=%d)\n", N, size);
-        srand(time(NULL)); // Seed random number generator
+        balanced_row_distribution(n, precision, row_counts, row_displs, &tm, MPI_COMM_WORLD);
+    }
+    else
+    {
+        compute_block_distribution(n, size, row_counts, row_displs);
+    }
+
+    // --- Buffer allocation (once, contiguous and aligned) ---
+    // With root input only the root holds the full matrix. The 1D mode needs all of x on every
+    // rank, which is one node-shared buffer per node. With generated or file input every rank
+    // allocates just its own block and, in the 2D mode, the part of x it multiplies with.
+    // A is held in the storage format of -t from the start; only x and b stay double.
+    struct block blk;
+    local_block(n, decomp, rank, size, &blk);
+    if (decomp == DECOMP_1D)
+    {
+        blk.row_start = row_displs[rank];
+        blk.rows = row_counts[rank];
+    }
 
-        // Initialize matrix A and vector x with some values (e.g., random or sequential)
-        printf("Initializing matrix A and vector x...\n");
-        for (int i = 0; i < N; i++)
+    size_t elem_bytes = precision_bytes[precision];
+    void *matrix_A = NULL;
+    double *result_b = NULL;
+    double *vector_x = NULL;
+    void *local_A = NULL;
+    double *local_x = NULL;
+    double *reference_b = NULL; // Reduced formats: the fp64 product on the same A and x (root only)
+    double *scratch_row = NULL; // Root input in a reduced format: one row in double before conversion
+    double *chunk_fp64 = NULL;      // Other inputs in a reduced format: a few rows of A in double...
+    double *local_reference = NULL; // ...and this rank's part of the fp64 reference product
+    int reference_rows = REF_DOUBLES / n > 1 ? REF_DOUBLES / n : 1;
+    MPI_Win x_win = MPI_WIN_NULL;
+    int alloc_ok = 1;
+    if (input != INPUT_ROOT)
+    {
+        local_A = alloc_elements((size_t)blk.rows * blk.cols, elem_bytes);
+        alloc_ok = local_A != NULL;
+        if (precision != PREC_FP64)
+        {
+            reference_rows = reference_rows < blk.rows ? reference_rows : blk.rows;
+            chunk_fp64 = alloc_doubles((size_t)reference_rows * blk.cols);
+            local_reference = alloc_doubles(blk.rows);
+            alloc_ok = alloc_ok && chunk_fp64 != NULL && local_reference != NULL;
+        }
+        if (decomp == DECOMP_2D)
         {
-            vector_x[i] = (double)(i + 1); // Example: 1, 2, 3, ...
-            for (int j = 0; j < N; j++)
+            local_x = alloc_doubles(blk.cols);
+            alloc_ok = alloc_ok && local_x != NULL;
+        }
+    }
+    if (decomp == DECOMP_1D)
+    {
+        vector_x = topo_alloc_shared((MPI_Aint)n * sizeof(double), &topo, &x_win);
+        alloc_ok = alloc_ok && vector_x != NULL;
+    }
+    else if (rank == 0 && input == INPUT_ROOT)
+    {
+        vector_x = alloc_doubles(n);
+        alloc_ok = alloc_ok && vector_x != NULL;
+    }
+    if (rank == 0)
+    {
+        if (input == INPUT_ROOT)
+        {
+            matrix_A = alloc_elements((size_t)n * n, elem_bytes);
+            alloc_ok = alloc_ok && matrix_A != NULL;
+            if (precision != PREC_FP64)
             {
-                // matrix_A[i][j] = (double)(rand() % 10); // Random 0-9
-                matrix_A[i][j] = (double)(i * N + j + 1); // Example: 1, 2, .. N*N
+                scratch_row = alloc_doubles(n);
+                alloc_ok = alloc_ok && scratch_row != NULL;
             }
         }
+        result_b = alloc_doubles(n);
+        alloc_ok = alloc_ok && result_b != NULL;
+        if (precision != PREC_FP64)
+        {
+            reference_b = alloc_doubles(n);
+            alloc_ok = alloc_ok && reference_b != NULL;
+        }
+    }
 
-        // Optional: Print initial matrix and vector
-        // print_matrix(matrix_A, N, N);
-        // print_vector(vector_x, N);
-        printf("Initialization complete.\n");
+    int all_ok;
+    MPI_Allreduce(&alloc_ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!all_ok)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Failed to allocate buffers for N=%d on one or more processes.\n", n);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (rank == 0)
+    {
+        printf("MPI Matrix-Vector Multiplication (N=%d, Processes=%d, Threads/process=%d, Decomposition=%s)\n",
+               n, size, num_threads, decomp == DECOMP_2D ? "2D" : (balanced ? "1D balanced" : "1D"));
+        if (decomp == DECOMP_1D)
+        {
+            printf("Vector x shared per node: %d copies for %d processes\n", topo.num_nodes, size);
+        }
+        if (precision != PREC_FP64)
+        {
+            printf("Matrix storage: %s (%zu bytes per element instead of %zu)\n", precision_names[precision],
+                   elem_bytes, sizeof(double));
+        }
+        if (chunk_rows > 0)
+        {
+            printf("Pipelined distribution: chunks of %d rows, results returned per chunk\n", chunk_rows);
+        }
+    }
 
-        // --- Distribute vector x to all processes ---
-        printf("Broadcasting vector x...\n");
-        MPI_Bcast(vector_x, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-        // --- Distribute rows of matrix A to worker processes ---
-        printf("Distributing matrix A rows...\n");
-        int rows_per_proc = N / size;
-        int remainder = N % size; // Rows left over if not perfectly divisible
-        int rows_sent = 0;
-        int current_row_index = 0;
-
-        // Calculate rows for the root process itself
-        int root_rows = rows_per_proc + remainder; // Root handles the remainder
-        rows_sent = root_rows;                     // Keep track of rows assigned
-        current_row_index += root_rows;
-
-        // Send rows to each worker process
-        for (int dest_rank = 1; dest_rank < size; dest_rank++)
-        {
-            int rows_to_send = rows_per_proc;
-            if (rows_to_send > 0)
-            { // Only send if there are rows to send
-                MPI_Send(
-                    &matrix_A[current_row_index][0], // Pointer to the start of the rows
-                    rows_to_send * N,                // Number of elements to send (rows * columns)
-                    MPI_DOUBLE,                      // Data type
-                    dest_rank,                       // Destination rank
-                    0,                               // Message tag
-                    MPI_COMM_WORLD                   // Communicator
-                );
-                rows_sent += rows_to_send;
-                current_row_index += rows_to_send;
+    // --- Initialize data ---
+    MPI_Barrier(MPI_COMM_WORLD); // Synchronize before timing
+    start_time = MPI_Wtime();
+    timing_start(&tm, "init");
+
+    int io_status = 0;
+    if (input == INPUT_ROOT)
+    {
+        // Root Process (Rank 0) fills everything; it is distributed inside the multiply
+        if (rank == 0)
+        {
+            printf("Initializing matrix A and vector x on the root...\n");
+            for (int i = 0; i < n; i++)
+            {
+                vector_x[i] = vector_entry(i); // Example: 1, 2, 3, ...
+            }
+            for (int i = 0; i < n; i++)
+            {
+                // A reduced format goes through one double row, which also gives the fp64 reference
+                double *row = scratch_row != NULL ? scratch_row : (double *)matrix_A + (size_t)i * n;
+                for (int j = 0; j < n; j++)
+                {
+                    row[j] = matrix_entry(n, i, j); // Example: 1, 2, .. N*N
+                }
+                if (scratch_row != NULL)
+                {
+                    local_gemv(1, n, scratch_row, n, vector_x, &reference_b[i]);
+                    convert_elements(precision, scratch_row, (char *)matrix_A + (size_t)i * n * elem_bytes, n);
+                }
+            }
+        }
+    }
+    else
+    {
+        if (rank == 0)
+        {
+            if (input == INPUT_GEN)
+            {
+                printf("Each process generating its own block of A...\n");
             }
             else
             {
-                // Handle case where N < size, some processes might get 0 rows initially.
-                // We could send a dummy message or handle it in the receiving part.
-                // For simplicity here, we assume N >= size and rows_per_proc >= 1 usually.
+                printf("Each process reading its own block of A from '%s'...\n", read_path);
             }
         }
-        printf("Distribution complete. Root keeps %d rows. Workers get %d rows each.\n", root_rows, rows_per_proc);
-
-        // --- Root Process: Calculate its portion of the result ---
-        printf("Root calculating its %d rows...\n", root_rows);
-        for (int i = 0; i < root_rows; i++)
+        // x is cheap to generate, so every rank builds the part it needs instead of receiving it
+        if (decomp == DECOMP_2D)
         {
-            result_b[i] = 0.0;
-            for (int j = 0; j < N; j++)
+            for (int j = 0; j < blk.cols; j++)
             {
-                result_b[i] += matrix_A[i][j] * vector_x[j];
+                local_x[j] = vector_entry(blk.col_start + j);
             }
         }
-
-        // --- Root Process: Gather results from worker processes ---
-        printf("Root gathering results from workers...\n");
-        int received_row_index = root_rows; // Start index for placing received results
-        for (int source_rank = 1; source_rank < size; source_rank++)
+        else
         {
-            int rows_to_receive = rows_per_proc; // Match rows sent
-            if (rows_to_receive > 0)
+            // One rank per node fills the node's shared copy
+            if (topo.is_leader)
             {
-                MPI_Recv(
-                    &result_b[received_row_index], // Pointer to where to store received results
-                    rows_to_receive,               // Number of elements expected
-                    MPI_DOUBLE,                    // Data type
-                    source_rank,                   // Source rank
-                    1,                             // Message tag (use a different tag for results)
-                    MPI_COMM_WORLD,                // Communicator
-                    &status                        // MPI Status object
-                );
-                received_row_index += rows_to_receive;
+                for (int j = 0; j < n; j++)
+                {
+                    vector_x[j] = vector_entry(j);
+                }
             }
+            MPI_Win_fence(0, x_win);
+        }
+
+        if (precision == PREC_FP64 && input == INPUT_GEN)
+        {
+            generate_block(n, &blk, PREC_FP64, local_A);
+        }
+        else if (precision == PREC_FP64)
+        {
+            io_status = read_matrix_block(read_path, n, &blk, local_A, MPI_COMM_WORLD);
+        }
+        else
+        {
+            // A reduced format is built from double rows a chunk at a time, which also yields this
+            // rank's part of the fp64 reference; only the reduced copy stays resident
+            io_status = build_reduced_block(n, &blk, precision, input == INPUT_FILE ? read_path : NULL, vector_x,
+                                            chunk_fp64, reference_rows, local_A, local_reference, MPI_COMM_WORLD);
+            MPI_Gatherv(local_reference, blk.rows, MPI_DOUBLE, reference_b, row_counts, row_displs, MPI_DOUBLE, 0,
+                        MPI_COMM_WORLD);
         }
 
-        // --- Root Process: Print the final result vector ---
-        printf("\n--- Final Result Vector b ---\n");
-        print_vector(result_b, N);
-        printf("-----------------------------\n");
+        if (io_status == 0 && write_path[0] != '\0')
+        {
+            io_status = write_matrix_block(write_path, n, &blk, local_A, MPI_COMM_WORLD);
+        }
+    }
+
+    timing_stop(&tm, "init");
+    free(scratch_row); // The double staging buffers are only needed while A is built
+    free(chunk_fp64);
+    free(local_reference);
+    elapsed_time = MPI_Wtime() - start_time;
+    MPI_Reduce(&elapsed_time, &init_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    int any_io_error;
+    MPI_Allreduce(&io_status, &any_io_error, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (any_io_error)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Parallel matrix file I/O failed.\n");
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0)
+    {
+        printf("Initialization complete.\n");
+        if (write_path[0] != '\0')
+        {
+            printf("Matrix written to '%s'.\n", write_path);
+        }
+    }
+
+    // --- Distribute, multiply and collect with the selected decomposition ---
+    MPI_Barrier(MPI_COMM_WORLD); // Synchronize before timing
+    start_time = MPI_Wtime();
+
+    int status;
+    if (decomp == DECOMP_2D)
+    {
+        status = multiply_2d(n, matrix_A, vector_x, local_A, local_x, result_b, &tm, MPI_COMM_WORLD);
+    }
+    else if (chunk_rows > 0)
+    {
+        status = multiply_1d_pipelined(n, matrix_A, vector_x, result_b, row_counts, row_displs, chunk_rows, precision,
+                                       &topo, x_win, &tm, MPI_COMM_WORLD);
     }
-    // --- Worker Processes (Rank > 0): Receive data, compute, send back ---
     else
     {
-        // --- Receive broadcast vector x ---
-        MPI_Bcast(vector_x, N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        status = multiply_1d(n, matrix_A, vector_x, local_A, result_b, row_counts, row_displs, precision, &topo,
+                             x_win, &tm, MPI_COMM_WORLD);
+    }
+
+    elapsed_time = MPI_Wtime() - start_time;
+    MPI_Reduce(&elapsed_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (status != 0)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: Failed to allocate work buffers for N=%d on one or more processes.\n", n);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Every element of A is read once per product, so A's bytes over the slowest rank's kernel
+    // time is the memory bandwidth the kernels sustained together
+    double compute_time = timing_get(&tm, "compute");
+    double max_compute_time;
+    MPI_Reduce(&compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
-        // --- Receive rows of matrix A from root ---
-        int rows_per_proc = N / size; // Worker calculates how many rows it expects
-        if (rows_per_proc > 0)
+    // --- Root Process: Verify and print the final result vector ---
+    if (rank == 0)
+    {
+        double checksum = 0.0;
+        for (int i = 0; i < n; i++)
         {
-            MPI_Recv(
-                local_rows,        // Buffer to store received rows
-                rows_per_proc * N, // Number of elements expected
-                MPI_DOUBLE,        // Data type
-                0,                 // Source rank (root)
-                0,                 // Message tag (matches send tag)
-                MPI_COMM_WORLD,    // Communicator
-                &status            // MPI Status object
-            );
+            checksum += result_b[i];
+        }
+
+        if (n <= PRINT_LIMIT)
+        {
+            printf("\n--- Final Result Vector b ---\n");
+            print_vector(result_b, n);
+            printf("-----------------------------\n");
+        }
+        printf("Checksum (sum of b): %.10e\n", checksum);
 
-            // --- Worker Process: Calculate its portion of the result ---
-            for (int i = 0; i < rows_per_proc; i++)
+        // A file may hold any matrix, so only generated data is checked against the closed form
+        if (input != INPUT_FILE)
+        {
+            // With A[i][j] = i*N + j + 1 and x[j] = j + 1 the exact result is
+            // b[i] = i*N * N(N+1)/2 + N(N+1)(2N+1)/6
+            double dn = (double)n;
+            double sum_j = dn * (dn + 1.0) / 2.0;
+            double sum_j2 = dn * (dn + 1.0) * (2.0 * dn + 1.0) / 6.0;
+            double max_rel_error = 0.0;
+            for (int i = 0; i < n; i++)
             {
-                local_result[i] = 0.0;
-                for (int j = 0; j < N; j++)
+                double expected = (double)i * dn * sum_j + sum_j2;
+                double rel_error = fabs(result_b[i] - expected) / expected;
+                if (rel_error > max_rel_error)
                 {
-                    local_result[i] += local_rows[i][j] * vector_x[j];
+                    max_rel_error = rel_error;
                 }
             }
-
-            // --- Worker Process: Send results back to root ---
-            MPI_Send(
-                local_result,  // Pointer to the calculated partial result
-                rows_per_proc, // Number of elements to send
-                MPI_DOUBLE,    // Data type
-                0,             // Destination rank (root)
-                1,             // Message tag (use a different tag for results)
-                MPI_COMM_WORLD // Communicator
-            );
+            printf("Max relative error vs. analytic (fp64) result: %.3e\n", max_rel_error);
         }
-        else
+        // Any input, including a file: how far the reduced format is from fp64 on the same data.
+        // Exact zeros of the reference are compared absolutely.
+        if (reference_b != NULL)
         {
-            // If N < size or N not divisible, some processes might not receive/calculate/send.
-            // This simple version assumes N >= size and rows_per_proc >= 1.
+            double max_rel_error = 0.0;
+            for (int i = 0; i < n; i++)
+            {
+                double error = fabs(result_b[i] - reference_b[i]);
+                double rel_error = reference_b[i] != 0.0 ? error / fabs(reference_b[i]) : error;
+                if (rel_error > max_rel_error)
+                {
+                    max_rel_error = rel_error;
+                }
+            }
+            printf("Max relative error vs. fp64 product on the same A and x: %.3e\n", max_rel_error);
         }
+        printf("Initialization time: %f seconds\n", init_time);
+        printf("Distribute + multiply + collect time: %f seconds\n", max_time);
+        if (max_compute_time > 0.0)
+        {
+            double matrix_bytes = (double)n * n * elem_bytes;
+            printf("Kernel bandwidth: %.2f GB/s (%.1f MB of A in %f seconds, slowest process)\n",
+                   matrix_bytes / max_compute_time / 1e9, matrix_bytes / 1e6, max_compute_time);
+        }
+    }
+
+    char params[96];
+    snprintf(params, sizeof(params), "n=%d decomp=%s input=%s chunk=%d type=%s", n,
+             decomp == DECOMP_2D ? "2d" : (balanced ? "1d-balanced" : "1d"),
+             input == INPUT_ROOT ? "root" : (input == INPUT_GEN ? "gen" : "file"), chunk_rows,
+             precision_names[precision]);
+    timing_report(&tm, "vector-matrix", params, MPI_COMM_WORLD);
+
+    // --- Cleanup ---
+    free(matrix_A);
+    free(result_b);
+    if (x_win != MPI_WIN_NULL)
+    {
+        MPI_Win_free(&x_win); // Releases the node-shared vector_x
     }
+    else
+    {
+        free(vector_x);
+    }
+    free(local_A);
+    free(local_x);
+    free(reference_b);
+    free(row_counts);
+    free(row_displs);
+    topo_free(&topo);
 
     MPI_Finalize(); // Finalize MPI environment
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,83 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+// Shared-memory (OpenMP) versions of the kernels the MPI programs in src/mpi distribute, as the
+// single-node baseline to compare ranks, threads and hybrids against.
+//
+//   omp_pi           midpoint rule for the integral of 4/(1+x^2) over [0, 1] (pi.c)
+//   omp_trapezoid    trapezoid rule for the integral of x^2 over [a, b] (trapezoid.c's default)
+//   omp_matvec_init  A[i][j] = i*N + j + 1 and x[j] = j + 1, as vector-matrix.c generates them
+//   omp_matvec       y = A x for a row-major N x N matrix (vector-matrix.c)
+//
+// The two quadratures use schedule(runtime), so omp_set_schedule (or OMP_SCHEDULE) picks the
+// loop schedule without recompiling. The matrix-vector product always uses schedule(static):
+// omp_matvec_init writes every row with the thread that will later multiply it, so the pages
+// of A are first touched on that thread's NUMA node, and that only holds if both loops hand out
+// the same rows.
+
+#include <omp.h>
+#include <stddef.h>
+
+static inline double omp_pi(long long num_intervals)
+{
+    double step = 1.0 / (double)num_intervals;
+    double sum = 0.0;
+#pragma omp parallel for simd reduction(+ : sum) schedule(runtime)
+    for (long long i = 0; i < num_intervals; i++)
+    {
+        double x = (i + 0.5) * step;
+        sum += 4.0 / (1.0 + x * x);
+    }
+    return sum * step;
+}
+
+static inline double omp_trapezoid(double a, double b, long long n)
+{
+    double h = (b - a) / (double)n;
+    double sum = 0.5 * (a * a + b * b); // End points count half
+#pragma omp parallel for simd reduction(+ : sum) schedule(runtime)
+    for (long long i = 1; i < n; i++)
+    {
+        double x = a + i * h;
+        sum += x * x;
+    }
+    return sum * h;
+}
+
+// Fill A and x. With first_touch the rows are written in parallel with omp_matvec's schedule;
+// without it one thread writes everything, so all of A lands on one NUMA node (for comparison).
+static inline void omp_matvec_init(int n, double *A, double *x, int first_touch)
+{
+#pragma omp parallel for schedule(static) if (first_touch)
+    for (int i = 0; i < n; i++)
+    {
+        double *row = &A[(size_t)i * n];
+#pragma omp simd
+        for (int j = 0; j < n; j++)
+        {
+            row[j] = (double)((size_t)i * n + j + 1);
+        }
+    }
+    for (int j = 0; j < n; j++)
+    {
+        x[j] = (double)(j + 1);
+    }
+}
+
+static inline void omp_matvec(int n, const double *A, const double *x, double *y)
+{
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++)
+    {
+        const double *row = &A[(size_t)i * n];
+        double sum = 0.0;
+#pragma omp simd reduction(+ : sum)
+        for (int j = 0; j < n; j++)
+        {
+            sum += row[j] * x[j];
+        }
+        y[i] = sum;
+    }
+}
+
+#endif // KERNELS_H
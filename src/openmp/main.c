@@ -1,39 +1,272 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h> // For getopt
+#include <time.h>   // For clock_gettime
+#include <math.h>   // For fabs
+#include "threadpool.h"
 
-int thread_count;
+// Micro-benchmark of the work-stealing pool in threadpool.h against one pthread_create per task,
+// which is what this program used to do.
+//   1. Spawn overhead: empty tasks through the pool vs. create + join of an empty pthread.
+//   2. Scaling: a parallel-for (fill a vector) and a parallel reduction (midpoint rule for pi)
+//      for 1, 2, 4, ... threads, with speedup and parallel efficiency, next to the same loops
+//      run as waves of one pthread per grain-sized piece.
+// Build: gcc -Wall -Wextra -O2 -pthread src/openmp/main.c -o threadpool_bench -lm
 
-void *Hello(void *rank);
+#define DEFAULT_N (1L << 24)     // Loop length of the scaling runs
+#define DEFAULT_GRAIN (1L << 14) // Iterations per task in the scaling runs
+#define DEFAULT_SPAWNS 100000    // Empty tasks in the spawn benchmark
+#define MAX_PTHREAD_SPAWNS 10000 // pthread_create is slow: cap its share of the spawn benchmark
 
-int main(int argc, char *argv[])
+double now(void)
 {
-    long thread;
-    pthread_t *thread_handles;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-    thread_count = strtol(argv[1], NULL, 10);
+// --- Kernels: body(ctx, lo, hi) over a range of indices ---
 
-    thread_handles = malloc(thread_count * sizeof(pthread_t));
+struct kernel_args
+{
+    long n;
+    double h; // 1 / n
+    double *y;
+};
 
-    for (thread = 0; thread < thread_count; thread++)
+// y[i] = f(x_i) for the midpoint x_i of interval i
+void fill_body(void *ctx, long lo, long hi)
+{
+    struct kernel_args *k = ctx;
+    for (long i = lo; i < hi; i++)
     {
-        pthread_create(&thread_handles[thread], NULL, Hello, (void *)thread);
+        double x = (i + 0.5) * k->h;
+        k->y[i] = 4.0 / (1.0 + x * x);
     }
+}
 
-    printf("Hello World from the main thread\n");
-
-    for (thread = 0; thread < thread_count; thread++)
+// h * sum of f(x_i) over [lo, hi): this range's share of pi
+double pi_body(void *ctx, long lo, long hi)
+{
+    struct kernel_args *k = ctx;
+    double sum = 0.0;
+    for (long i = lo; i < hi; i++)
     {
-        pthread_join(thread_handles[thread], NULL);
+        double x = (i + 0.5) * k->h;
+        sum += 4.0 / (1.0 + x * x);
     }
+    return sum * k->h;
+}
 
-    free(thread_handles);
-    return 0;
+void empty_task(void *arg)
+{
+    (void)arg;
 }
 
-void *Hello(void *rank)
+void *empty_thread(void *arg)
+{
+    (void)arg;
+    return NULL;
+}
+
+// --- Baseline: one pthread per task, at most num_threads running at a time ---
+
+struct piece
 {
-    long my_rank = (long)rank;
-    printf("Hello from thread %li of %d\n", my_rank, thread_count);
+    struct kernel_args *k;
+    long lo, hi;
+    int reduce;
+    double result;
+};
+
+void *piece_thread(void *arg)
+{
+    struct piece *p = arg;
+    if (p->reduce)
+    {
+        p->result = pi_body(p->k, p->lo, p->hi);
+    }
+    else
+    {
+        fill_body(p->k, p->lo, p->hi);
+    }
     return NULL;
-}
\ No newline at end of file
+}
+
+// Run [0, n) as grain-sized pieces, each on a freshly created thread, in waves of num_threads.
+// Returns the sum of the piece results in piece order (reduce) or 0.
+double pthread_per_task(struct kernel_args *k, long grain, int num_threads, int reduce)
+{
+    long num_pieces = (k->n + grain - 1) / grain;
+    struct piece *pieces = malloc(num_pieces * sizeof(struct piece));
+    pthread_t *handles = malloc(num_threads * sizeof(pthread_t));
+    double total = 0.0;
+    for (long first = 0; first < num_pieces; first += num_threads)
+    {
+        long wave = (num_pieces - first < num_threads) ? num_pieces - first : num_threads;
+        for (long t = 0; t < wave; t++)
+        {
+            struct piece *p = &pieces[first + t];
+            p->k = k;
+            p->lo = (first + t) * grain;
+            p->hi = (p->lo + grain < k->n) ? p->lo + grain : k->n;
+            p->reduce = reduce;
+            p->result = 0.0; // Fill pieces never set it
+            pthread_create(&handles[t], NULL, piece_thread, p);
+        }
+        for (long t = 0; t < wave; t++)
+        {
+            pthread_join(handles[t], NULL);
+            total += pieces[first + t].result;
+        }
+    }
+    free(pieces);
+    free(handles);
+    return total;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n N] [-g GRAIN] [-s SPAWNS] [-p] <max_threads>\n", prog);
+    fprintf(stderr, "  -n N       Loop length of the scaling runs (default: %ld)\n", DEFAULT_N);
+    fprintf(stderr, "  -g GRAIN   Iterations per task (default: %ld)\n", DEFAULT_GRAIN);
+    fprintf(stderr, "  -s SPAWNS  Empty tasks in the spawn benchmark (default: %d)\n", DEFAULT_SPAWNS);
+    fprintf(stderr, "  -p         Pin pool threads to cores\n");
+}
+
+int main(int argc, char *argv[])
+{
+    long n = DEFAULT_N, grain = DEFAULT_GRAIN;
+    long spawns = DEFAULT_SPAWNS;
+    int pin = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:g:s:p")) != -1)
+    {
+        if (opt == 'n' && atol(optarg) > 0)
+        {
+            n = atol(optarg);
+        }
+        else if (opt == 'g' && atol(optarg) > 0)
+        {
+            grain = atol(optarg);
+        }
+        else if (opt == 's' && atol(optarg) > 0)
+        {
+            spawns = atol(optarg);
+        }
+        else if (opt == 'p')
+        {
+            pin = 1;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    // The thread count used to be read from argv[1] without checking that it was there
+    if (optind != argc - 1 || atoi(argv[optind]) <= 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    int max_threads = atoi(argv[optind]);
+
+    printf("Thread pool benchmark: up to %d threads%s, N=%ld, grain=%ld\n", max_threads, pin ? " (pinned)" : "", n, grain);
+
+    // --- 1. Spawn overhead ---
+    struct tp_pool *pool = tp_create(max_threads, pin);
+    if (pool == NULL)
+    {
+        fprintf(stderr, "Error: Cannot create a pool of %d threads.\n", max_threads);
+        return 1;
+    }
+    struct tp_group group;
+    tp_group_init(&group);
+    double t0 = now();
+    for (long i = 0; i < spawns; i++)
+    {
+        tp_submit(pool, &group, empty_task, NULL);
+    }
+    tp_wait(pool, &group);
+    double pool_spawn = (now() - t0) / spawns;
+    tp_destroy(pool);
+
+    long thread_spawns = spawns < MAX_PTHREAD_SPAWNS ? spawns : MAX_PTHREAD_SPAWNS;
+    t0 = now();
+    for (long i = 0; i < thread_spawns; i++)
+    {
+        pthread_t handle;
+        pthread_create(&handle, NULL, empty_thread, NULL);
+        pthread_join(handle, NULL);
+    }
+    double thread_spawn = (now() - t0) / thread_spawns;
+
+    printf("\n--- Spawn overhead (empty tasks) ---\n");
+    printf("Pool submit + run:        %10.3f us/task (%ld tasks)\n", pool_spawn * 1e6, spawns);
+    printf("pthread_create + join:    %10.3f us/task (%ld tasks)\n", thread_spawn * 1e6, thread_spawns);
+    printf("Ratio:                    %10.1fx\n", thread_spawn / pool_spawn);
+
+    // --- 2. Scaling ---
+    struct kernel_args k = {n, 1.0 / n, malloc(n * sizeof(double))};
+    if (k.y == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate %ld doubles.\n", n);
+        return 1;
+    }
+    printf("\n--- Scaling (speedup and efficiency vs. the pool on 1 thread) ---\n");
+    printf("%8s %8s %12s %9s %11s %14s %9s %12s\n", "Threads", "Kernel", "Pool (s)", "Speedup", "Efficiency",
+           "pthreads (s)", "Speedup", "|pi error|");
+
+    double base_for = 0.0, base_reduce = 0.0;
+    for (int threads = 1; threads <= max_threads; threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2)
+    {
+        pool = tp_create(threads, pin);
+        if (pool == NULL)
+        {
+            fprintf(stderr, "Error: Cannot create a pool of %d threads.\n", threads);
+            free(k.y);
+            return 1;
+        }
+        tp_parallel_for(pool, 0, n, grain, fill_body, &k); // Warm-up: first touch of y, threads started
+
+        t0 = now();
+        tp_parallel_for(pool, 0, n, grain, fill_body, &k);
+        double pool_for = now() - t0;
+        t0 = now();
+        double pi = tp_parallel_reduce(pool, 0, n, grain, pi_body, &k);
+        double pool_reduce = now() - t0;
+        tp_destroy(pool);
+
+        t0 = now();
+        pthread_per_task(&k, grain, threads, 0);
+        double thread_for = now() - t0;
+        t0 = now();
+        double pi_threads = pthread_per_task(&k, grain, threads, 1);
+        double thread_reduce = now() - t0;
+
+        if (threads == 1)
+        {
+            base_for = pool_for;
+            base_reduce = pool_reduce;
+        }
+        printf("%8d %8s %12.6f %9.2f %10.1f%% %14.6f %9.2f %12s\n", threads, "for", pool_for, base_for / pool_for,
+               100.0 * base_for / pool_for / threads, thread_for, base_for / thread_for, "");
+        printf("%8d %8s %12.6f %9.2f %10.1f%% %14.6f %9.2f %12.3e\n", threads, "reduce", pool_reduce,
+               base_reduce / pool_reduce, 100.0 * base_reduce / pool_reduce / threads, thread_reduce,
+               base_reduce / thread_reduce, fabs(pi - M_PI));
+        if (fabs(pi_threads - M_PI) > 1e-9)
+        {
+            fprintf(stderr, "Warning: pthread baseline computed pi = %.15f\n", pi_threads);
+        }
+        if (threads == max_threads)
+        {
+            break;
+        }
+    }
+
+    free(k.y);
+    return 0;
+}
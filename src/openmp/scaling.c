@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // For strcmp, strchr, strcspn
+#include <unistd.h> // For getopt
+#include <math.h>   // For fabs
+#include <omp.h>
+#include "kernels.h"
+
+// Thread-scaling benchmark of the OpenMP kernels in kernels.h. Every selected kernel runs with
+// 1, 2, 4, ... threads up to the maximum (and the maximum itself); each point is timed REPS
+// times and the median counts. Results are CSV on stdout with the speedup over one thread and
+// the parallel efficiency (speedup / threads), next to the kernel's relative error.
+// Build: gcc -Wall -Wextra -O2 -fopenmp src/openmp/scaling.c -o omp_scaling -lm
+
+#define DEFAULT_INTERVALS (1LL << 27) // Intervals of pi and trapezoid
+#define DEFAULT_MATRIX_N 4096         // Matrix dimension of matvec (128 MiB of A)
+#define DEFAULT_REPS 5                // Timed runs per kernel and thread count
+#define TRAPEZOID_A 0.0               // Integration limits of the trapezoid kernel
+#define TRAPEZOID_B 1.0
+#define ALIGNMENT 64 // Cache-line alignment of the matrix and vectors
+
+enum kernel
+{
+    KERNEL_PI = 1,
+    KERNEL_TRAPEZOID = 2,
+    KERNEL_MATVEC = 4,
+    KERNEL_ALL = 7
+};
+
+const char *kernel_names[] = {NULL, "pi", "trapezoid", NULL, "matvec"};
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Parse "static", "dynamic", "guided" or "auto", optionally followed by ",chunk"; 0 if invalid
+int parse_schedule(const char *text, omp_sched_t *kind, int *chunk)
+{
+    const char *comma = strchr(text, ',');
+    size_t len = comma ? (size_t)(comma - text) : strlen(text);
+    *chunk = comma ? atoi(comma + 1) : 0;
+    if (comma && *chunk <= 0)
+    {
+        return 0;
+    }
+    if (len == 6 && strncmp(text, "static", len) == 0)
+    {
+        *kind = omp_sched_static;
+    }
+    else if (len == 7 && strncmp(text, "dynamic", len) == 0)
+    {
+        *kind = omp_sched_dynamic;
+    }
+    else if (len == 6 && strncmp(text, "guided", len) == 0)
+    {
+        *kind = omp_sched_guided;
+    }
+    else if (len == 4 && strncmp(text, "auto", len) == 0)
+    {
+        *kind = omp_sched_auto;
+    }
+    else
+    {
+        return 0;
+    }
+    return 1;
+}
+
+// Relative error of y = A x for the matrix of omp_matvec_init:
+// y[i] = i*N * sum(j+1) + sum((j+1)^2) = i*N * N(N+1)/2 + N(N+1)(2N+1)/6
+double matvec_error(int n, const double *y)
+{
+    double s1 = 0.5 * n * (n + 1.0), s2 = n * (n + 1.0) * (2.0 * n + 1.0) / 6.0;
+    double worst = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        double expected = (double)i * n * s1 + s2;
+        double err = fabs(y[i] - expected) / expected;
+        worst = err > worst ? err : worst;
+    }
+    return worst;
+}
+
+// Median time of reps runs of one kernel on `threads` threads; *error is the relative error of
+// the last run. The matrix is allocated and initialized for every thread count, so its pages are
+// placed by the threads that use them.
+double time_kernel(int kernel, int threads, long long intervals, int n, int reps, int first_touch, double *error)
+{
+    double *times = malloc(reps * sizeof(double));
+    double *A = NULL, *x = NULL, *y = NULL;
+    omp_set_num_threads(threads);
+    if (kernel == KERNEL_MATVEC)
+    {
+        if (posix_memalign((void **)&A, ALIGNMENT, (size_t)n * n * sizeof(double)) != 0 ||
+            posix_memalign((void **)&x, ALIGNMENT, n * sizeof(double)) != 0 ||
+            posix_memalign((void **)&y, ALIGNMENT, n * sizeof(double)) != 0)
+        {
+            fprintf(stderr, "Error: Cannot allocate a %d x %d matrix.\n", n, n);
+            exit(1);
+        }
+        omp_matvec_init(n, A, x, first_touch);
+        omp_matvec(n, A, x, y); // Warm-up: threads started, x and y in cache
+    }
+
+    for (int r = 0; r < reps; r++)
+    {
+        double t0 = omp_get_wtime();
+        if (kernel == KERNEL_PI)
+        {
+            *error = fabs(omp_pi(intervals) - M_PI) / M_PI;
+        }
+        else if (kernel == KERNEL_TRAPEZOID)
+        {
+            double exact = (TRAPEZOID_B * TRAPEZOID_B * TRAPEZOID_B - TRAPEZOID_A * TRAPEZOID_A * TRAPEZOID_A) / 3.0;
+            *error = fabs(omp_trapezoid(TRAPEZOID_A, TRAPEZOID_B, intervals) - exact) / exact;
+        }
+        else
+        {
+            omp_matvec(n, A, x, y);
+        }
+        times[r] = omp_get_wtime() - t0;
+    }
+    if (kernel == KERNEL_MATVEC)
+    {
+        *error = matvec_error(n, y);
+    }
+
+    qsort(times, reps, sizeof(double), compare_doubles);
+    double median = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+    free(times);
+    free(A);
+    free(x);
+    free(y);
+    return median;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-k KERNEL] [-n INTERVALS] [-m N] [-t MAX_THREADS] [-r REPS] [-s SCHEDULE] [-T]\n", prog);
+    fprintf(stderr, "  -k KERNEL       pi, trapezoid, matvec or all (default: all)\n");
+    fprintf(stderr, "  -n INTERVALS    Intervals of pi and trapezoid (default: %lld)\n", DEFAULT_INTERVALS);
+    fprintf(stderr, "  -m N            Matrix dimension of matvec (default: %d)\n", DEFAULT_MATRIX_N);
+    fprintf(stderr, "  -t MAX_THREADS  Largest thread count of the sweep (default: number of processors)\n");
+    fprintf(stderr, "  -r REPS         Timed runs per point, the median counts (default: %d)\n", DEFAULT_REPS);
+    fprintf(stderr, "  -s SCHEDULE     Loop schedule of pi and trapezoid: static, dynamic, guided or auto,\n");
+    fprintf(stderr, "                  optionally with ,CHUNK (default: static)\n");
+    fprintf(stderr, "  -T              Initialize the matrix on one thread instead of first-touch by its users\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int kernels = KERNEL_ALL;
+    long long intervals = DEFAULT_INTERVALS;
+    int n = DEFAULT_MATRIX_N, reps = DEFAULT_REPS, max_threads = omp_get_num_procs();
+    int first_touch = 1;
+    char schedule[32] = "static"; // CSV label: kind, or kind:chunk
+    omp_sched_t sched_kind = omp_sched_static;
+    int sched_chunk = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:n:m:t:r:s:T")) != -1)
+    {
+        if (opt == 'k' && strcmp(optarg, "all") == 0)
+        {
+            kernels = KERNEL_ALL;
+        }
+        else if (opt == 'k' && strcmp(optarg, "pi") == 0)
+        {
+            kernels = KERNEL_PI;
+        }
+        else if (opt == 'k' && strcmp(optarg, "trapezoid") == 0)
+        {
+            kernels = KERNEL_TRAPEZOID;
+        }
+        else if (opt == 'k' && strcmp(optarg, "matvec") == 0)
+        {
+            kernels = KERNEL_MATVEC;
+        }
+        else if (opt == 'n' && atoll(optarg) > 0)
+        {
+            intervals = atoll(optarg);
+        }
+        else if (opt == 'm' && atoi(optarg) > 0)
+        {
+            n = atoi(optarg);
+        }
+        else if (opt == 't' && atoi(optarg) > 0)
+        {
+            max_threads = atoi(optarg);
+        }
+        else if (opt == 'r' && atoi(optarg) > 0)
+        {
+            reps = atoi(optarg);
+        }
+        else if (opt == 's' && parse_schedule(optarg, &sched_kind, &sched_chunk))
+        {
+            snprintf(schedule, sizeof(schedule), "%.*s", (int)strcspn(optarg, ","), optarg);
+            if (sched_chunk > 0)
+            {
+                snprintf(schedule + strlen(schedule), sizeof(schedule) - strlen(schedule), ":%d", sched_chunk);
+            }
+        }
+        else if (opt == 'T')
+        {
+            first_touch = 0;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    omp_set_schedule(sched_kind, sched_chunk);
+
+    printf("# OpenMP scaling: up to %d threads on %d processors, %lld intervals, %d x %d matrix (%s init)\n",
+           max_threads, omp_get_num_procs(), intervals, n, n, first_touch ? "first-touch" : "serial");
+    printf("# Median of %d runs; speedup and efficiency against the same kernel on 1 thread\n", reps);
+    printf("kernel,threads,schedule,seconds,speedup,efficiency,rel_error\n");
+
+    for (int kernel = KERNEL_PI; kernel <= KERNEL_MATVEC; kernel *= 2)
+    {
+        if (!(kernels & kernel))
+        {
+            continue;
+        }
+        double base = 0.0;
+        for (int threads = 1;; threads = (threads * 2 > max_threads) ? max_threads : threads * 2)
+        {
+            double error;
+            double seconds = time_kernel(kernel, threads, intervals, n, reps, first_touch, &error);
+            if (threads == 1)
+            {
+                base = seconds;
+            }
+            printf("%s,%d,%s,%.6f,%.3f,%.3f,%.3e\n", kernel_names[kernel], threads,
+                   kernel == KERNEL_MATVEC ? "static" : schedule, seconds, base / seconds,
+                   base / seconds / threads, error);
+            fflush(stdout);
+            if (threads == max_threads)
+            {
+                break;
+            }
+        }
+    }
+    return 0;
+}
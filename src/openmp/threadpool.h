@@ -0,0 +1,649 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Work-stealing thread pool on plain pthreads, for intra-rank parallelism without an OpenMP
+// runtime. Include it anywhere and build with -pthread; core pinning goes through the raw
+// affinity system calls, so it does not need _GNU_SOURCE. An src/mpi program includes it as
+// "../openmp/threadpool.h" after mpi.h and builds with compile.sh as usual (mpicc links the
+// pthread library).
+//
+//   tp_create / tp_destroy   pool of num_threads threads: the creating thread plus
+//                            num_threads - 1 workers, optionally pinned to cores
+//   tp_submit / tp_wait      spawn a task into a group / wait for the group, running other
+//                            tasks meanwhile instead of blocking
+//   tp_parallel_for          body(ctx, lo, hi) over [begin, end) split into grain-sized ranges
+//   tp_parallel_reduce       sum of body(ctx, lo, hi) over the same ranges; the split and the
+//                            order of the additions are fixed, so the result does not depend
+//                            on which thread ran what
+//
+// Every thread of the pool owns a Chase-Lev deque: it pushes and pops at the bottom, idle
+// threads steal from the top. Tasks submitted from threads outside the pool go onto a lock-free
+// stack that the next idle pool thread takes over as a whole. Workers that find nothing for a
+// while sleep on a condition variable; submitters only touch the lock when someone sleeps.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define TP_DEQUE_INITIAL 256 // Slots of a new deque (grows by doubling)
+#define TP_SPIN_ROUNDS 64    // Fruitless searches for work before a worker goes to sleep
+#define TP_CACHE_LINE 64
+#define TP_MAX_CPUS 1024     // Cores an affinity mask can name
+
+// Affinity mask in the kernel's layout: bit c of the array is core c
+struct tp_cpu_mask
+{
+    unsigned long bits[TP_MAX_CPUS / (8 * sizeof(unsigned long))];
+};
+
+typedef void (*tp_task_fn)(void *arg);
+
+// Tasks waited for together
+struct tp_group
+{
+    atomic_long pending;
+};
+
+struct tp_task
+{
+    tp_task_fn fn;
+    void *arg;
+    struct tp_group *group;
+    struct tp_task *next; // Link in the stack of externally submitted tasks
+};
+
+// Circular buffer of a deque. Arrays replaced by a bigger one stay allocated until the pool is
+// destroyed, because a thief may still be reading from them.
+struct tp_array
+{
+    long size;
+    struct tp_array *retired_next;
+    _Atomic(struct tp_task *) slots[];
+};
+
+struct tp_deque
+{
+    _Alignas(TP_CACHE_LINE) atomic_long top; // Thieves take from here
+    _Alignas(TP_CACHE_LINE) atomic_long bottom; // The owner pushes and pops here
+    _Atomic(struct tp_array *) array;
+    struct tp_array *retired; // Owner only
+};
+
+struct tp_pool;
+
+struct tp_worker_start
+{
+    struct tp_pool *pool;
+    int id;
+    int cpu; // Core to pin to, -1 for none
+};
+
+struct tp_pool
+{
+    int num_threads;                   // Including the creating thread (id 0)
+    int num_deques;                    // Allocated; more than num_threads if a worker failed to start
+    int pin;                           // Pin thread i to the i-th allowed core
+    struct tp_cpu_mask creator_mask;   // Affinity of the creating thread before it was pinned
+    pthread_t *threads;                // Workers 1 .. num_threads - 1
+    struct tp_worker_start *starts;
+    struct tp_deque *deques;           // One per thread, indexed by id
+    _Atomic(struct tp_task *) injected; // Tasks submitted from outside the pool
+    atomic_int sleepers;
+    atomic_int shutdown;
+    long epoch; // Bumped under lock to wake sleepers
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+};
+
+// Which pool (and which deque) the calling thread belongs to
+static __thread struct tp_pool *tp_self_pool = NULL;
+static __thread int tp_self_id = -1;
+static __thread uint64_t tp_rng = 0;
+
+// --- Chase-Lev deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013, C11 version) ---
+
+static inline struct tp_array *tp_array_new(long size)
+{
+    struct tp_array *a = malloc(sizeof(*a) + size * sizeof(a->slots[0]));
+    if (a != NULL)
+    {
+        a->size = size;
+        a->retired_next = NULL;
+    }
+    return a;
+}
+
+// Owner only. Returns 0, or -1 if the deque is full and cannot grow.
+static inline int tp_deque_push(struct tp_deque *q, struct tp_task *task)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    struct tp_array *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    if (b - t > a->size - 1)
+    {
+        struct tp_array *bigger = tp_array_new(2 * a->size);
+        if (bigger == NULL)
+        {
+            return -1;
+        }
+        for (long i = t; i < b; i++)
+        {
+            struct tp_task *x = atomic_load_explicit(&a->slots[i % a->size], memory_order_relaxed);
+            atomic_store_explicit(&bigger->slots[i % bigger->size], x, memory_order_relaxed);
+        }
+        a->retired_next = q->retired;
+        q->retired = a;
+        atomic_store_explicit(&q->array, bigger, memory_order_release);
+        a = bigger;
+    }
+    atomic_store_explicit(&a->slots[b % a->size], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+// Owner only: newest task, or NULL
+static inline struct tp_task *tp_deque_take(struct tp_deque *q)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    struct tp_array *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    struct tp_task *task = NULL;
+    if (t <= b)
+    {
+        task = atomic_load_explicit(&a->slots[b % a->size], memory_order_relaxed);
+        if (t == b)
+        {
+            // Last task: race the thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed))
+            {
+                task = NULL;
+            }
+            atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else
+    {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Any thread: oldest task, or NULL if empty or another thread won the race
+static inline struct tp_task *tp_deque_steal(struct tp_deque *q)
+{
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b)
+    {
+        return NULL;
+    }
+    struct tp_array *a = atomic_load_explicit(&q->array, memory_order_acquire);
+    struct tp_task *task = atomic_load_explicit(&a->slots[t % a->size], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return NULL;
+    }
+    return task;
+}
+
+// --- Scheduling ---
+
+// Wake one sleeping worker if there is any; the fence pairs with the sleeper's increment
+static inline void tp_notify(struct tp_pool *pool)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool->sleepers, memory_order_relaxed) > 0)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->epoch++;
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static inline void tp_run(struct tp_task *task)
+{
+    struct tp_group *group = task->group;
+    task->fn(task->arg);
+    free(task);
+    atomic_fetch_sub_explicit(&group->pending, 1, memory_order_release); // Last touch of group
+}
+
+// Next task for thread id: own deque first, then the external stack, then a random victim
+static inline struct tp_task *tp_find_task(struct tp_pool *pool, int id)
+{
+    struct tp_task *task = tp_deque_take(&pool->deques[id]);
+    if (task != NULL)
+    {
+        return task;
+    }
+
+    if (atomic_load_explicit(&pool->injected, memory_order_relaxed) != NULL)
+    {
+        // Take the whole stack at once (no ABA problem), keep one task, make the rest stealable
+        task = atomic_exchange_explicit(&pool->injected, NULL, memory_order_acquire);
+        if (task != NULL)
+        {
+            struct tp_task *rest = task->next;
+            int pushed = 0;
+            while (rest != NULL)
+            {
+                struct tp_task *next = rest->next;
+                if (tp_deque_push(&pool->deques[id], rest) != 0)
+                {
+                    tp_run(rest); // No room to queue it: run it here
+                }
+                pushed = 1;
+                rest = next;
+            }
+            if (pushed)
+            {
+                tp_notify(pool);
+            }
+            return task;
+        }
+    }
+
+    // xorshift64 picks where the scan over the other deques starts
+    tp_rng ^= tp_rng << 13;
+    tp_rng ^= tp_rng >> 7;
+    tp_rng ^= tp_rng << 17;
+    int start = (int)(tp_rng % (uint64_t)pool->num_threads);
+    for (int k = 0; k < pool->num_threads; k++)
+    {
+        int victim = (start + k) % pool->num_threads;
+        if (victim != id && (task = tp_deque_steal(&pool->deques[victim])) != NULL)
+        {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+// Spawn fn(arg) as part of group. Runs it right away if the task cannot be queued.
+static inline void tp_submit(struct tp_pool *pool, struct tp_group *group, tp_task_fn fn, void *arg)
+{
+    struct tp_task *task = malloc(sizeof(*task));
+    if (task == NULL)
+    {
+        fn(arg);
+        return;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    task->group = group;
+    atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+
+    if (tp_self_pool == pool)
+    {
+        if (tp_deque_push(&pool->deques[tp_self_id], task) != 0)
+        {
+            tp_run(task);
+            return;
+        }
+    }
+    else
+    {
+        // Lock-free push onto the stack of external submissions
+        task->next = atomic_load_explicit(&pool->injected, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&pool->injected, &task->next, task, memory_order_release,
+                                                      memory_order_relaxed))
+        {
+        }
+    }
+    tp_notify(pool);
+}
+
+// Wait until every task of group has finished. A pool thread runs other tasks meanwhile, so
+// tasks may themselves submit and wait.
+static inline void tp_wait(struct tp_pool *pool, struct tp_group *group)
+{
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+    {
+        struct tp_task *task = (tp_self_pool == pool) ? tp_find_task(pool, tp_self_id) : NULL;
+        if (task != NULL)
+        {
+            tp_run(task);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+static inline void tp_group_init(struct tp_group *group)
+{
+    atomic_init(&group->pending, 0);
+}
+
+static inline int tp_mask_isset(const struct tp_cpu_mask *mask, int cpu)
+{
+    const int per_word = 8 * sizeof(unsigned long);
+    return (mask->bits[cpu / per_word] >> (cpu % per_word)) & 1UL;
+}
+
+// Affinity of the calling thread; 0 on success. Pid 0 of the raw calls is the calling thread.
+static inline int tp_get_affinity(struct tp_cpu_mask *mask)
+{
+    memset(mask, 0, sizeof(*mask)); // The kernel fills only the bytes it uses
+#ifdef __linux__
+    return syscall(SYS_sched_getaffinity, 0, sizeof(mask->bits), mask->bits) < 0 ? -1 : 0;
+#else
+    return -1;
+#endif
+}
+
+static inline void tp_set_affinity(const struct tp_cpu_mask *mask)
+{
+#ifdef __linux__
+    syscall(SYS_sched_setaffinity, 0, sizeof(mask->bits), mask->bits);
+#else
+    (void)mask;
+#endif
+}
+
+// The index-th core in allowed (wrapping around), or -1 if there is none
+static inline int tp_pick_cpu(const struct tp_cpu_mask *allowed, int index)
+{
+    int count = 0;
+    for (int cpu = 0; cpu < TP_MAX_CPUS; cpu++)
+    {
+        count += tp_mask_isset(allowed, cpu);
+    }
+    if (count == 0)
+    {
+        return -1;
+    }
+    int wanted = index % count;
+    for (int cpu = 0; cpu < TP_MAX_CPUS; cpu++)
+    {
+        if (tp_mask_isset(allowed, cpu) && wanted-- == 0)
+        {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+// Pin the calling thread to one core (cpu < 0: leave it alone)
+static inline void tp_pin_self(int cpu)
+{
+    if (cpu >= 0)
+    {
+        const int per_word = 8 * sizeof(unsigned long);
+        struct tp_cpu_mask target;
+        memset(&target, 0, sizeof(target));
+        target.bits[cpu / per_word] = 1UL << (cpu % per_word);
+        tp_set_affinity(&target);
+    }
+}
+
+static inline void *tp_worker_main(void *arg)
+{
+    struct tp_worker_start *start = arg;
+    struct tp_pool *pool = start->pool;
+    int id = start->id;
+    tp_self_pool = pool;
+    tp_self_id = id;
+    tp_rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(id + 1);
+    tp_pin_self(start->cpu);
+
+    int idle = 0;
+    while (!atomic_load_explicit(&pool->shutdown, memory_order_acquire))
+    {
+        struct tp_task *task = tp_find_task(pool, id);
+        if (task != NULL)
+        {
+            tp_run(task);
+            idle = 0;
+            continue;
+        }
+        if (++idle < TP_SPIN_ROUNDS)
+        {
+            sched_yield();
+            continue;
+        }
+
+        // Going to sleep: announce it, then look once more so no submission is missed
+        pthread_mutex_lock(&pool->lock);
+        long seen = pool->epoch;
+        pthread_mutex_unlock(&pool->lock);
+        atomic_fetch_add_explicit(&pool->sleepers, 1, memory_order_seq_cst);
+        task = tp_find_task(pool, id);
+        if (task == NULL)
+        {
+            pthread_mutex_lock(&pool->lock);
+            while (pool->epoch == seen && !atomic_load_explicit(&pool->shutdown, memory_order_relaxed))
+            {
+                pthread_cond_wait(&pool->wake, &pool->lock);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+        atomic_fetch_sub_explicit(&pool->sleepers, 1, memory_order_relaxed);
+        if (task != NULL)
+        {
+            tp_run(task);
+        }
+        idle = 0;
+    }
+    return NULL;
+}
+
+// Pool of num_threads threads; the calling thread is thread 0 and takes part in tp_wait.
+// Returns NULL on failure.
+static inline struct tp_pool *tp_create(int num_threads, int pin)
+{
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+    struct tp_pool *pool = calloc(1, sizeof(*pool));
+    void *deques = NULL;
+    if (pool == NULL || posix_memalign(&deques, TP_CACHE_LINE, num_threads * sizeof(struct tp_deque)) != 0)
+    {
+        free(pool);
+        return NULL;
+    }
+    pool->num_threads = num_threads;
+    pool->num_deques = num_threads;
+    pool->pin = pin;
+    pool->deques = deques;
+    pool->threads = malloc(num_threads * sizeof(pthread_t));
+    pool->starts = malloc(num_threads * sizeof(struct tp_worker_start));
+    int arrays = 0; // Deques whose array has been allocated
+    if (pool->threads != NULL && pool->starts != NULL)
+    {
+        for (; arrays < num_threads; arrays++)
+        {
+            struct tp_array *a = tp_array_new(TP_DEQUE_INITIAL);
+            if (a == NULL)
+            {
+                break;
+            }
+            atomic_init(&pool->deques[arrays].array, a);
+        }
+    }
+    if (arrays < num_threads)
+    {
+        for (int i = 0; i < arrays; i++)
+        {
+            free(atomic_load(&pool->deques[i].array));
+        }
+        free(pool->threads);
+        free(pool->starts);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    atomic_init(&pool->injected, NULL);
+    atomic_init(&pool->sleepers, 0);
+    atomic_init(&pool->shutdown, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    for (int i = 0; i < num_threads; i++)
+    {
+        atomic_init(&pool->deques[i].top, 0);
+        atomic_init(&pool->deques[i].bottom, 0);
+        pool->deques[i].retired = NULL;
+    }
+
+    // The cores come from the creator's mask, read once before anyone is pinned: threads inherit
+    // their creator's affinity, so a mask read later (or by a worker) would be the one pinned core
+    for (int i = 0; i < num_threads; i++)
+    {
+        pool->starts[i].pool = pool;
+        pool->starts[i].id = i;
+        pool->starts[i].cpu = -1;
+    }
+    if (pin && tp_get_affinity(&pool->creator_mask) == 0)
+    {
+        for (int i = 0; i < num_threads; i++)
+        {
+            pool->starts[i].cpu = tp_pick_cpu(&pool->creator_mask, i);
+        }
+    }
+    else
+    {
+        pool->pin = 0;
+    }
+
+    tp_self_pool = pool;
+    tp_self_id = 0;
+    tp_rng = 0x9E3779B97F4A7C15ULL;
+    for (int i = 1; i < num_threads; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, tp_worker_main, &pool->starts[i]) != 0)
+        {
+            pool->num_threads = i; // Run with the threads that did start
+            break;
+        }
+    }
+    tp_pin_self(pool->starts[0].cpu); // Last, once the workers have their own cores
+    return pool;
+}
+
+// Stop and join the workers and free the pool. All submitted tasks must have been waited for.
+static inline void tp_destroy(struct tp_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    atomic_store_explicit(&pool->shutdown, 1, memory_order_release);
+    pool->epoch++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->num_threads; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->num_deques; i++)
+    {
+        free(atomic_load(&pool->deques[i].array));
+        while (pool->deques[i].retired != NULL)
+        {
+            struct tp_array *next = pool->deques[i].retired->retired_next;
+            free(pool->deques[i].retired);
+            pool->deques[i].retired = next;
+        }
+    }
+    if (tp_self_pool == pool)
+    {
+        tp_self_pool = NULL;
+        tp_self_id = -1;
+    }
+    if (pool->pin)
+    {
+        // Give the creating thread its cores back so later pools and threads are not confined
+        tp_set_affinity(&pool->creator_mask);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool->starts);
+    free(pool);
+}
+
+// --- Loop helpers ---
+// Ranges are halved until they are at most grain long: the upper half is spawned, the lower
+// half is continued by the same thread, and the halves are joined before returning. The tree of
+// splits only depends on begin, end and grain.
+
+struct tp_range
+{
+    struct tp_pool *pool;
+    long lo, hi, grain;
+    void (*for_body)(void *ctx, long lo, long hi);
+    double (*reduce_body)(void *ctx, long lo, long hi);
+    void *ctx;
+    double result;
+};
+
+static inline void tp_range_task(void *arg)
+{
+    struct tp_range *r = arg;
+    if (r->hi - r->lo <= r->grain)
+    {
+        if (r->for_body != NULL)
+        {
+            r->for_body(r->ctx, r->lo, r->hi);
+        }
+        else
+        {
+            r->result = r->reduce_body(r->ctx, r->lo, r->hi);
+        }
+        return;
+    }
+    long mid = r->lo + (r->hi - r->lo) / 2;
+    struct tp_range lower = *r, upper = *r;
+    lower.hi = mid;
+    upper.lo = mid;
+    struct tp_group group;
+    tp_group_init(&group);
+    tp_submit(r->pool, &group, tp_range_task, &upper);
+    tp_range_task(&lower);
+    tp_wait(r->pool, &group);
+    r->result = lower.result + upper.result;
+}
+
+// Grain for a range when the caller passes grain <= 0: about 8 pieces per thread
+static inline long tp_default_grain(struct tp_pool *pool, long begin, long end)
+{
+    long grain = (end - begin) / (8L * pool->num_threads);
+    return grain > 0 ? grain : 1;
+}
+
+static inline void tp_parallel_for(struct tp_pool *pool, long begin, long end, long grain,
+                                   void (*body)(void *ctx, long lo, long hi), void *ctx)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+    struct tp_range r = {pool, begin, end, grain > 0 ? grain : tp_default_grain(pool, begin, end), body, NULL, ctx, 0.0};
+    tp_range_task(&r);
+}
+
+static inline double tp_parallel_reduce(struct tp_pool *pool, long begin, long end, long grain,
+                                        double (*body)(void *ctx, long lo, long hi), void *ctx)
+{
+    if (end <= begin)
+    {
+        return 0.0;
+    }
+    struct tp_range r = {pool, begin, end, grain > 0 ? grain : tp_default_grain(pool, begin, end), NULL, body, ctx, 0.0};
+    tp_range_task(&r);
+    return r.result;
+}
+
+#endif // THREADPOOL_H